@@ -6,6 +6,31 @@
 #define AMR_TOC_QBIT	0x04
 #define AMR_CMR_NONE	0xF
 
+/* number of TCH frames averaged by the link adaptation filter */
+#define AMR_LA_AVG_WEIGHT	8
+/* minimum number of TCH frames between two codec mode changes */
+#define AMR_LA_HOLDOFF		25
+/* filtered BER (1/10000) below which going up is permitted */
+#define AMR_LA_BER_UP		100
+/* filtered BER (1/10000) above which we go down */
+#define AMR_LA_BER_DOWN		500
+
+/* BTS side AMR link adaptation state of one lchan (TS 45.009 3.3).
+ * It only covers the uplink.  The downlink codec mode is the one of the
+ * RTP frames, chosen by the far end from the Codec Mode Request of the
+ * MS that is passed on in the RTP payload header. */
+struct amr_link_adapt {
+	int ci_avg_cB;			/* filtered uplink C/I */
+	unsigned int ber_avg10k;	/* filtered uplink BER */
+	unsigned int num_meas;
+	unsigned int holdoff;
+	/* index into amr_mr.mode[] commanded to the MS (CMC) */
+	uint8_t mode_idx;
+	/* number of TCH frames per mode index, and mode changes */
+	uint32_t residency[4];
+	uint32_t num_changes;
+};
+
 void amr_log_mr_conf(int ss, int logl, const char *pfx,
 		     struct amr_multirate_conf *amr_mrc);
 
@@ -14,4 +39,9 @@ int amr_parse_mr_conf(struct amr_multirate_conf *amr_mrc,
 
 unsigned int amr_get_initial_mode(struct gsm_lchan *lchan);
 
+void amr_la_init(struct amr_link_adapt *la, struct gsm_lchan *lchan);
+unsigned int amr_la_ul_meas(struct amr_link_adapt *la,
+			    const struct amr_multirate_conf *amr_mrc,
+			    int ci_cB, unsigned int ber10k);
+
 #endif /* _OSMO_BTS_AMR_H */
@@ -0,0 +1,69 @@
+#ifndef _OSMO_BTS_BS_POWER_CTRL_H
+#define _OSMO_BTS_BS_POWER_CTRL_H
+
+#include <stdint.h>
+#include <osmocom/core/utils.h>
+
+struct gsm_bts;
+struct gsm_bts_trx;
+struct gsm_lchan;
+
+#define BS_PWR_CTRL_TARGET_DEFAULT	30	/* RXLEV, -81 dBm */
+#define BS_PWR_CTRL_HYST_DEFAULT	3	/* dB */
+#define BS_PWR_CTRL_RAISE_DEFAULT	4	/* dB */
+#define BS_PWR_CTRL_LOWER_DEFAULT	2	/* dB */
+#define BS_PWR_CTRL_MAX_RED_DEFAULT	20	/* dB */
+#define BS_PWR_CTRL_RXQUAL_DEFAULT	4
+
+enum bs_pwr_ctrl_mode {
+	BS_PWR_CTRL_OFF,	/* use the BS Power of the BSC */
+	BS_PWR_CTRL_ON,		/* ... as the highest power */
+};
+
+extern const struct value_string bs_pwr_ctrl_mode_names[];
+
+/* configuration, per BTS */
+struct bs_power_ctrl {
+	enum bs_pwr_ctrl_mode mode;
+	unsigned int target;		/* downlink RXLEV at the MS */
+	unsigned int hyst;		/* dB around the target */
+	unsigned int raise_db;		/* step up */
+	unsigned int lower_db;		/* step down */
+	unsigned int max_red_db;	/* below the BS Power of the BSC */
+	unsigned int rxqual_max;	/* raise above that RXQUAL */
+
+	uint64_t changes;		/* of the power of any lchan */
+};
+
+/* state of a lchan, in BS Power steps of 2 dB */
+struct bs_power_lchan {
+	uint8_t base;			/* as set by the BSC */
+	uint8_t fixed;			/* by BS POWER CONTROL */
+	/* statistics of the reduction below base since activation */
+	uint8_t red_min;
+	uint8_t red_max;
+	uint32_t red_sum;
+	uint32_t num;			/* measurement reports */
+	uint32_t changes;
+};
+
+void bs_power_ctrl_init(struct gsm_bts *bts);
+
+/* the BSC set the BS Power of a lchan, fixed by BS POWER CONTROL */
+void bs_power_ctrl_reset(struct gsm_lchan *lchan, int fixed);
+
+/* BS Power the TRX uses, the highest any of its active lchans asks
+ * for, or -1 without any */
+int bs_power_ctrl_trx_power(struct gsm_bts_trx *trx);
+
+/* a lchan was activated or released */
+void bs_power_ctrl_apply(struct gsm_lchan *lchan);
+
+/* a MEASUREMENT REPORT of the MS was received */
+void bs_power_ctrl_meas(struct gsm_lchan *lchan, const uint8_t *l3,
+			unsigned int l3_len);
+
+/* average reduction below the BS Power of the BSC in dB */
+unsigned int bs_power_ctrl_avg_red(struct gsm_lchan *lchan);
+
+#endif /* _OSMO_BTS_BS_POWER_CTRL_H */
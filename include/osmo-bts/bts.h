@@ -24,14 +24,19 @@ int trx_link_estab(struct gsm_bts_trx *trx);
 void bts_new_si(void *arg);
 void bts_setup_slot(struct gsm_bts_trx_ts *slot, uint8_t comb);
 
-int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg);
-struct msgb *bts_agch_dequeue(struct gsm_bts *bts);
+int bts_ccch_index(uint8_t tn);
+int bts_num_ccch(struct gsm_bts *bts);
+int bts_agch_enqueue(struct gsm_bts *bts, uint8_t tn, struct msgb *msg);
+struct msgb *bts_agch_dequeue(struct gsm_bts *bts, uint8_t tn);
 void bts_update_agch_max_queue_length(struct gsm_bts *bts);
 int bts_agch_max_queue_length(int T, int bcch_conf);
-int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt,
-		      int is_ag_res);
+int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t tn, uint8_t *out_buf,
+		      struct gsm_time *gt, int is_ag_res);
 
+void bts_sysinfo_sched_update(struct gsm_bts *bts);
 uint8_t *bts_sysinfo_get(struct gsm_bts *bts, struct gsm_time *g_time);
+uint8_t *bts_sysinfo_get_ext(struct gsm_bts *bts, struct gsm_time *g_time);
+void lchan_sacch_update(struct gsm_lchan *lchan);
 uint8_t *lchan_sacch_get(struct gsm_lchan *lchan);
 int lchan_init_lapdm(struct gsm_lchan *lchan);
 
@@ -48,5 +48,6 @@ int bts_model_oml_estab(struct gsm_bts *bts);
 
 int bts_model_change_power(struct gsm_bts_trx *trx, int p_trxout_mdBm);
 int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan);
+int bts_model_adjst_bs_pwr(struct gsm_lchan *lchan);
 
 #endif
@@ -7,11 +7,27 @@
 
 #include <osmo-bts/paging.h>
 #include <osmo-bts/tx_power.h>
+#include <osmo-bts/voice_stats.h>
+#include <osmo-bts/rach_overload.h>
+#include <osmo-bts/load_stats.h>
+#include <osmo-bts/meas_preproc.h>
+#include <osmo-bts/bs_power_ctrl.h>
+#include <osmo-bts/ms_power_ctrl.h>
+#include <osmo-bts/ta_ctrl.h>
 
 #define GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DEFAULT 41
 #define GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE 999999
 #define GSM_BTS_AGCH_QUEUE_LOW_LEVEL_DEFAULT 41
 #define GSM_BTS_AGCH_QUEUE_HIGH_LEVEL_DEFAULT 91
+#define GSM_BTS_AGCH_QUEUE_HARD_LIMIT_DEFAULT 1000
+#define GSM_BTS_CCCH_AGCH_TARGET_DEFAULT 250	/* ms */
+#define GSM_BTS_CCCH_PAGING_TARGET_DEFAULT 1000	/* ms */
+
+/* CCCH can be on TS 0, 2, 4 and 6 of the BCCH carrier */
+#define BTS_MAX_CCCH	4
+
+/* 51-multiframes of the BCCH schedule, 4 occurrences of each TC */
+#define BCCH_SCHED_LEN	32
 
 struct pcu_sock_state;
 struct smscb_msg;
@@ -23,6 +39,53 @@ struct gsm_network {
 	struct pcu_sock_state *pcu_state;
 };
 
+/* running sums of the uplink measurements of a SACCH period, all of the
+ * samples (FULL set) and those of the SUB set */
+struct ul_meas_acc {
+	unsigned int num;
+	unsigned int num_sub;
+	uint32_t ber10k_sum;
+	uint32_t ber10k_sub_sum;
+	uint32_t irssi_sum;		/* RSSI in -dBm */
+	uint32_t irssi_sub_sum;
+	uint64_t irssi_sq_sum;		/* ... squared, for the variance */
+	uint8_t irssi_min;
+	uint8_t irssi_max;
+	int32_t taqb_sum;		/* timing offset in quarter bits */
+};
+
+/* SACCH filling of a lchan.  Types in own are sent from lchan->si.buf,
+ * the others from the SACCH filling of the BTS unless they are off.
+ * lchan->si.valid holds the result, see lchan_sacch_update() */
+struct lchan_sacch {
+	uint32_t own;			/* SACCH INFO (MODIFY) of the lchan */
+	uint32_t off;			/* types of the BTS not sent */
+	uint32_t version;		/* of the BTS filling in si.valid */
+};
+
+/* BTS-local per-lchan state that has no place in the struct gsm_lchan
+ * shared with OpenBSC, see lchan_bts_state() */
+struct lchan_bts_state {
+	struct lchan_sacch sacch;
+	struct voice_stats voice;
+	struct ul_meas_acc ul_meas;
+	struct meas_preproc_lchan meas_preproc;
+	struct bs_power_lchan bs_power;
+	struct ms_power_lchan ms_power;
+	struct ta_ctrl_lchan ta_ctrl;
+	/* entry in the measurement schedule of the TRX, see
+	 * lchan_meas_sched_update(), meas_sched_mod is 0 if there is none */
+	uint8_t meas_sched_mod;
+	uint8_t meas_sched_fn;
+};
+
+/* lchans whose uplink measurement period ends at a given frame, as bit
+ * (ts * TS_MAX_LCHAN + lchan) of the TRX */
+struct trx_meas_sched {
+	uint64_t fn104[104];	/* TCH, by FN % 104 */
+	uint64_t fn102[102];	/* SDCCH, by FN % 102 */
+};
+
 /* data structure for BTS related data specific to the BTS role */
 struct gsm_bts_role_bts {
 	struct {
@@ -38,10 +101,13 @@ struct gsm_bts_role_bts {
 			/* Input parameters from OML */
 			uint8_t load_ind_thresh;	/* percent */
 			uint8_t load_ind_period;	/* seconds */
-			/* Internal data */
+			/* Internal data, the counters only ever increase */
 			struct osmo_timer_list timer;
 			unsigned int pch_total;
 			unsigned int pch_used;
+			/* ... their values at the start of the period */
+			unsigned int pch_total_start;
+			unsigned int pch_used_start;
 		} ccch;
 		struct {
 			/* Input parameters from OML */
@@ -51,15 +117,27 @@ struct gsm_bts_role_bts {
 			unsigned int total;	/* total nr */
 			unsigned int busy;	/* above busy_thresh */
 			unsigned int access;	/* access bursts */
+			unsigned int total_start;
+			unsigned int busy_start;
+			unsigned int access_start;
 		} rach;
 	} load;
+	struct load_stats load_stats;
 	uint8_t ny1;
 	uint8_t max_ta;
 
-	/* AGCH queuing */
-	struct llist_head agch_queue;
-	int agch_queue_length;
-	int agch_max_queue_length;
+	/* AGCH queuing, one queue per CCCH timeslot.  Assignments and
+	 * rejects wait in separate sub-queues, assignments are sent first */
+	struct {
+		struct llist_head ass_queue;
+		struct llist_head rej_queue;
+		int length;			/* of both sub-queues */
+		struct msgb *ass_unpaired;	/* IMM ASS that may be packed */
+	} agch[BTS_MAX_CCCH];
+	int agch_queue_length;		/* of all CCCH timeslots */
+	int agch_max_queue_length;	/* per CCCH timeslot */
+	int agch_queue_hard_limit;	/* per CCCH timeslot, bounds the memory */
+	uint32_t agch_prng;		/* state of the early drop PRNG */
 
 	int agch_queue_thresh_level;	/* Cleanup threshold in percent of max len */
 	int agch_queue_low_level;	/* Low water mark in percent of max len */
@@ -68,18 +146,47 @@ struct gsm_bts_role_bts {
 	/* TODO: Use a rate counter group instead */
 	uint64_t agch_queue_dropped_msgs;
 	uint64_t agch_queue_merged_msgs;
+	uint64_t agch_queue_packed_msgs;	/* IMM ASS into IMM ASS EXT */
 	uint64_t agch_queue_rejected_msgs;
 	uint64_t agch_queue_agch_msgs;
 	uint64_t agch_queue_pch_msgs;
 
+	/* sharing of the PCH blocks between paging and AGCH */
+	struct {
+		unsigned int agch_target_ms;	/* target delay of the AGCH */
+		unsigned int paging_target_ms;	/* ... and of new paging */
+		uint32_t last_fn;		/* of the last CCCH block */
+		uint64_t paging_blocks;		/* blocks used for paging */
+		uint64_t idle_blocks;		/* blocks with nothing to send */
+		uint64_t paging_deferred;	/* PCH blocks given to the AGCH
+						 * ahead of new paging */
+	} ccch_sched;
+
+	/* SACCH filling of the BTS, the messages are in bts->si_buf.
+	 * The version changes with every SACCH FILLING. */
+	struct {
+		uint32_t valid;
+		uint32_t version;
+	} sacch_fill;
+
+	struct rach_overload rach_ovld;
+	struct meas_preproc meas_preproc;
+	struct bs_power_ctrl bs_power_ctrl;
+	struct ms_power_ctrl ms_power_ctrl;
+	struct ta_ctrl ta_ctrl;
+
 	struct paging_state *paging_state;
 	char *bsc_oml_host;
 	unsigned int rtp_jitter_buf_ms;
 	struct {
 		uint8_t ciphers;	/* flags A5/1==0x1, A5/2==0x2, A5/3==0x4 */
 	} support;
+	/* BCCH schedule, indexed by the 51-multiframe number modulo
+	 * BCCH_SCHED_LEN.  The entries are enum osmo_sysinfo_type,
+	 * rebuilt whenever the system information changes. */
 	struct {
-		uint8_t tc4_ctr;
+		uint8_t norm[BCCH_SCHED_LEN];
+		uint8_t ext[BCCH_SCHED_LEN];
 	} si;
 	uint8_t radio_link_timeout;
 
@@ -90,6 +197,12 @@ struct gsm_bts_role_bts {
 		struct llist_head queue;	/* list of struct smscb_msg */
 		struct smscb_msg *cur_msg;	/* current SMS-CB */
 	} smscb_state;
+
+	/* indexed by trx, ts and lchan number */
+	struct lchan_bts_state *lchan_state;
+	unsigned int num_lchan_state;
+	/* indexed by trx number */
+	struct trx_meas_sched *meas_sched;
 };
 
 enum lchan_ciph_state {
@@ -113,6 +226,7 @@ static inline struct femtol1_hdl *trx_femtol1_hdl(struct gsm_bts_trx *trx)
 
 
 void lchan_set_state(struct gsm_lchan *lchan, enum gsm_lchan_state state);
+struct lchan_bts_state *lchan_bts_state(struct gsm_lchan *lchan);
 
 /* cipher code */
 #define CIPHER_A5(x) (1 << (x-1))
@@ -0,0 +1,94 @@
+#ifndef _OSMO_BTS_LOAD_STATS_H
+#define _OSMO_BTS_LOAD_STATS_H
+
+#include <stdint.h>
+#include <osmocom/core/timer.h>
+#include <osmocom/core/utils.h>
+
+struct gsm_bts;
+struct gsm_bts_role_bts;
+
+/* the load is sampled that often */
+#define LOAD_STATS_TICK_MS		100
+
+/* the occupancy of the paging groups is taken over that long */
+#define LOAD_STATS_GROUP_WINDOW_MS	30000
+
+/* paging groups by occupancy in steps of 10% */
+#define LOAD_STATS_GROUP_BINS		10
+
+/* AGCH messages by waiting time, see load_stats_wait_bound_ms[] */
+#define LOAD_STATS_WAIT_BINS		8
+
+#define LOAD_STATS_STATSD_PORT_DEFAULT		8125
+#define LOAD_STATS_STATSD_INTERVAL_DEFAULT	10	/* s */
+
+/* what is averaged, rates are per second */
+enum load_stats_var {
+	LOAD_STATS_PCH_BLOCKS,		/* rate of PCH blocks */
+	LOAD_STATS_PCH_USED,		/* ... that carried a message */
+	LOAD_STATS_RACH_SLOTS,		/* rate of RACH slots */
+	LOAD_STATS_RACH_BUSY,		/* ... above the busy threshold */
+	LOAD_STATS_RACH_ACCESS,		/* rate of access bursts */
+	LOAD_STATS_AGCH_SENT,		/* rate of AGCH messages sent */
+	LOAD_STATS_AGCH_QUEUE,		/* length of the AGCH queues */
+	LOAD_STATS_PAGING_QUEUE,	/* length of the paging queue */
+	_NUM_LOAD_STATS_VAR
+};
+
+/* time constants of the moving averages */
+enum load_stats_tc {
+	LOAD_STATS_TC_1S,
+	LOAD_STATS_TC_10S,
+	LOAD_STATS_TC_60S,
+	_NUM_LOAD_STATS_TC
+};
+
+extern const struct value_string load_stats_var_names[];
+extern const struct value_string load_stats_tc_names[];
+extern const unsigned int load_stats_wait_bound_ms[LOAD_STATS_WAIT_BINS];
+
+struct load_stats {
+	/* exponentially weighted moving averages, in 1/1000 with 16
+	 * fractional bits */
+	int64_t avg[_NUM_LOAD_STATS_VAR][_NUM_LOAD_STATS_TC];
+	/* counter values at the last tick */
+	uint32_t last[_NUM_LOAD_STATS_VAR];
+	int primed;
+	unsigned int ticks;
+
+	/* AGCH messages by the time they waited in the queue */
+	uint64_t agch_wait[LOAD_STATS_WAIT_BINS];
+	/* paging groups by occupancy in the last complete window */
+	unsigned int group_occ[LOAD_STATS_GROUP_BINS];
+
+	/* export to a statsd daemon */
+	struct {
+		char *host;		/* NULL if disabled */
+		uint16_t port;
+		unsigned int interval;	/* s */
+		int fd;
+		uint64_t agch_wait_sent[LOAD_STATS_WAIT_BINS];
+	} statsd;
+
+	struct osmo_timer_list timer;
+};
+
+void load_stats_init(struct gsm_bts *bts);
+
+/* an AGCH message is sent after waiting that many frames */
+void load_stats_agch_wait(struct gsm_bts_role_bts *btsb, unsigned int frames);
+
+/* moving average in 1/1000 */
+unsigned int load_stats_avg(struct gsm_bts *bts, enum load_stats_var var,
+			    enum load_stats_tc tc);
+
+/* share of the used PCH blocks and busy RACH slots in 1/1000 */
+unsigned int load_stats_pch_load(struct gsm_bts *bts, enum load_stats_tc tc);
+unsigned int load_stats_rach_load(struct gsm_bts *bts, enum load_stats_tc tc);
+
+/* send the statistics to a statsd daemon, host NULL to stop */
+int load_stats_statsd_set(struct gsm_bts *bts, const char *host,
+			  uint16_t port);
+
+#endif /* _OSMO_BTS_LOAD_STATS_H */
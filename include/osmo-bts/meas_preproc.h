@@ -0,0 +1,76 @@
+#ifndef _OSMO_BTS_MEAS_PREPROC_H
+#define _OSMO_BTS_MEAS_PREPROC_H
+
+#include <stdint.h>
+#include <osmocom/core/utils.h>
+
+struct gsm_bts;
+struct gsm_lchan;
+
+#define MEAS_PREPROC_AVG_DEFAULT		4	/* SACCH periods */
+#define MEAS_PREPROC_RXLEV_DELTA_DEFAULT	6	/* dB */
+#define MEAS_PREPROC_RXQUAL_DELTA_DEFAULT	1
+#define MEAS_PREPROC_INTERVAL_DEFAULT		10	/* SACCH periods */
+#define MEAS_PREPROC_TRIG_RXLEV_DEFAULT		10	/* -100 dBm */
+#define MEAS_PREPROC_TRIG_RXQUAL_DEFAULT	5
+
+enum meas_preproc_mode {
+	MEAS_PREPROC_BSC,	/* as requested by PRE-PROCESSING CONFIGURE */
+	MEAS_PREPROC_ALWAYS,
+	MEAS_PREPROC_NEVER,
+};
+
+extern const struct value_string meas_preproc_mode_names[];
+
+/* the values looked at, of the serving cell */
+enum meas_preproc_val {
+	MEAS_PREPROC_UL_RXLEV,
+	MEAS_PREPROC_UL_RXQUAL,
+	MEAS_PREPROC_DL_RXLEV,
+	MEAS_PREPROC_DL_RXQUAL,
+	_NUM_MEAS_PREPROC_VAL
+};
+
+struct meas_preproc_stats {
+	uint64_t sent;		/* MEAS RES sent while pre-processing */
+	uint64_t suppressed;	/* ... not sent */
+	uint64_t triggered;	/* ... sent for a trigger threshold */
+};
+
+/* configuration, per BTS */
+struct meas_preproc {
+	enum meas_preproc_mode mode;
+	unsigned int avg_periods;	/* weight of the moving average */
+	unsigned int rxlev_delta;	/* report a change of that much */
+	unsigned int rxqual_delta;
+	unsigned int interval;		/* report at least that often */
+	unsigned int trig_rxlev;	/* report every period below */
+	unsigned int trig_rxqual;	/* ... or above */
+
+	struct meas_preproc_stats stats;
+};
+
+/* state of a lchan */
+struct meas_preproc_lchan {
+	uint8_t enabled;		/* by the BSC */
+	uint8_t periods;		/* since the last report */
+	uint8_t valid;			/* bit mask of enum meas_preproc_val */
+	uint16_t avg[_NUM_MEAS_PREPROC_VAL];	/* in 1/16 */
+	uint8_t rep[_NUM_MEAS_PREPROC_VAL];	/* as last reported */
+};
+
+void meas_preproc_init(struct gsm_bts *bts);
+
+/* a lchan is activated */
+void meas_preproc_reset(struct gsm_lchan *lchan);
+
+/* Pre-processing Parameters of a PRE-PROCESSING CONFIGURE */
+void meas_preproc_config(struct gsm_lchan *lchan, const uint8_t *param,
+			 unsigned int len);
+
+/* decide whether a MEASUREMENT RESULT with that measurement report is
+ * sent to the BSC, 1 if so */
+int meas_preproc_check(struct gsm_lchan *lchan, const uint8_t *l3,
+		       unsigned int l3_len);
+
+#endif /* _OSMO_BTS_MEAS_PREPROC_H */
@@ -3,8 +3,15 @@
 
 int lchan_new_ul_meas(struct gsm_lchan *lchan, struct bts_ul_meas *ulm);
 
+/* (un)schedule the end of the measurement periods of a lchan and reset
+ * its measurements after a change of its state, mode or pchan */
+void lchan_meas_sched_update(struct gsm_lchan *lchan);
+
 int trx_meas_check_compute(struct gsm_bts_trx *trx, uint32_t fn);
 
+/* RXQUAL of a BER in 1/10000 */
+uint8_t ber10k_to_rxqual(uint32_t ber10k);
+
 /* build the 3 byte RSL uplinke measurement IE content */
 int lchan_build_rsl_ul_meas(struct gsm_lchan *, uint8_t *buf);
 
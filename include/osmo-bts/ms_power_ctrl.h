@@ -0,0 +1,52 @@
+#ifndef _OSMO_BTS_MS_POWER_CTRL_H
+#define _OSMO_BTS_MS_POWER_CTRL_H
+
+#include <stdint.h>
+
+struct gsm_bts;
+struct gsm_lchan;
+
+#define MS_PWR_CTRL_AVG_DEFAULT		4	/* SACCH blocks */
+#define MS_PWR_CTRL_RAISE_THRESH_DEFAULT	4	/* dB below target */
+#define MS_PWR_CTRL_LOWER_THRESH_DEFAULT	4	/* dB above target */
+#define MS_PWR_CTRL_RAISE_MAX_DEFAULT	8	/* dB */
+#define MS_PWR_CTRL_LOWER_MAX_DEFAULT	4	/* dB */
+#define MS_PWR_CTRL_RXQUAL_DEFAULT	5
+
+/* configuration, per BTS */
+struct ms_power_ctrl {
+	unsigned int avg_blocks;	/* SACCH blocks averaged */
+	unsigned int raise_thresh;	/* raise below target - raise_thresh */
+	unsigned int lower_thresh;	/* lower above target + lower_thresh */
+	unsigned int raise_max_db;	/* largest step up */
+	unsigned int lower_max_db;	/* largest step down */
+	unsigned int rxqual_raise;	/* raise at that uplink RXQUAL */
+
+	uint64_t raised;		/* commands of all lchans */
+	uint64_t lowered;
+};
+
+/* state of a lchan */
+struct ms_power_lchan {
+	int32_t rssi_sum;		/* dBm, of the current window */
+	uint32_t ber10k_sum;
+	uint8_t num;
+	uint8_t max_valid;		/* the BSC set the highest power */
+	uint8_t max_dbm;
+	/* since activation */
+	uint32_t blocks;		/* SACCH blocks looked at */
+	uint32_t raised;		/* commands to raise the power */
+	uint32_t lowered;		/* ... to lower it */
+};
+
+void ms_power_ctrl_init(struct gsm_bts *bts);
+
+/* the BSC set the MS power of a lchan, as highest one if max_valid */
+void ms_power_ctrl_reset(struct gsm_lchan *lchan, int max_valid);
+
+/* a SACCH block was received from the MS sending at ms_power, 1 if a
+ * new power level was set */
+int ms_power_ctrl_meas(struct gsm_lchan *lchan, int target_dbm,
+		       uint8_t ms_power, int rssi_dbm, unsigned int ber10k);
+
+#endif /* _OSMO_BTS_MS_POWER_CTRL_H */
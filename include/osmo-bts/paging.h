@@ -2,12 +2,47 @@
 #define OSMO_BTS_PAGING_H
 
 #include <stdint.h>
+#include <osmocom/core/utils.h>
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/protocol/gsm_04_08.h>
 
 struct paging_state;
 struct gsm_bts_role_bts;
 
+/* priority classes of the paging queues, highest first.  The eMLPP
+ * priorities of TS 44.018 10.5.2.24 are mapped onto them. */
+enum paging_prio {
+	PAGING_PRIO_AB,		/* eMLPP A and B, emergency */
+	PAGING_PRIO_0_1,
+	PAGING_PRIO_2_4,
+	PAGING_PRIO_NONE,	/* no eMLPP priority */
+	_NUM_PAGING_PRIO
+};
+
+extern const struct value_string paging_prio_names[];
+
+struct paging_prio_stats {
+	uint64_t added;
+	uint64_t dropped;	/* queue full, nothing to preempt */
+	uint64_t preempted;	/* removed for a higher priority */
+	uint64_t expired;
+	uint64_t sent;		/* identities sent on the PCH */
+};
+
+struct paging_stats {
+	uint64_t added;		/* identities added to the queue */
+	uint64_t duplicates;	/* ... that were already queued */
+	uint64_t dropped;	/* ... that found the queue full */
+	uint64_t expired;	/* records removed after their lifetime */
+	uint64_t lookups;	/* duplicate lookups */
+	uint64_t lookup_cmps;	/* records compared during lookups */
+	uint64_t pch_blocks[5];	/* PCH blocks by number of identities */
+	uint64_t pch_imm_ass;	/* PCH blocks with an IMM.ASS */
+	unsigned int max_queue_len;
+	unsigned int pool_size;	/* paging records allocated */
+	struct paging_prio_stats prio[_NUM_PAGING_PRIO];
+};
+
 /* initialize paging code */
 struct paging_state *paging_init(struct gsm_bts_role_bts *btsb, 
 				 unsigned int num_paging_max,
@@ -31,22 +66,39 @@ void paging_set_lifetime(struct paging_state *ps, unsigned int lifetime);
 /* update with new SYSTEM INFORMATION parameters */
 int paging_si_update(struct paging_state *ps, struct gsm48_control_channel_descr *chan_desc);
 
-/* Add an identity to the paging queue */
-int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
-			const uint8_t *identity_lv, uint8_t chan_needed);
+/* Add an identity to the paging queue, ccch is the number of the CCCH
+ * as returned by bts_ccch_index() */
+int paging_add_identity(struct paging_state *ps, uint8_t ccch,
+			uint8_t paging_group, const uint8_t *identity_lv,
+			uint8_t chan_needed, uint8_t emlpp_prio);
 
 /* Add an IMM.ASS message to the paging queue */
-int paging_add_imm_ass(struct paging_state *ps, const uint8_t *data,
-                       uint8_t len);
+int paging_add_imm_ass(struct paging_state *ps, uint8_t ccch,
+		       const uint8_t *data, uint8_t len);
+
+/* generate paging message of a CCCH for given gsm time */
+int paging_gen_msg(struct paging_state *ps, uint8_t ccch, uint8_t *out_buf,
+		   struct gsm_time *gt, int *is_empty);
+
+
+/* age in frames of the most urgent message of the paging block at the
+ * given time, -1 if there is nothing new to send in it */
+int paging_block_age(struct paging_state *ps, uint8_t ccch,
+		     struct gsm_time *gt);
 
-/* generate paging message for given gsm time */
-int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *gt,
-		   int *is_empty);
+/* The time between two paging blocks of a paging group, in frames */
+unsigned int paging_get_cycle_frames(struct paging_state *ps);
 
+/* histogram of the paging groups by their share of used PCH blocks
+ * since the last call */
+void paging_group_occupancy(struct paging_state *ps, unsigned int *hist,
+			    unsigned int num_bins);
 
 /* inspection methods below */
-int paging_group_queue_empty(struct paging_state *ps, uint8_t group);
+int paging_group_queue_empty(struct paging_state *ps, uint8_t ccch,
+			     uint8_t group);
 int paging_queue_length(struct paging_state *ps);
 int paging_buffer_space(struct paging_state *ps);
+const struct paging_stats *paging_get_stats(struct paging_state *ps);
 
 #endif
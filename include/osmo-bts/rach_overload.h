@@ -0,0 +1,87 @@
+#ifndef _OSMO_BTS_RACH_OVERLOAD_H
+#define _OSMO_BTS_RACH_OVERLOAD_H
+
+#include <stdint.h>
+#include <osmocom/core/timer.h>
+
+struct gsm_bts;
+
+/* every overload level lets 10% less CHAN RQD through, but at least
+ * 10% always do */
+#define RACH_OVLD_NUM_STEPS	10
+#define RACH_OVLD_MAX_LEVEL	9
+
+/* the controller runs that often */
+#define RACH_OVLD_TICK_MS	100
+
+/* overload that lasts that long raises the level by one */
+#define RACH_OVLD_RAISE_MS	500
+
+/* CHAN RQD remembered to measure the response time of the BSC */
+#define RACH_OVLD_REQ_HIST	32
+
+/* SYSTEM INFORMATION with RACH Control Parameters */
+#define RACH_OVLD_NUM_SI	5
+
+/* off until the operator sets a threshold */
+#define RACH_OVLD_RACH_THRESH_DEFAULT	0	/* per second */
+#define RACH_OVLD_AGCH_THRESH_DEFAULT	0	/* % */
+#define RACH_OVLD_ABIS_THRESH_DEFAULT	0	/* ms */
+#define RACH_OVLD_RELEASE_DEFAULT	2000	/* ms */
+
+struct rach_overload_stats {
+	uint64_t admitted;	/* CHAN RQD sent to the BSC */
+	uint64_t emergency;	/* ... of which for emergency calls */
+	uint64_t dropped;	/* RACH not passed on */
+	uint64_t overloads;	/* times the level left 0 */
+};
+
+struct rach_overload {
+	/* configuration, a threshold of 0 disables the criterion */
+	unsigned int rach_thresh;	/* RACH per second */
+	unsigned int agch_thresh;	/* AGCH queue, % of its limit */
+	unsigned int abis_thresh_ms;	/* CHAN RQD until IMM ASS (REJ) */
+	unsigned int release_ms;	/* per level without overload */
+	int acc_barring;		/* bar access classes in the SI */
+
+	int level;			/* 0..RACH_OVLD_MAX_LEVEL */
+	unsigned int raise_ticks;	/* ticks in overload */
+	unsigned int release_ticks;	/* ticks without overload */
+	unsigned int rach_count;	/* RACH in the current tick */
+	unsigned int credit;		/* CHAN RQD allowed, in 1/1000 */
+	unsigned int abis_delay_ms;	/* average response time */
+	unsigned int abis_answers;	/* ... samples in the current tick */
+
+	/* request references of the last CHAN RQD */
+	struct {
+		uint8_t ref[3];
+		uint8_t valid;
+		uint32_t fn;
+	} req[RACH_OVLD_REQ_HIST];
+	unsigned int req_next;
+
+	/* access classes of the SI as set by the BSC, and as broadcast */
+	struct {
+		uint8_t t2, t3;
+		uint8_t t2_tx, t3_tx;
+	} acc[RACH_OVLD_NUM_SI];
+	unsigned int acc_rotate;	/* first access class barred */
+	unsigned int ticks;
+
+	struct osmo_timer_list timer;
+	struct rach_overload_stats stats;
+};
+
+void rach_overload_init(struct gsm_bts *bts);
+
+/* decide whether a RACH is passed on to the BSC as CHAN RQD */
+int rach_overload_admit(struct gsm_bts *bts, uint8_t ra, uint32_t fn);
+
+/* re-apply the access class barring to the SI */
+void rach_overload_update_si(struct gsm_bts *bts);
+
+/* an IMMEDIATE ASSIGNMENT (REJECT) arrived from the BSC */
+void rach_overload_imm_ass(struct gsm_bts *bts, const uint8_t *data,
+			   unsigned int len);
+
+#endif /* _OSMO_BTS_RACH_OVERLOAD_H */
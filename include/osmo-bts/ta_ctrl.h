@@ -0,0 +1,43 @@
+#ifndef _OSMO_BTS_TA_CTRL_H
+#define _OSMO_BTS_TA_CTRL_H
+
+#include <stdint.h>
+
+struct gsm_bts;
+struct gsm_lchan;
+
+#define TA_CTRL_HYST_DEFAULT		3	/* quarter bits */
+#define TA_CTRL_INTERVAL_DEFAULT	2	/* SACCH periods */
+#define TA_CTRL_MAX_STEP_DEFAULT	1	/* bits */
+
+/* configuration, per BTS */
+struct ta_ctrl {
+	int enabled;
+	unsigned int hyst_qb;		/* offset that is tolerated */
+	unsigned int interval;		/* periods between two changes */
+	unsigned int max_step;		/* largest change at once */
+
+	uint64_t changes;		/* of the TA of any lchan */
+};
+
+/* state of a lchan */
+struct ta_ctrl_lchan {
+	int16_t offs_qb;		/* average of the last period */
+	uint8_t valid;			/* ... if there was one */
+	uint8_t hold;			/* periods until the next change */
+	uint8_t pending;		/* until the MS reports the new TA */
+	uint32_t changes;		/* since activation */
+};
+
+void ta_ctrl_init(struct gsm_bts *bts);
+
+/* the BSC set the TA of a lchan */
+void ta_ctrl_reset(struct gsm_lchan *lchan);
+
+/* a measurement period ended with that average timing offset */
+void ta_ctrl_meas(struct gsm_lchan *lchan, int offs_qb);
+
+/* MS Timing Offset IE value of the last period, -1 if unknown */
+int ta_ctrl_ms_timing_offset(struct gsm_lchan *lchan);
+
+#endif /* _OSMO_BTS_TA_CTRL_H */
@@ -73,4 +73,6 @@ int get_p_trxout_actual_mdBm_lchan(struct gsm_lchan *lchan);
 
 int power_ramp_start(struct gsm_bts_trx *trx, int p_total_tgt_mdBm, int bypass);
 
+int power_ctrl_change(struct gsm_bts_trx *trx, int p_total_tgt_mdBm);
+
 void power_trx_change_compl(struct gsm_bts_trx *trx, int p_trxout_cur_mdBm);
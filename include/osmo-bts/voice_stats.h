@@ -0,0 +1,64 @@
+#ifndef _OSMO_BTS_VOICE_STATS_H
+#define _OSMO_BTS_VOICE_STATS_H
+
+#include <stdint.h>
+
+struct gsm_lchan;
+
+/* per-lchan voice path counters, updated for every TCH block */
+struct voice_stats {
+	/* downlink: RTP -> L1 */
+	uint32_t dl_rtp_frames;		/* payloads received via RTP */
+	uint32_t dl_blocks;		/* TCH blocks requested by L1 */
+	uint32_t dl_underruns;		/* ... with nothing queued for them */
+	/* uplink: L1 -> RTP */
+	uint32_t ul_frames;		/* TCH blocks received from L1 */
+	uint32_t ul_bfi;		/* ... that were bad frames */
+};
+
+/* snapshot of the voice quality of one call */
+struct voice_quality {
+	struct voice_stats cnt;
+	/* as seen by the RTP stack (RFC 3550) */
+	uint32_t rtp_tx_pkts;
+	uint32_t rtp_tx_octets;
+	uint32_t rtp_rx_pkts;
+	uint32_t rtp_rx_octets;
+	uint32_t rtp_rx_lost;
+	uint32_t rtp_jitter_ms;		/* interarrival jitter */
+	/* derived values */
+	unsigned int dl_loss_pm;	/* RTP packet loss, per mille */
+	unsigned int ul_bfi_pm;		/* uplink bad frames, per mille */
+	unsigned int mos_dl;		/* MOS estimate * 100 */
+	unsigned int mos_ul;
+};
+
+static inline void voice_stats_dl_rtp(struct voice_stats *vs)
+{
+	vs->dl_rtp_frames++;
+}
+
+static inline void voice_stats_dl_block(struct voice_stats *vs, int underrun)
+{
+	vs->dl_blocks++;
+	if (underrun)
+		vs->dl_underruns++;
+}
+
+static inline void voice_stats_ul_frame(struct voice_stats *vs, int bfi)
+{
+	vs->ul_frames++;
+	if (bfi)
+		vs->ul_bfi++;
+}
+
+unsigned int voice_mos_estimate(uint8_t tch_mode, int full_rate,
+				unsigned int loss_pm, unsigned int delay_ms);
+
+struct voice_stats *lchan_voice_stats(struct gsm_lchan *lchan);
+void lchan_voice_stats_reset(struct gsm_lchan *lchan);
+void lchan_voice_quality(struct gsm_lchan *lchan, struct voice_quality *vq);
+void lchan_voice_quality_log(struct gsm_lchan *lchan,
+			     const struct voice_quality *vq);
+
+#endif /* _OSMO_BTS_VOICE_STATS_H */
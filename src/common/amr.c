@@ -1,7 +1,9 @@
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 
 #include <osmocom/core/logging.h>
+#include <osmocom/core/utils.h>
 
 #include <osmo-bts/logging.h>
 #include <osmo-bts/amr.h>
@@ -67,19 +69,21 @@ int amr_parse_mr_conf(struct amr_multirate_conf *amr_mrc,
 		}
 	}
 
+	/* threshold/hysteresis of mode[i] apply to the switch between
+	 * mode[i] and mode[i+1] */
 	if (num_codecs >= 2) {
-		amr_mrc->mode[0].threshold = mr_conf[1] & 0x3F;
-		amr_mrc->mode[0].hysteresis = mr_conf[2] >> 4;
+		amr_mrc->mode[0].threshold = mr_conf[2] & 0x3F;
+		amr_mrc->mode[0].hysteresis = mr_conf[3] >> 4;
 	}
 	if (num_codecs >= 3) {
 		amr_mrc->mode[1].threshold =
-			((mr_conf[2] & 0xF) << 2) | (mr_conf[3] >> 6);
-		amr_mrc->mode[1].hysteresis = (mr_conf[3] >> 2) & 0x7;
+			((mr_conf[3] & 0xF) << 2) | (mr_conf[4] >> 6);
+		amr_mrc->mode[1].hysteresis = (mr_conf[4] >> 2) & 0xF;
 	}
 	if (num_codecs >= 4) {
-		amr_mrc->mode[3].threshold =
-			((mr_conf[3] & 0x3) << 4) | (mr_conf[4] >> 4);
-		amr_mrc->mode[3].hysteresis = mr_conf[4] & 0xF;
+		amr_mrc->mode[2].threshold =
+			((mr_conf[4] & 0x3) << 4) | (mr_conf[5] >> 4);
+		amr_mrc->mode[2].hysteresis = mr_conf[5] & 0xF;
 	}
 
 	return num_codecs;
@@ -115,3 +119,79 @@ unsigned int amr_get_initial_mode(struct gsm_lchan *lchan)
 		}
 	}
 }
+
+/*! \brief (re-)start the AMR link adaptation of a logical channel */
+void amr_la_init(struct amr_link_adapt *la, struct gsm_lchan *lchan)
+{
+	memset(la, 0, sizeof(*la));
+	la->mode_idx = amr_get_initial_mode(lchan);
+	if (la->mode_idx >= ARRAY_SIZE(la->residency))
+		la->mode_idx = 0;
+}
+
+/*! \brief feed one uplink TCH measurement into the AMR link adaptation
+ *  \param[in] la link adaptation state of the lchan
+ *  \param[in] amr_mrc active codec set with thresholds and hysteresis
+ *  \param[in] ci_cB C/I of the frame in centiBel
+ *  \param[in] ber10k bit error rate of the frame in 1/10000
+ *  \returns index into amr_mrc->mode[] the MS should use on the uplink
+ *
+ * Implements the threshold/hysteresis rule of TS 45.009 3.3 on a
+ * filtered C/I: go up from mode[i] if C/I exceeds threshold[i] +
+ * hysteresis[i], go down from mode[i+1] if it falls below threshold[i].
+ * A high bit error rate prevents going up and forces going down.  At
+ * most one step is taken per AMR_LA_HOLDOFF frames.
+ */
+unsigned int amr_la_ul_meas(struct amr_link_adapt *la,
+			    const struct amr_multirate_conf *amr_mrc,
+			    int ci_cB, unsigned int ber10k)
+{
+	unsigned int idx = la->mode_idx;
+	int thresh_cB;
+
+	if (la->num_meas == 0) {
+		la->ci_avg_cB = ci_cB;
+		la->ber_avg10k = ber10k;
+	} else {
+		la->ci_avg_cB += (ci_cB - la->ci_avg_cB) / AMR_LA_AVG_WEIGHT;
+		la->ber_avg10k += ((int) ber10k - (int) la->ber_avg10k)
+							/ AMR_LA_AVG_WEIGHT;
+	}
+	la->num_meas++;
+	la->residency[idx]++;
+
+	if (la->holdoff) {
+		la->holdoff--;
+		return idx;
+	}
+	if (amr_mrc->num_modes < 2 || la->num_meas < AMR_LA_HOLDOFF)
+		return idx;
+	if (idx >= amr_mrc->num_modes)
+		idx = amr_mrc->num_modes - 1;
+
+	/* thresholds and hysteresis are coded in 0.5 dB steps */
+	if (idx + 1 < amr_mrc->num_modes &&
+	    la->ber_avg10k < AMR_LA_BER_UP) {
+		thresh_cB = (amr_mrc->mode[idx].threshold +
+			     amr_mrc->mode[idx].hysteresis) * 5;
+		if (la->ci_avg_cB > thresh_cB)
+			idx++;
+	}
+	if (idx == la->mode_idx && idx > 0) {
+		thresh_cB = amr_mrc->mode[idx-1].threshold * 5;
+		if (la->ci_avg_cB < thresh_cB ||
+		    la->ber_avg10k > AMR_LA_BER_DOWN)
+			idx--;
+	}
+
+	if (idx != la->mode_idx) {
+		LOGP(DL1C, LOGL_INFO, "AMR link adaptation: mode[%u] -> "
+			"mode[%u] (C/I %d cB, BER %u/10000)\n", la->mode_idx,
+			idx, la->ci_avg_cB, la->ber_avg10k);
+		la->mode_idx = idx;
+		la->num_changes++;
+		la->holdoff = AMR_LA_HOLDOFF;
+	}
+
+	return idx;
+}
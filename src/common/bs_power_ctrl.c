@@ -0,0 +1,209 @@
+/* Downlink power control of dedicated channels */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The BS Power the BSC sets for a lchan is the highest power we use on
+ * it.  With every MEASUREMENT REPORT the downlink level and quality the
+ * MS measured are compared with the target level: below target - hyst
+ * or with a RXQUAL worse than rxqual_max the power is raised by
+ * raise_db, above target + hyst it is lowered by up to lower_db, never
+ * more than max_red_db below the BS Power of the BSC.
+ *
+ * The BCCH carrier has to be sent with constant power on all its
+ * timeslots (TS 45.008 7.1), so its lchans are left alone.
+ *
+ * The PHY may only have one transmit power for the whole TRX, then it
+ * sends with the highest power any active lchan of the TRX asks for.
+ * That is the power the MS measured, so each step is taken from it and
+ * not from the power the lchan asked for last time: a lchan near the
+ * BTS can not drift to its maximum reduction while another one keeps
+ * the TRX up, and the TRX only goes down once all its lchans agree.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/bs_power_ctrl.h>
+
+const struct value_string bs_pwr_ctrl_mode_names[] = {
+	{ BS_PWR_CTRL_OFF,	"off" },
+	{ BS_PWR_CTRL_ON,	"on" },
+	{ 0, NULL }
+};
+
+static struct bs_power_lchan *lchan_bs_power(struct gsm_lchan *lchan)
+{
+	return &lchan_bts_state(lchan)->bs_power;
+}
+
+void bs_power_ctrl_reset(struct gsm_lchan *lchan, int fixed)
+{
+	struct bs_power_lchan *bp = lchan_bs_power(lchan);
+
+	memset(bp, 0, sizeof(*bp));
+	bp->base = lchan->bs_power & 0x0f;
+	bp->fixed = fixed;
+	bp->red_min = 0xff;
+}
+
+unsigned int bs_power_ctrl_avg_red(struct gsm_lchan *lchan)
+{
+	struct bs_power_lchan *bp = lchan_bs_power(lchan);
+
+	if (!bp->num)
+		return 0;
+
+	return (bp->red_sum * 2 + bp->num / 2) / bp->num;
+}
+
+static int bs_power_ctrl_active(struct gsm_lchan *lchan)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+	struct bs_power_ctrl *bpc = &bts_role_bts(bts)->bs_power_ctrl;
+
+	if (bpc->mode != BS_PWR_CTRL_ON)
+		return 0;
+	if (lchan->ts->trx == bts->c0)
+		return 0;
+
+	return !lchan_bs_power(lchan)->fixed;
+}
+
+int bs_power_ctrl_trx_power(struct gsm_bts_trx *trx)
+{
+	int bs_power = -1;
+	int tn, ss;
+
+	for (tn = 0; tn < ARRAY_SIZE(trx->ts); tn++) {
+		for (ss = 0; ss < ARRAY_SIZE(trx->ts[tn].lchan); ss++) {
+			struct gsm_lchan *l = &trx->ts[tn].lchan[ss];
+
+			if (l->state != LCHAN_S_ACTIVE)
+				continue;
+			if (bs_power < 0 || (l->bs_power & 0x0f) < bs_power)
+				bs_power = l->bs_power & 0x0f;
+		}
+	}
+
+	return bs_power;
+}
+
+void bs_power_ctrl_apply(struct gsm_lchan *lchan)
+{
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+
+	if (bts_role_bts(bts)->bs_power_ctrl.mode == BS_PWR_CTRL_ON
+	    && lchan->ts->trx != bts->c0)
+		bts_model_adjst_bs_pwr(lchan);
+}
+
+void bs_power_ctrl_meas(struct gsm_lchan *lchan, const uint8_t *l3,
+			unsigned int l3_len)
+{
+	struct gsm_bts_trx *trx = lchan->ts->trx;
+	struct bs_power_ctrl *bpc = &bts_role_bts(trx->bts)->bs_power_ctrl;
+	struct bs_power_lchan *bp = lchan_bs_power(lchan);
+	unsigned int rxlev, rxqual, red, max_red;
+	int tx_pwr = -1;
+
+	/* the power the MS measured, that of the whole TRX */
+	if (bpc->mode == BS_PWR_CTRL_ON && trx != trx->bts->c0)
+		tx_pwr = bs_power_ctrl_trx_power(trx);
+	if (tx_pwr < 0)
+		tx_pwr = lchan->bs_power & 0x0f;
+	lchan->meas.bts_tx_pwr = (lchan->bs_power & ~0x0f) | tx_pwr;
+
+	if (l3_len < 5 || l3[1] != GSM48_MT_RR_MEAS_REP)
+		return;
+	/* TS 44.018 10.5.2.20, MEAS-VALID is 0 if they are valid */
+	if (l3[3] & 0x40)
+		return;
+
+	/* with DTX only the SUB values are meaningful */
+	if (l3[2] & 0x40) {
+		rxlev = l3[3] & 0x3f;
+		rxqual = (l3[4] >> 1) & 0x07;
+	} else {
+		rxlev = l3[2] & 0x3f;
+		rxqual = (l3[4] >> 4) & 0x07;
+	}
+
+	red = tx_pwr > bp->base ? tx_pwr - bp->base : 0;
+
+	if (red < bp->red_min)
+		bp->red_min = red;
+	if (red > bp->red_max)
+		bp->red_max = red;
+	bp->red_sum += red;
+	bp->num++;
+
+	if (bs_power_ctrl_active(lchan)) {
+		max_red = bpc->max_red_db / 2;
+		if (bp->base + max_red > 0x0f)
+			max_red = 0x0f - bp->base;
+
+		if (rxqual > bpc->rxqual_max
+		    || rxlev + bpc->hyst < bpc->target) {
+			unsigned int step = (bpc->raise_db + 1) / 2;
+
+			red = red > step ? red - step : 0;
+		} else if (rxlev > bpc->target + bpc->hyst) {
+			unsigned int step = (bpc->lower_db + 1) / 2;
+
+			/* not below the target */
+			if (step > (rxlev - bpc->target) / 2)
+				step = (rxlev - bpc->target) / 2;
+			red += step;
+			if (red > max_red)
+				red = max_red;
+		}
+
+		if (bp->base + red != (lchan->bs_power & 0x0f)) {
+			DEBUGP(DMEAS, "%s RXLEV %u RXQUAL %u, BS Power %u -> "
+				"%u\n", gsm_lchan_name(lchan), rxlev, rxqual,
+				lchan->bs_power & 0x0f, bp->base + red);
+			lchan->bs_power = (lchan->bs_power & ~0x0f) |
+					  (bp->base + red);
+			bts_model_adjst_bs_pwr(lchan);
+			bp->changes++;
+			bpc->changes++;
+		}
+	}
+}
+
+void bs_power_ctrl_init(struct gsm_bts *bts)
+{
+	struct bs_power_ctrl *bpc = &bts_role_bts(bts)->bs_power_ctrl;
+
+	bpc->mode = BS_PWR_CTRL_OFF;
+	bpc->target = BS_PWR_CTRL_TARGET_DEFAULT;
+	bpc->hyst = BS_PWR_CTRL_HYST_DEFAULT;
+	bpc->raise_db = BS_PWR_CTRL_RAISE_DEFAULT;
+	bpc->lower_db = BS_PWR_CTRL_LOWER_DEFAULT;
+	bpc->max_red_db = BS_PWR_CTRL_MAX_RED_DEFAULT;
+	bpc->rxqual_max = BS_PWR_CTRL_RXQUAL_DEFAULT;
+}
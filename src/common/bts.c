@@ -67,6 +67,9 @@ static int bts_signal_cbfn(unsigned int subsys, unsigned int signal,
 	if (subsys == SS_GLOBAL && signal == S_NEW_SYSINFO) {
 		struct gsm_bts *bts = signal_data;
 
+		/* keep the access class barring in the SI of the BSC */
+		rach_overload_update_si(bts);
+		bts_sysinfo_sched_update(bts);
 		bts_update_agch_max_queue_length(bts);
 	}
 	return 0;
@@ -76,7 +79,7 @@ int bts_init(struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb;
 	struct gsm_bts_trx *trx;
-	int rc;
+	int rc, i;
 	static int initialized = 0;
 
 	/* add to list of BTSs */
@@ -86,8 +89,14 @@ int bts_init(struct gsm_bts *bts)
 
 	bts->role = btsb = talloc_zero(bts, struct gsm_bts_role_bts);
 
-	INIT_LLIST_HEAD(&btsb->agch_queue);
+	for (i = 0; i < ARRAY_SIZE(btsb->agch); i++) {
+		INIT_LLIST_HEAD(&btsb->agch[i].ass_queue);
+		INIT_LLIST_HEAD(&btsb->agch[i].rej_queue);
+	}
 	btsb->agch_queue_length = 0;
+	btsb->agch_queue_hard_limit = GSM_BTS_AGCH_QUEUE_HARD_LIMIT_DEFAULT;
+	btsb->ccch_sched.agch_target_ms = GSM_BTS_CCCH_AGCH_TARGET_DEFAULT;
+	btsb->ccch_sched.paging_target_ms = GSM_BTS_CCCH_PAGING_TARGET_DEFAULT;
 
 	/* enable management with default levels,
 	 * raise threshold to GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE to
@@ -103,6 +112,12 @@ int bts_init(struct gsm_bts *bts)
 	/* configurable via OML */
 	btsb->load.ccch.load_ind_period = 112;
 	load_timer_start(bts);
+	rach_overload_init(bts);
+	load_stats_init(bts);
+	meas_preproc_init(bts);
+	bs_power_ctrl_init(bts);
+	ms_power_ctrl_init(bts);
+	ta_ctrl_init(bts);
 	btsb->rtp_jitter_buf_ms = 100;
 	btsb->max_ta = 63;
 	btsb->ny1 = 4;
@@ -141,6 +156,12 @@ int bts_init(struct gsm_bts *bts)
 		tpp->ramp.step_interval_sec = 1;
 	}
 
+	btsb->num_lchan_state = bts->num_trx * TRX_NR_TS * TS_MAX_LCHAN;
+	btsb->lchan_state = talloc_zero_array(btsb, struct lchan_bts_state,
+					      btsb->num_lchan_state);
+	btsb->meas_sched = talloc_zero_array(btsb, struct trx_meas_sched,
+					     bts->num_trx);
+
 	osmo_rtp_init(tall_bts_ctx);
 
 	rc = bts_model_init(bts);
@@ -446,63 +467,136 @@ static int try_merge_imm_ass_rej(struct gsm48_imm_ass_rej *old_rej,
 	return 0;
 }
 
-int bts_agch_enqueue(struct gsm_bts *bts, struct msgb *msg)
+/* IMMEDIATE ASSIGNMENT EXTENDED without Mobile Allocation and
+ * Starting Time, see GSM 04.08, 9.1.19 */
+struct imm_ass_ext {
+	uint8_t l2_plen;
+	uint8_t proto_discr;
+	uint8_t msg_type;
+	uint8_t page_mode;
+	struct gsm48_chan_desc chan_desc1;
+	struct gsm48_req_ref req_ref1;
+	uint8_t timing_advance1;
+	struct gsm48_chan_desc chan_desc2;
+	struct gsm48_req_ref req_ref2;
+	uint8_t timing_advance2;
+	uint8_t mob_alloc_len;
+	uint8_t rest[0];
+} __attribute__ ((packed));
+
+/* Only an IMMEDIATE ASSIGNMENT of a dedicated channel without frequency
+ * hopping, starting time and rest octets fits into the extended one */
+static int imm_ass_packable(struct msgb *msg)
 {
-	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	int hard_limit = 1000;
-	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
+	struct gsm48_imm_ass *ia = msgb_l3(msg);
+	unsigned int len = msgb_l3len(msg);
+	unsigned int i;
 
-	if (btsb->agch_queue_length > hard_limit) {
-		LOGP(DSUM, LOGL_ERROR,
-		     "AGCH: too many messages in queue, "
-		     "refusing message type 0x%02x, length = %d/%d\n",
-		     ((struct gsm48_imm_ass *)msgb_l3(msg))->msg_type,
-		     btsb->agch_queue_length, btsb->agch_max_queue_length);
-
-		btsb->agch_queue_rejected_msgs++;
-		return -ENOMEM;
+	if (len < sizeof(*ia) || len > GSM_MACBLOCK_LEN)
+		return 0;
+	if (ia->msg_type != GSM48_MT_RR_IMM_ASS)
+		return 0;
+	/* dedicated mode or TBF, downlink assignment */
+	if (ia->page_mode & 0xf0)
+		return 0;
+	if (ia->mob_alloc_len != 0)
+		return 0;
+	for (i = sizeof(*ia); i < len; i++) {
+		if (msg->l3h[i] != 0x2b)
+			return 0;
 	}
+	return 1;
+}
 
-	if (btsb->agch_queue_length > 0) {
-		struct msgb *last_msg =
-			llist_entry(btsb->agch_queue.prev, struct msgb, list);
-		struct gsm48_imm_ass_rej *last_imm_ass_rej = msgb_l3(last_msg);
+static int try_pack_imm_ass(struct msgb *old_msg, struct msgb *new_msg)
+{
+	struct gsm48_imm_ass *old_ia = msgb_l3(old_msg);
+	struct gsm48_imm_ass *new_ia = msgb_l3(new_msg);
+	unsigned int old_len = msgb_l3len(old_msg);
+	uint8_t buf[GSM_MACBLOCK_LEN];
+	struct imm_ass_ext *ext = (struct imm_ass_ext *) buf;
 
-		if (try_merge_imm_ass_rej(last_imm_ass_rej, imm_ass_cmd)) {
-			btsb->agch_queue_merged_msgs++;
-			msgb_free(msg);
-			return 0;
-		}
-	}
+	if (!imm_ass_packable(old_msg) || !imm_ass_packable(new_msg))
+		return 0;
+	if (old_len < sizeof(buf) &&
+	    msgb_tailroom(old_msg) < sizeof(buf) - old_len)
+		return 0;
 
-	msgb_enqueue(&btsb->agch_queue, msg);
-	btsb->agch_queue_length++;
+	memset(buf, 0x2b, sizeof(buf));
+	ext->l2_plen = (sizeof(*ext) - 1) << 2 | 1;
+	ext->proto_discr = GSM48_PDISC_RR;
+	ext->msg_type = GSM48_MT_RR_IMM_ASS_EXT;
+	/* there is only one page mode, the later message has the more
+	 * recent one unless it says "same as before" */
+	if ((new_ia->page_mode & 0x03) == GSM48_PM_SAME)
+		ext->page_mode = old_ia->page_mode & 0x0f;
+	else
+		ext->page_mode = new_ia->page_mode & 0x0f;
+	ext->chan_desc1 = old_ia->chan_desc;
+	ext->req_ref1 = old_ia->req_ref;
+	ext->timing_advance1 = old_ia->timing_advance;
+	ext->chan_desc2 = new_ia->chan_desc;
+	ext->req_ref2 = new_ia->req_ref;
+	ext->timing_advance2 = new_ia->timing_advance;
+	ext->mob_alloc_len = 0;
+
+	if (old_len < sizeof(buf))
+		msgb_put(old_msg, sizeof(buf) - old_len);
+	memcpy(old_msg->l3h, buf, sizeof(buf));
+
+	return 1;
+}
 
-	return 0;
+/*! \brief CCCH number of a timeslot
+ *  \returns 0..3 for TS 0, 2, 4 and 6, -EINVAL otherwise */
+int bts_ccch_index(uint8_t tn)
+{
+	if (tn & 1 || tn / 2 >= BTS_MAX_CCCH)
+		return -EINVAL;
+	return tn / 2;
 }
 
-struct msgb *bts_agch_dequeue(struct gsm_bts *bts)
+/*! \brief number of CCCH timeslots configured on the BCCH carrier */
+int bts_num_ccch(struct gsm_bts *bts)
 {
-	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	struct msgb *msg = msgb_dequeue(&btsb->agch_queue);
-	if (!msg)
-		return NULL;
+	int i, num = 0;
+
+	for (i = 0; i < BTS_MAX_CCCH; i++) {
+		switch (bts->c0->ts[i * 2].pchan) {
+		case GSM_PCHAN_CCCH:
+		case GSM_PCHAN_CCCH_SDCCH4:
+		case GSM_PCHAN_CCCH_SDCCH4_CBCH:
+			num++;
+			break;
+		default:
+			break;
+		}
+	}
 
-	btsb->agch_queue_length--;
-	return msg;
+	return num;
+}
+
+/* pseudo random number in 0..0xffff for the early drop, a linear
+ * congruential generator is good enough for that */
+static int agch_prng(struct gsm_bts_role_bts *btsb)
+{
+	btsb->agch_prng = btsb->agch_prng * 1664525 + 1013904223;
+	return btsb->agch_prng >> 16;
 }
 
 /*
- * Remove lower prio messages if the queue has grown too long.
- *
- * \return 0 iff the number of messages in the queue would fit into the AGCH
- *         reserved part of the CCCH.
+ * Drop the oldest reject if the queue has grown too long.  The drop
+ * probability rises linearly between the low and the high water mark.
+ * This is done once for every message added to the queue and once for
+ * every block taken from it, so that it costs the same whatever the
+ * queue length and a queue that no longer grows still sheds its stale
+ * rejects.
  */
-static void compact_agch_queue(struct gsm_bts *bts)
+static void agch_early_drop(struct gsm_bts_role_bts *btsb, int ccch)
 {
-	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
-	struct msgb *msg, *msg2;
+	struct msgb *msg;
 	int max_len, slope, offs;
+	int64_t p_drop;
 	int level_low = btsb->agch_queue_low_level;
 	int level_high = btsb->agch_queue_high_level;
 	int level_thres = btsb->agch_queue_thresh_level;
@@ -512,7 +606,7 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	if (max_len == 0)
 		max_len = 1;
 
-	if (btsb->agch_queue_length < max_len * level_thres / 100)
+	if (btsb->agch[ccch].length < max_len * level_thres / 100)
 		return;
 
 	/* p^
@@ -529,61 +623,230 @@ static void compact_agch_queue(struct gsm_bts *bts)
 	else
 		slope = 0x10000 * max_len; /* p_drop >= 1 if len > offs */
 
-	llist_for_each_entry_safe(msg, msg2, &btsb->agch_queue, list) {
-		struct gsm48_imm_ass *imm_ass_cmd = msgb_l3(msg);
-		int p_drop;
+	p_drop = (int64_t) (btsb->agch[ccch].length - offs) * slope / max_len;
+
+	if (agch_prng(btsb) >= p_drop)
+		return;
 
-		if (imm_ass_cmd->msg_type != GSM48_MT_RR_IMM_ASS_REJ)
-			return;
+	/* IMMEDIATE ASSIGN REJECT */
+	msg = msgb_dequeue(&btsb->agch[ccch].rej_queue);
+	if (!msg)
+		return;
 
-		/* IMMEDIATE ASSIGN REJECT */
+	btsb->agch[ccch].length--;
+	btsb->agch_queue_length--;
+	msgb_free(msg);
+
+	btsb->agch_queue_dropped_msgs++;
+}
 
-		p_drop = (btsb->agch_queue_length - offs) * slope / max_len;
+int bts_agch_enqueue(struct gsm_bts *bts, uint8_t tn, struct msgb *msg)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct gsm48_imm_ass_rej *imm_ass_cmd = msgb_l3(msg);
+	int ccch = bts_ccch_index(tn);
 
-		if ((random() & 0xffff) >= p_drop)
-			return;
+	if (ccch < 0) {
+		LOGP(DSUM, LOGL_ERROR, "AGCH: no CCCH on TS %u\n", tn);
+		return -EINVAL;
+	}
 
-		llist_del(&msg->list);
-		btsb->agch_queue_length--;
+	/* Rejects are merged into the newest pending reject, all older
+	 * ones have no free request reference slots left.  What does not
+	 * fit stays in the new message.  An assignment is packed with the
+	 * last one still waiting for a partner into an IMMEDIATE
+	 * ASSIGNMENT EXTENDED. */
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_REJ) {
+		struct llist_head *rej_queue = &btsb->agch[ccch].rej_queue;
+
+		if (!llist_empty(rej_queue) &&
+		    try_merge_imm_ass_rej(msgb_l3(llist_entry(rej_queue->prev,
+							      struct msgb, list)),
+					  imm_ass_cmd)) {
+			btsb->agch_queue_merged_msgs++;
+			msgb_free(msg);
+			return 0;
+		}
+	} else if (btsb->agch[ccch].ass_unpaired &&
+		   try_pack_imm_ass(btsb->agch[ccch].ass_unpaired, msg)) {
+		btsb->agch[ccch].ass_unpaired = NULL;
+		btsb->agch_queue_packed_msgs++;
 		msgb_free(msg);
+		return 0;
+	}
+
+	agch_early_drop(btsb, ccch);
+
+	if (btsb->agch[ccch].length >= btsb->agch_queue_hard_limit) {
+		LOGP(DSUM, LOGL_ERROR,
+		     "AGCH: too many messages in queue of TS %u, "
+		     "refusing message type 0x%02x, length = %d/%d\n", tn,
+		     imm_ass_cmd->msg_type, btsb->agch[ccch].length,
+		     btsb->agch_queue_hard_limit);
+
+		btsb->agch_queue_rejected_msgs++;
+		return -ENOMEM;
+	}
+
+	/* for agch_queue_age() */
+	msg->cb[0] = btsb->ccch_sched.last_fn;
+
+	if (imm_ass_cmd->msg_type == GSM48_MT_RR_IMM_ASS_REJ) {
+		msgb_enqueue(&btsb->agch[ccch].rej_queue, msg);
+	} else {
+		msgb_enqueue(&btsb->agch[ccch].ass_queue, msg);
+		if (imm_ass_packable(msg))
+			btsb->agch[ccch].ass_unpaired = msg;
+	}
+	btsb->agch[ccch].length++;
+	btsb->agch_queue_length++;
 
-		btsb->agch_queue_dropped_msgs++;
+	return 0;
+}
+
+struct msgb *bts_agch_dequeue(struct gsm_bts *bts, uint8_t tn)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	int ccch = bts_ccch_index(tn);
+	struct msgb *msg;
+
+	if (ccch < 0)
+		return NULL;
+
+	msg = msgb_dequeue(&btsb->agch[ccch].ass_queue);
+	if (msg) {
+		if (msg == btsb->agch[ccch].ass_unpaired)
+			btsb->agch[ccch].ass_unpaired = NULL;
+	} else {
+		msg = msgb_dequeue(&btsb->agch[ccch].rej_queue);
+		if (!msg)
+			return NULL;
 	}
-	return;
+
+	btsb->agch[ccch].length--;
+	btsb->agch_queue_length--;
+	return msg;
 }
 
-int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t *out_buf, struct gsm_time *gt,
-		      int is_ag_res)
+/* age in frames of the oldest message in the AGCH queue, -1 if empty */
+static int agch_queue_age(struct gsm_bts_role_bts *btsb, int ccch,
+			  uint32_t fn)
+{
+	struct llist_head *queue[] = {
+		&btsb->agch[ccch].ass_queue,
+		&btsb->agch[ccch].rej_queue,
+	};
+	int i, age = -1;
+
+	for (i = 0; i < ARRAY_SIZE(queue); i++) {
+		struct msgb *msg;
+		int msg_age;
+
+		if (llist_empty(queue[i]))
+			continue;
+		msg = llist_entry(queue[i]->next, struct msgb, list);
+		msg_age = (fn + GSM_MAX_FN - msg->cb[0]) % GSM_MAX_FN;
+		if (msg_age > age)
+			age = msg_age;
+	}
+
+	return age;
+}
+
+/*
+ * Decide whether a PCH block is better spent on the AGCH.  Blocks
+ * reserved for the AGCH by BS_AG_BLKS_RES never carry paging, but the
+ * AGCH may use any PCH block (GSM 05.02, 6.5.1).  Repetitions of
+ * pagings that were sent already yield to any access grant.  If there
+ * is new paging as well, both waiting times are weighted with their
+ * target delay.  Paging that is put off waits a whole paging cycle for
+ * the next block of its group, an access grant only for the next block.
+ */
+static int agch_takes_pch_block(struct gsm_bts_role_bts *btsb, int ccch,
+				struct gsm_time *gt)
+{
+	int agch_age, paging_age, cycle;
+
+	agch_age = agch_queue_age(btsb, ccch, gt->fn);
+	if (agch_age < 0)
+		return 0;
+
+	paging_age = paging_block_age(btsb->paging_state, ccch, gt);
+	if (paging_age < 0)
+		return 1;
+
+	cycle = paging_get_cycle_frames(btsb->paging_state);
+	if ((int64_t) agch_age * btsb->ccch_sched.paging_target_ms <=
+	    (int64_t) (paging_age + cycle) * btsb->ccch_sched.agch_target_ms)
+		return 0;
+
+	btsb->ccch_sched.paging_deferred++;
+	return 1;
+}
+
+int bts_ccch_copy_msg(struct gsm_bts *bts, uint8_t tn, uint8_t *out_buf,
+		      struct gsm_time *gt, int is_ag_res)
 {
 	struct msgb *msg = NULL;
 	struct gsm_bts_role_bts *btsb = bts->role;
+	int ccch = bts_ccch_index(tn);
 	int rc = 0;
 	int is_empty = 1;
+	int pch_taken = 0;
 
-	/* Do queue house keeping.
-	 * This needs to be done every time a CCCH message is requested, since
-	 * the queue max length is calculated based on the CCCH block rate and
-	 * PCH messages also reduce the drain of the AGCH queue.
-	 */
-	compact_agch_queue(bts);
+	if (ccch < 0)
+		return -EINVAL;
+
+	btsb->ccch_sched.last_fn = gt->fn;
+
+	/* BCCH Ext takes the first CCCH block of the BCCH timeslot,
+	 * which the BSC reserved for the AGCH (GSM 05.02, 6.3.1.3) */
+	if (is_ag_res && tn == 0 && gt->t3 >= 6 && gt->t3 <= 9) {
+		uint8_t *si = bts_sysinfo_get_ext(bts, gt);
+
+		if (si) {
+			memcpy(out_buf, si, GSM_MACBLOCK_LEN);
+			return GSM_MACBLOCK_LEN;
+		}
+	}
 
 	/* Check for paging messages first if this is PCH */
-	if (!is_ag_res)
-		rc = paging_gen_msg(btsb->paging_state, out_buf, gt, &is_empty);
+	if (!is_ag_res) {
+		if (agch_takes_pch_block(btsb, ccch, gt)) {
+			btsb->load.ccch.pch_total += 1;
+			pch_taken = 1;
+		} else
+			rc = paging_gen_msg(btsb->paging_state, ccch, out_buf,
+					    gt, &is_empty);
+	}
 
 	/* Check whether the block may be overwritten */
-	if (!is_empty)
+	if (!is_empty) {
+		btsb->ccch_sched.paging_blocks++;
 		return rc;
+	}
 
-	msg = bts_agch_dequeue(bts);
-	if (!msg)
+	agch_early_drop(btsb, ccch);
+
+	msg = bts_agch_dequeue(bts, tn);
+	if (!msg) {
+		btsb->ccch_sched.idle_blocks++;
 		return rc;
+	}
+
+	load_stats_agch_wait(btsb, (gt->fn + GSM_MAX_FN - msg->cb[0]) %
+			     GSM_MAX_FN);
 
 	/* Copy AGCH message */
 	memcpy(out_buf, msgb_l3(msg), msgb_l3len(msg));
 	rc = msgb_l3len(msg);
+	memset(out_buf + rc, 0x2b, GSM_MACBLOCK_LEN - rc);
 	msgb_free(msg);
 
+	/* the PCH block given to the AGCH is in use all the same */
+	if (pch_taken)
+		btsb->load.ccch.pch_used += 1;
+
 	if (is_ag_res)
 		btsb->agch_queue_agch_msgs++;
 	else
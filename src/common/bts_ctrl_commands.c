@@ -29,6 +29,8 @@
 #include <osmo-bts/logging.h>
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/tx_power.h>
+#include <osmo-bts/voice_stats.h>
+#include <osmo-bts/load_stats.h>
 
 CTRL_CMD_DEFINE(therm_att, "thermal-attenuation");
 static int get_therm_att(struct ctrl_cmd *cmd, void *data)
@@ -67,12 +69,248 @@ static int verify_therm_att(struct ctrl_cmd *cmd, const char *value, void *data)
 	return 0;
 }
 
+CTRL_CMD_DEFINE(voice_qual, "voice-quality");
+static int get_voice_qual(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts_trx_ts *ts = cmd->node;
+	int i;
+
+	cmd->reply = talloc_strdup(cmd, "");
+
+	for (i = 0; i < ARRAY_SIZE(ts->lchan); i++) {
+		struct gsm_lchan *lchan = &ts->lchan[i];
+		struct voice_quality vq;
+
+		if (!lchan->abis_ip.rtp_socket)
+			continue;
+
+		lchan_voice_quality(lchan, &vq);
+		cmd->reply = talloc_asprintf_append(cmd->reply,
+				"%s%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+				cmd->reply[0] ? ";" : "", lchan->nr,
+				vq.rtp_rx_pkts, vq.rtp_rx_lost,
+				vq.rtp_jitter_ms, vq.cnt.dl_underruns,
+				vq.cnt.dl_blocks, vq.cnt.ul_bfi,
+				vq.cnt.ul_frames, vq.mos_dl, vq.mos_ul);
+	}
+
+	if (!cmd->reply[0]) {
+		cmd->reply = "No voice call on this timeslot";
+		return CTRL_CMD_ERROR;
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_voice_qual(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_voice_qual(struct ctrl_cmd *cmd, const char *value,
+			     void *data)
+{
+	return 0;
+}
+
+CTRL_CMD_DEFINE(bs_power, "bs-power");
+static int get_bs_power(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts_trx_ts *ts = cmd->node;
+	int i;
+
+	cmd->reply = talloc_strdup(cmd, "");
+
+	for (i = 0; i < ARRAY_SIZE(ts->lchan); i++) {
+		struct gsm_lchan *lchan = &ts->lchan[i];
+		struct bs_power_lchan *bp = &lchan_bts_state(lchan)->bs_power;
+
+		if (lchan->state != LCHAN_S_ACTIVE || !bp->num)
+			continue;
+
+		cmd->reply = talloc_asprintf_append(cmd->reply,
+				"%s%u,%u,%u,%u,%u,%u,%u",
+				cmd->reply[0] ? ";" : "", lchan->nr,
+				(lchan->bs_power & 0x0f) * 2, bp->base * 2,
+				bp->red_min * 2, bp->red_max * 2,
+				bs_power_ctrl_avg_red(lchan), bp->changes);
+	}
+
+	if (!cmd->reply[0]) {
+		cmd->reply = "No measurement report on this timeslot";
+		return CTRL_CMD_ERROR;
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_bs_power(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_bs_power(struct ctrl_cmd *cmd, const char *value,
+			   void *data)
+{
+	return 0;
+}
+
+CTRL_CMD_DEFINE(ms_power, "ms-power");
+static int get_ms_power(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts_trx_ts *ts = cmd->node;
+	int i;
+
+	cmd->reply = talloc_strdup(cmd, "");
+
+	for (i = 0; i < ARRAY_SIZE(ts->lchan); i++) {
+		struct gsm_lchan *lchan = &ts->lchan[i];
+		struct ms_power_lchan *mp = &lchan_bts_state(lchan)->ms_power;
+
+		if (lchan->state != LCHAN_S_ACTIVE || !mp->blocks)
+			continue;
+
+		cmd->reply = talloc_asprintf_append(cmd->reply,
+				"%s%u,%u,%u,%u,%u",
+				cmd->reply[0] ? ";" : "", lchan->nr,
+				lchan->ms_power_ctrl.current, mp->blocks,
+				mp->raised, mp->lowered);
+	}
+
+	if (!cmd->reply[0]) {
+		cmd->reply = "No SACCH block on this timeslot";
+		return CTRL_CMD_ERROR;
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_ms_power(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_ms_power(struct ctrl_cmd *cmd, const char *value,
+			   void *data)
+{
+	return 0;
+}
+
+CTRL_CMD_DEFINE(load_avg, "load-averages");
+static int get_load_avg(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts *bts = cmd->node;
+	int var, tc;
+
+	/* one name,1s,10s,60s tuple per value, the shares are in % */
+	cmd->reply = talloc_asprintf(cmd, "pch-load");
+	for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++) {
+		unsigned int val = load_stats_pch_load(bts, tc);
+		cmd->reply = talloc_asprintf_append(cmd->reply, ",%u.%u",
+						    val / 10, val % 10);
+	}
+	cmd->reply = talloc_asprintf_append(cmd->reply, ";rach-load");
+	for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++) {
+		unsigned int val = load_stats_rach_load(bts, tc);
+		cmd->reply = talloc_asprintf_append(cmd->reply, ",%u.%u",
+						    val / 10, val % 10);
+	}
+	for (var = 0; var < _NUM_LOAD_STATS_VAR; var++) {
+		cmd->reply = talloc_asprintf_append(cmd->reply, ";%s",
+				get_value_string(load_stats_var_names, var));
+		for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++) {
+			unsigned int val = load_stats_avg(bts, var, tc);
+			cmd->reply = talloc_asprintf_append(cmd->reply,
+					",%u.%03u", val / 1000, val % 1000);
+		}
+	}
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_load_avg(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_load_avg(struct ctrl_cmd *cmd, const char *value,
+			   void *data)
+{
+	return 0;
+}
+
+CTRL_CMD_DEFINE(agch_wait, "agch-wait-histogram");
+static int get_agch_wait(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts *bts = cmd->node;
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+	int i;
+
+	/* upper bound in ms and count of each bin, the last is open */
+	cmd->reply = talloc_strdup(cmd, "");
+	for (i = 0; i < LOAD_STATS_WAIT_BINS; i++)
+		cmd->reply = talloc_asprintf_append(cmd->reply, "%s%u,%llu",
+				i ? ";" : "", load_stats_wait_bound_ms[i],
+				(unsigned long long) ls->agch_wait[i]);
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_agch_wait(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_agch_wait(struct ctrl_cmd *cmd, const char *value,
+			    void *data)
+{
+	return 0;
+}
+
+CTRL_CMD_DEFINE(group_occ, "paging-group-occupancy");
+static int get_group_occ(struct ctrl_cmd *cmd, void *data)
+{
+	struct gsm_bts *bts = cmd->node;
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+	int i;
+
+	/* number of paging groups with 0-9%, 10-19%, .. used blocks */
+	cmd->reply = talloc_strdup(cmd, "");
+	for (i = 0; i < LOAD_STATS_GROUP_BINS; i++)
+		cmd->reply = talloc_asprintf_append(cmd->reply, "%s%u",
+				i ? "," : "", ls->group_occ[i]);
+
+	return CTRL_CMD_REPLY;
+}
+
+static int set_group_occ(struct ctrl_cmd *cmd, void *data)
+{
+	cmd->reply = "Read Only attribute";
+	return CTRL_CMD_ERROR;
+}
+
+static int verify_group_occ(struct ctrl_cmd *cmd, const char *value,
+			    void *data)
+{
+	return 0;
+}
 
 int bts_ctrl_cmds_install(struct gsm_bts *bts)
 {
 	int rc = 0;
 
 	rc |= ctrl_cmd_install(CTRL_NODE_TRX, &cmd_therm_att);
+	rc |= ctrl_cmd_install(CTRL_NODE_TS, &cmd_voice_qual);
+	rc |= ctrl_cmd_install(CTRL_NODE_TS, &cmd_bs_power);
+	rc |= ctrl_cmd_install(CTRL_NODE_TS, &cmd_ms_power);
+	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_load_avg);
+	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_agch_wait);
+	rc |= ctrl_cmd_install(CTRL_NODE_ROOT, &cmd_group_occ);
 
 	return rc;
 }
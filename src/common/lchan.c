@@ -19,9 +19,25 @@
  *
  */
 
+#include <osmocom/core/utils.h>
+
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/measurement.h>
 
 void lchan_set_state(struct gsm_lchan *lchan, enum gsm_lchan_state state)
 {
 	lchan->state = state;
+	lchan_meas_sched_update(lchan);
+}
+
+struct lchan_bts_state *lchan_bts_state(struct gsm_lchan *lchan)
+{
+	struct gsm_bts_trx *trx = lchan->ts->trx;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(trx->bts);
+	unsigned int idx;
+
+	idx = (trx->nr * TRX_NR_TS + lchan->ts->nr) * TS_MAX_LCHAN + lchan->nr;
+	OSMO_ASSERT(idx < btsb->num_lchan_state);
+
+	return &btsb->lchan_state[idx];
 }
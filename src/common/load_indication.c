@@ -32,8 +32,13 @@ static void reset_load_counters(struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
 
-	/* re-set the counters */
-	btsb->load.ccch.pch_used = btsb->load.ccch.pch_total = 0;
+	/* start a new period, the counters themselves keep running for
+	 * the load statistics */
+	btsb->load.ccch.pch_used_start = btsb->load.ccch.pch_used;
+	btsb->load.ccch.pch_total_start = btsb->load.ccch.pch_total;
+	btsb->load.rach.total_start = btsb->load.rach.total;
+	btsb->load.rach.busy_start = btsb->load.rach.busy;
+	btsb->load.rach.access_start = btsb->load.rach.access;
 }
 
 static void load_timer_cb(void *data)
@@ -41,13 +46,21 @@ static void load_timer_cb(void *data)
 	struct gsm_bts *bts = data;
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
 	unsigned int pch_percent, rach_percent;
+	unsigned int pch_total, pch_used;
+	unsigned int rach_total, rach_busy, rach_access;
+
+	/* counts of this period */
+	pch_total = btsb->load.ccch.pch_total - btsb->load.ccch.pch_total_start;
+	pch_used = btsb->load.ccch.pch_used - btsb->load.ccch.pch_used_start;
+	rach_total = btsb->load.rach.total - btsb->load.rach.total_start;
+	rach_busy = btsb->load.rach.busy - btsb->load.rach.busy_start;
+	rach_access = btsb->load.rach.access - btsb->load.rach.access_start;
 
 	/* compute percentages */
-	if (btsb->load.ccch.pch_total == 0)
+	if (pch_total == 0)
 		pch_percent = 0;
 	else
-		pch_percent = (btsb->load.ccch.pch_used * 100) /
-					btsb->load.ccch.pch_total;
+		pch_percent = (pch_used * 100) / pch_total;
 
 	if (pch_percent >= btsb->load.ccch.load_ind_thresh) {
 		/* send RSL load indication message to BSC */
@@ -61,17 +74,15 @@ static void load_timer_cb(void *data)
 		rsl_tx_ccch_load_ind_pch(bts, 0xffff);
 	}
 
-	if (btsb->load.rach.total == 0)
+	if (rach_total == 0)
 		rach_percent = 0;
 	else
-		rach_percent = (btsb->load.rach.busy * 100) /
-					btsb->load.rach.total;
+		rach_percent = (rach_busy * 100) / rach_total;
 
 	if (rach_percent >= btsb->load.ccch.load_ind_thresh) {
 		/* send RSL load indication message to BSC */
-		rsl_tx_ccch_load_ind_rach(bts, btsb->load.rach.total,
-					  btsb->load.rach.busy,
-					  btsb->load.rach.access);
+		rsl_tx_ccch_load_ind_rach(bts, rach_total, rach_busy,
+					  rach_access);
 	}
 
 	reset_load_counters(bts);
@@ -0,0 +1,344 @@
+/* Sub-second CCCH and RACH load statistics */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The load indication to the BSC only tells the share of used PCH
+ * blocks and busy RACH slots over a period of several seconds.  Here
+ * the same counters are sampled every LOAD_STATS_TICK_MS and turned
+ * into exponentially weighted moving averages with time constants of
+ * 1, 10 and 60 seconds.  In addition the waiting time of the AGCH
+ * messages and the occupancy of the individual paging groups are
+ * kept as histograms.  All of it can be read through the CTRL
+ * interface and sent to a statsd daemon.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/socket.h>
+#include <osmocom/core/utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/paging.h>
+#include <osmo-bts/load_stats.h>
+
+const struct value_string load_stats_var_names[] = {
+	{ LOAD_STATS_PCH_BLOCKS,	"pch-blocks" },
+	{ LOAD_STATS_PCH_USED,		"pch-used" },
+	{ LOAD_STATS_RACH_SLOTS,	"rach-slots" },
+	{ LOAD_STATS_RACH_BUSY,		"rach-busy" },
+	{ LOAD_STATS_RACH_ACCESS,	"rach-access" },
+	{ LOAD_STATS_AGCH_SENT,		"agch-sent" },
+	{ LOAD_STATS_AGCH_QUEUE,	"agch-queue" },
+	{ LOAD_STATS_PAGING_QUEUE,	"paging-queue" },
+	{ 0, NULL }
+};
+
+const struct value_string load_stats_tc_names[] = {
+	{ LOAD_STATS_TC_1S,	"1s" },
+	{ LOAD_STATS_TC_10S,	"10s" },
+	{ LOAD_STATS_TC_60S,	"60s" },
+	{ 0, NULL }
+};
+
+static const unsigned int load_stats_tc_ms[_NUM_LOAD_STATS_TC] = {
+	[LOAD_STATS_TC_1S]	= 1000,
+	[LOAD_STATS_TC_10S]	= 10000,
+	[LOAD_STATS_TC_60S]	= 60000,
+};
+
+/* upper bound of each bin of the AGCH waiting time, 0 for none */
+const unsigned int load_stats_wait_bound_ms[LOAD_STATS_WAIT_BINS] = {
+	50, 100, 250, 500, 1000, 2500, 5000, 0
+};
+
+/* fractional bits of the moving averages */
+#define AVG_SHIFT	16
+
+/* averaged as they are, not as a rate */
+static int var_is_level(enum load_stats_var var)
+{
+	return var == LOAD_STATS_AGCH_QUEUE || var == LOAD_STATS_PAGING_QUEUE;
+}
+
+static uint32_t load_stats_sample(struct gsm_bts_role_bts *btsb,
+				  enum load_stats_var var)
+{
+	switch (var) {
+	case LOAD_STATS_PCH_BLOCKS:
+		return btsb->load.ccch.pch_total;
+	case LOAD_STATS_PCH_USED:
+		return btsb->load.ccch.pch_used;
+	case LOAD_STATS_RACH_SLOTS:
+		return btsb->load.rach.total;
+	case LOAD_STATS_RACH_BUSY:
+		return btsb->load.rach.busy;
+	case LOAD_STATS_RACH_ACCESS:
+		return btsb->load.rach.access;
+	case LOAD_STATS_AGCH_SENT:
+		return btsb->agch_queue_agch_msgs + btsb->agch_queue_pch_msgs;
+	case LOAD_STATS_AGCH_QUEUE:
+		return btsb->agch_queue_length;
+	case LOAD_STATS_PAGING_QUEUE:
+		return paging_queue_length(btsb->paging_state);
+	default:
+		return 0;
+	}
+}
+
+/*! \brief account an AGCH message that waited that many frames */
+void load_stats_agch_wait(struct gsm_bts_role_bts *btsb, unsigned int frames)
+{
+	unsigned int ms = frames * 120 / 26;
+	int i;
+
+	for (i = 0; i < LOAD_STATS_WAIT_BINS - 1; i++) {
+		if (ms < load_stats_wait_bound_ms[i])
+			break;
+	}
+	btsb->load_stats.agch_wait[i]++;
+}
+
+unsigned int load_stats_avg(struct gsm_bts *bts, enum load_stats_var var,
+			    enum load_stats_tc tc)
+{
+	int64_t avg = bts_role_bts(bts)->load_stats.avg[var][tc];
+
+	if (avg <= 0)
+		return 0;
+	return (avg + (1 << (AVG_SHIFT - 1))) >> AVG_SHIFT;
+}
+
+static unsigned int per_mille(int64_t part, int64_t total)
+{
+	if (total <= 0 || part <= 0)
+		return 0;
+	if (part >= total)
+		return 1000;
+	return part * 1000 / total;
+}
+
+unsigned int load_stats_pch_load(struct gsm_bts *bts, enum load_stats_tc tc)
+{
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+
+	return per_mille(ls->avg[LOAD_STATS_PCH_USED][tc],
+			 ls->avg[LOAD_STATS_PCH_BLOCKS][tc]);
+}
+
+unsigned int load_stats_rach_load(struct gsm_bts *bts, enum load_stats_tc tc)
+{
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+
+	return per_mille(ls->avg[LOAD_STATS_RACH_BUSY][tc],
+			 ls->avg[LOAD_STATS_RACH_SLOTS][tc]);
+}
+
+/* statsd takes several metrics per datagram, separated by newlines */
+struct statsd_buf {
+	int fd;
+	char data[1024];
+	int len;
+};
+
+static void statsd_flush(struct statsd_buf *sb)
+{
+	if (!sb->len)
+		return;
+	if (send(sb->fd, sb->data, sb->len, MSG_DONTWAIT) < 0)
+		LOGP(DSUM, LOGL_DEBUG, "Failed to send to statsd: %s\n",
+		     strerror(errno));
+	sb->len = 0;
+}
+
+static void statsd_add(struct statsd_buf *sb, const char *line)
+{
+	int len = strlen(line);
+
+	if (sb->len + len > sizeof(sb->data))
+		statsd_flush(sb);
+	memcpy(sb->data + sb->len, line, len);
+	sb->len += len;
+}
+
+static void statsd_send(struct gsm_bts *bts)
+{
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+	struct statsd_buf sb = { .fd = ls->statsd.fd };
+	char line[128];
+	int var, tc, i;
+
+	for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++) {
+		const char *tc_name = get_value_string(load_stats_tc_names, tc);
+		unsigned int val;
+
+		for (var = 0; var < _NUM_LOAD_STATS_VAR; var++) {
+			val = load_stats_avg(bts, var, tc);
+			snprintf(line, sizeof(line), "bts.%u.%s.%s:%u.%03u|g\n",
+				 bts->nr,
+				 get_value_string(load_stats_var_names, var),
+				 tc_name, val / 1000, val % 1000);
+			statsd_add(&sb, line);
+		}
+
+		val = load_stats_pch_load(bts, tc);
+		snprintf(line, sizeof(line), "bts.%u.pch-load.%s:%u.%u|g\n",
+			 bts->nr, tc_name, val / 10, val % 10);
+		statsd_add(&sb, line);
+		val = load_stats_rach_load(bts, tc);
+		snprintf(line, sizeof(line), "bts.%u.rach-load.%s:%u.%u|g\n",
+			 bts->nr, tc_name, val / 10, val % 10);
+		statsd_add(&sb, line);
+	}
+
+	/* the histogram of the waiting time as counters */
+	for (i = 0; i < LOAD_STATS_WAIT_BINS; i++) {
+		uint64_t delta = ls->agch_wait[i] - ls->statsd.agch_wait_sent[i];
+
+		if (load_stats_wait_bound_ms[i])
+			snprintf(line, sizeof(line),
+				 "bts.%u.agch-wait.lt%ums:%llu|c\n", bts->nr,
+				 load_stats_wait_bound_ms[i],
+				 (unsigned long long) delta);
+		else
+			snprintf(line, sizeof(line),
+				 "bts.%u.agch-wait.ge%ums:%llu|c\n", bts->nr,
+				 load_stats_wait_bound_ms[i - 1],
+				 (unsigned long long) delta);
+		statsd_add(&sb, line);
+		ls->statsd.agch_wait_sent[i] = ls->agch_wait[i];
+	}
+
+	for (i = 0; i < LOAD_STATS_GROUP_BINS; i++) {
+		snprintf(line, sizeof(line),
+			 "bts.%u.paging-groups.occ%u:%u|g\n", bts->nr,
+			 i * 100 / LOAD_STATS_GROUP_BINS, ls->group_occ[i]);
+		statsd_add(&sb, line);
+	}
+
+	statsd_flush(&sb);
+}
+
+static void load_stats_tick(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct load_stats *ls = &btsb->load_stats;
+	int var, tc;
+
+	for (var = 0; var < _NUM_LOAD_STATS_VAR; var++) {
+		uint32_t cur = load_stats_sample(btsb, var);
+		int64_t x;
+
+		if (var_is_level(var)) {
+			x = (int64_t) cur * 1000;
+		} else {
+			/* counters wrap, the difference doesn't */
+			x = (int64_t) (uint32_t) (cur - ls->last[var]) *
+				1000 * 1000 / LOAD_STATS_TICK_MS;
+			ls->last[var] = cur;
+			/* no rate before the second sample */
+			if (!ls->primed)
+				continue;
+		}
+
+		x <<= AVG_SHIFT;
+		for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++) {
+			/* levels start at their first sample */
+			if (!ls->primed)
+				ls->avg[var][tc] = x;
+			else
+				ls->avg[var][tc] += (x - ls->avg[var][tc]) *
+					LOAD_STATS_TICK_MS / load_stats_tc_ms[tc];
+		}
+	}
+	ls->primed = 1;
+	ls->ticks++;
+
+	if (ls->ticks % (LOAD_STATS_GROUP_WINDOW_MS / LOAD_STATS_TICK_MS) == 0)
+		paging_group_occupancy(btsb->paging_state, ls->group_occ,
+				       LOAD_STATS_GROUP_BINS);
+
+	if (ls->statsd.fd >= 0 &&
+	    ls->ticks % (ls->statsd.interval * 1000 / LOAD_STATS_TICK_MS) == 0)
+		statsd_send(bts);
+
+	osmo_timer_schedule(&ls->timer, 0, LOAD_STATS_TICK_MS * 1000);
+}
+
+/*! \brief start or stop sending the statistics to a statsd daemon
+ *  \param[in] host address of the daemon, NULL to stop
+ *  \param[in] port UDP port of the daemon
+ */
+int load_stats_statsd_set(struct gsm_bts *bts, const char *host,
+			  uint16_t port)
+{
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+	int fd;
+
+	if (ls->statsd.fd >= 0) {
+		close(ls->statsd.fd);
+		ls->statsd.fd = -1;
+	}
+	talloc_free(ls->statsd.host);
+	ls->statsd.host = NULL;
+
+	if (!host)
+		return 0;
+
+	fd = osmo_sock_init(AF_UNSPEC, SOCK_DGRAM, IPPROTO_UDP, host, port,
+			    OSMO_SOCK_F_CONNECT);
+	if (fd < 0) {
+		LOGP(DSUM, LOGL_ERROR, "Cannot send statistics to statsd "
+		     "at %s:%u\n", host, port);
+		return fd;
+	}
+
+	ls->statsd.fd = fd;
+	ls->statsd.host = talloc_strdup(bts, host);
+	ls->statsd.port = port;
+	/* only what happens from now on is counted */
+	memcpy(ls->statsd.agch_wait_sent, ls->agch_wait,
+	       sizeof(ls->agch_wait));
+
+	return 0;
+}
+
+void load_stats_init(struct gsm_bts *bts)
+{
+	struct load_stats *ls = &bts_role_bts(bts)->load_stats;
+
+	ls->statsd.fd = -1;
+	ls->statsd.port = LOAD_STATS_STATSD_PORT_DEFAULT;
+	ls->statsd.interval = LOAD_STATS_STATSD_INTERVAL_DEFAULT;
+
+	ls->timer.data = bts;
+	ls->timer.cb = load_stats_tick;
+	osmo_timer_schedule(&ls->timer, 0, LOAD_STATS_TICK_MS * 1000);
+}
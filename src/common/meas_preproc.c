@@ -0,0 +1,211 @@
+/* Pre-processing of the measurements of dedicated channels */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Without pre-processing every active lchan sends a MEASUREMENT RESULT
+ * to the BSC each SACCH period.  With it (TS 48.058 8.4.17) the BTS
+ * averages the uplink and downlink level and quality of the serving
+ * cell and only passes a MEASUREMENT RESULT on if
+ *
+ *  - an average moved by rxlev_delta / rxqual_delta since the last
+ *    report, or
+ *  - a level is below trig_rxlev or a quality above trig_rxqual, so
+ *    the BSC sees every report while power control or handover might
+ *    be needed, or
+ *  - nothing was reported for interval periods.
+ *
+ * Reports that are sent are the unmodified ones of the MS, with all of
+ * its neighbour cell measurements.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/meas_preproc.h>
+
+const struct value_string meas_preproc_mode_names[] = {
+	{ MEAS_PREPROC_BSC,	"bsc" },
+	{ MEAS_PREPROC_ALWAYS,	"always" },
+	{ MEAS_PREPROC_NEVER,	"never" },
+	{ 0, NULL }
+};
+
+static struct meas_preproc_lchan *lchan_preproc(struct gsm_lchan *lchan)
+{
+	return &lchan_bts_state(lchan)->meas_preproc;
+}
+
+void meas_preproc_reset(struct gsm_lchan *lchan)
+{
+	memset(lchan_preproc(lchan), 0, sizeof(struct meas_preproc_lchan));
+}
+
+/*! \brief take the Pre-processing Parameters of the BSC
+ *  \param[in] param value part of the IE
+ */
+void meas_preproc_config(struct gsm_lchan *lchan, const uint8_t *param,
+			 unsigned int len)
+{
+	struct meas_preproc_lchan *lp = lchan_preproc(lchan);
+
+	if (len < 1)
+		return;
+
+	/* P bit, the rest is for further study */
+	lp->enabled = param[0] & 0x01;
+	lp->periods = 0;
+	lp->valid = 0;
+
+	LOGP(DMEAS, LOGL_INFO, "%s measurement pre-processing %s\n",
+	     gsm_lchan_name(lchan), lp->enabled ? "on" : "off");
+}
+
+static int lchan_preproc_active(struct gsm_lchan *lchan)
+{
+	struct meas_preproc *mp = &bts_role_bts(lchan->ts->trx->bts)->meas_preproc;
+
+	switch (mp->mode) {
+	case MEAS_PREPROC_ALWAYS:
+		return 1;
+	case MEAS_PREPROC_NEVER:
+		return 0;
+	default:
+		return lchan_preproc(lchan)->enabled;
+	}
+}
+
+/* level and quality of the serving cell, returns the mask of the valid
+ * ones */
+static unsigned int get_meas(struct gsm_lchan *lchan, const uint8_t *l3,
+			     uint8_t *cur)
+{
+	unsigned int valid = 0;
+
+	if (lchan->meas.flags & LC_UL_M_F_RES_VALID) {
+		cur[MEAS_PREPROC_UL_RXLEV] = lchan->meas.ul_res.full.rx_lev;
+		cur[MEAS_PREPROC_UL_RXQUAL] = lchan->meas.ul_res.full.rx_qual;
+		valid |= (1 << MEAS_PREPROC_UL_RXLEV) |
+			 (1 << MEAS_PREPROC_UL_RXQUAL);
+	}
+
+	/* TS 44.018 10.5.2.20, MEAS-VALID is 0 if they are valid */
+	if (!(l3[3] & 0x40)) {
+		cur[MEAS_PREPROC_DL_RXLEV] = l3[2] & 0x3f;
+		cur[MEAS_PREPROC_DL_RXQUAL] = (l3[4] >> 4) & 0x07;
+		valid |= (1 << MEAS_PREPROC_DL_RXLEV) |
+			 (1 << MEAS_PREPROC_DL_RXQUAL);
+	}
+
+	return valid;
+}
+
+static int is_rxlev(int i)
+{
+	return i == MEAS_PREPROC_UL_RXLEV || i == MEAS_PREPROC_DL_RXLEV;
+}
+
+/*! \brief decide whether a MEASUREMENT RESULT is sent to the BSC
+ *  \param[in] l3 MEASUREMENT REPORT of the MS
+ *  \returns 1 to send it, 0 if it is suppressed
+ */
+int meas_preproc_check(struct gsm_lchan *lchan, const uint8_t *l3,
+		       unsigned int l3_len)
+{
+	struct meas_preproc *mp = &bts_role_bts(lchan->ts->trx->bts)->meas_preproc;
+	struct meas_preproc_lchan *lp = lchan_preproc(lchan);
+	uint8_t cur[_NUM_MEAS_PREPROC_VAL];
+	unsigned int valid, val;
+	int report = 0, trigger = 0;
+	int i;
+
+	if (!lchan_preproc_active(lchan))
+		return 1;
+
+	/* ENHANCED MEASUREMENT REPORT and the like are passed on */
+	if (l3_len < 5 || l3[1] != GSM48_MT_RR_MEAS_REP) {
+		mp->stats.sent++;
+		return 1;
+	}
+
+	valid = get_meas(lchan, l3, cur);
+	lp->periods++;
+
+	for (i = 0; i < _NUM_MEAS_PREPROC_VAL; i++) {
+		unsigned int delta = is_rxlev(i) ? mp->rxlev_delta :
+						   mp->rxqual_delta;
+
+		if (!(valid & (1 << i)))
+			continue;
+
+		if (!(lp->valid & (1 << i))) {
+			lp->avg[i] = cur[i] << 4;
+			report = 1;
+		} else {
+			lp->avg[i] += ((cur[i] << 4) - lp->avg[i]) /
+				      (int) mp->avg_periods;
+		}
+		lp->valid |= 1 << i;
+
+		val = (lp->avg[i] + 8) >> 4;
+		if ((val > lp->rep[i] ? val - lp->rep[i] : lp->rep[i] - val)
+		    >= delta)
+			report = 1;
+
+		if (is_rxlev(i) ? val < mp->trig_rxlev : val > mp->trig_rxqual)
+			trigger = 1;
+	}
+
+	if (lp->periods >= mp->interval)
+		report = 1;
+
+	if (!report && !trigger) {
+		mp->stats.suppressed++;
+		return 0;
+	}
+
+	for (i = 0; i < _NUM_MEAS_PREPROC_VAL; i++)
+		lp->rep[i] = (lp->avg[i] + 8) >> 4;
+	lp->periods = 0;
+
+	mp->stats.sent++;
+	if (trigger)
+		mp->stats.triggered++;
+
+	return 1;
+}
+
+void meas_preproc_init(struct gsm_bts *bts)
+{
+	struct meas_preproc *mp = &bts_role_bts(bts)->meas_preproc;
+
+	mp->mode = MEAS_PREPROC_BSC;
+	mp->avg_periods = MEAS_PREPROC_AVG_DEFAULT;
+	mp->rxlev_delta = MEAS_PREPROC_RXLEV_DELTA_DEFAULT;
+	mp->rxqual_delta = MEAS_PREPROC_RXQUAL_DELTA_DEFAULT;
+	mp->interval = MEAS_PREPROC_INTERVAL_DEFAULT;
+	mp->trig_rxlev = MEAS_PREPROC_TRIG_RXLEV_DEFAULT;
+	mp->trig_rxqual = MEAS_PREPROC_TRIG_RXQUAL_DEFAULT;
+}
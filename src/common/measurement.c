@@ -1,12 +1,15 @@
 
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 
+#include <osmocom/core/utils.h>
 #include <osmocom/gsm/gsm_utils.h>
 
 #include <osmo-bts/gsm_data.h>
 #include <osmo-bts/logging.h>
 #include <osmo-bts/measurement.h>
+#include <osmo-bts/ta_ctrl.h>
 
 /* TS 05.08, Chapter 8.4.1 */
 /* measurement period ends at fn % 104 == ? */
@@ -41,78 +44,128 @@ static const uint8_t tchh1_meas_rep_fn104[] = {
 	[7] =	90,
 };
 
-/* determine if a measurement period ends at the given frame number */
-static int is_meas_complete(enum gsm_phys_chan_config pchan, unsigned int ts,
-			    unsigned int subch, uint32_t fn)
+/* frame number modulo *modulus at which the measurement periods of a
+ * lchan end, -1 if it has none */
+static int meas_period_end(enum gsm_phys_chan_config pchan, unsigned int ts,
+			   unsigned int subch, unsigned int *modulus)
 {
-	unsigned int fn_mod;
-	const uint8_t *tbl;
-	int rc = 0;
-
 	if (ts >= 8)
 		return -EINVAL;
-	if (pchan >= _GSM_PCHAN_MAX)
-		return -EINVAL;
 
 	switch (pchan) {
 	case GSM_PCHAN_TCH_F:
-		fn_mod = fn % 104;
-		if (tchf_meas_rep_fn104[ts] == fn_mod)
-			rc = 1;
-		break;
+		*modulus = 104;
+		return tchf_meas_rep_fn104[ts];
 	case GSM_PCHAN_TCH_H:
-		fn_mod = fn % 104;
-		if (subch == 0)	
-			tbl = tchh0_meas_rep_fn104;
+		*modulus = 104;
+		if (subch == 0)
+			return tchh0_meas_rep_fn104[ts];
 		else
-			tbl = tchh1_meas_rep_fn104;
-		if (tbl[ts] == fn_mod)
-			rc = 1;
-		break;
+			return tchh1_meas_rep_fn104[ts];
 	case GSM_PCHAN_SDCCH8_SACCH8C:
 	case GSM_PCHAN_SDCCH8_SACCH8C_CBCH:
-		fn_mod = fn % 102;
-		if (fn_mod == 11)
-			rc = 1;
-		break;
+		*modulus = 102;
+		return 11;
 	case GSM_PCHAN_CCCH_SDCCH4:
 	case GSM_PCHAN_CCCH_SDCCH4_CBCH:
-		fn_mod = fn % 102;
-		if (fn_mod == 36)
-			rc = 1;
-		break;
+		*modulus = 102;
+		return 36;
 	default:
-		rc = 0;
+		return -1;
+	}
+}
+
+static struct trx_meas_sched *trx_meas_sched(struct gsm_bts_trx *trx)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(trx->bts);
+
+	OSMO_ASSERT(btsb->meas_sched && trx->nr < trx->bts->num_trx);
+
+	return &btsb->meas_sched[trx->nr];
+}
+
+/*! \brief keep the measurement schedule of the TRX in line with the
+ *  state of a lchan, it has to be called on every change of the state,
+ *  the channel mode or the pchan of the timeslot */
+void lchan_meas_sched_update(struct gsm_lchan *lchan)
+{
+	struct lchan_bts_state *lbs = lchan_bts_state(lchan);
+	struct trx_meas_sched *ms = trx_meas_sched(lchan->ts->trx);
+	uint64_t bit = 1ULL << (lchan->ts->nr * TS_MAX_LCHAN + lchan->nr);
+	unsigned int modulus;
+	int fn_mod;
+
+	/* remove it from where it was */
+	if (lbs->meas_sched_mod == 104)
+		ms->fn104[lbs->meas_sched_fn] &= ~bit;
+	else if (lbs->meas_sched_mod == 102)
+		ms->fn102[lbs->meas_sched_fn] &= ~bit;
+	lbs->meas_sched_mod = 0;
+
+	/* start afresh with the next activation */
+	if (lchan->state != LCHAN_S_ACTIVE) {
+		memset(&lbs->ul_meas, 0, sizeof(lbs->ul_meas));
+		return;
+	}
+
+	switch (lchan->type) {
+	case GSM_LCHAN_SDCCH:
+	case GSM_LCHAN_TCH_F:
+	case GSM_LCHAN_TCH_H:
+	case GSM_LCHAN_PDTCH:
 		break;
+	default:
+		return;
 	}
-	return rc;
+
+	fn_mod = meas_period_end(lchan->ts->pchan, lchan->ts->nr, lchan->nr,
+				 &modulus);
+	if (fn_mod < 0)
+		return;
+
+	if (modulus == 104)
+		ms->fn104[fn_mod] |= bit;
+	else
+		ms->fn102[fn_mod] |= bit;
+	lbs->meas_sched_mod = modulus;
+	lbs->meas_sched_fn = fn_mod;
 }
 
 /* receive a L1 uplink measurement from L1 */
 int lchan_new_ul_meas(struct gsm_lchan *lchan, struct bts_ul_meas *ulm)
 {
-	DEBUGP(DMEAS, "%s adding measurement, num_ul_meas=%d\n",
-		gsm_lchan_name(lchan), lchan->meas.num_ul_meas);
+	struct ul_meas_acc *acc = &lchan_bts_state(lchan)->ul_meas;
+
+	DEBUGP(DMEAS, "%s adding measurement, num_ul_meas=%u\n",
+		gsm_lchan_name(lchan), acc->num);
 
 	if (lchan->state != LCHAN_S_ACTIVE) {
 		LOGP(DMEAS, LOGL_NOTICE, "%s measurement during state: %s\n",
 			gsm_lchan_name(lchan), gsm_lchans_name(lchan->state));
 	}
 
-	if (lchan->meas.num_ul_meas >= ARRAY_SIZE(lchan->meas.uplink)) {
-		LOGP(DMEAS, LOGL_NOTICE, "%s no space for uplink measurement\n",
-			gsm_lchan_name(lchan));
-		return -ENOSPC;
+	if (acc->num == 0 || ulm->inv_rssi < acc->irssi_min)
+		acc->irssi_min = ulm->inv_rssi;
+	if (acc->num == 0 || ulm->inv_rssi > acc->irssi_max)
+		acc->irssi_max = ulm->inv_rssi;
+
+	acc->num++;
+	acc->ber10k_sum += ulm->ber10k;
+	acc->irssi_sum += ulm->inv_rssi;
+	acc->irssi_sq_sum += ulm->inv_rssi * ulm->inv_rssi;
+	acc->taqb_sum += ulm->ta_offs_qbits;
+
+	if (ulm->is_sub) {
+		acc->num_sub++;
+		acc->ber10k_sub_sum += ulm->ber10k;
+		acc->irssi_sub_sum += ulm->inv_rssi;
 	}
 
-	memcpy(&lchan->meas.uplink[lchan->meas.num_ul_meas++], ulm,
-		sizeof(*ulm));
-
 	return 0;
 }
 
 /* input: BER in steps of .01%, i.e. percent/100 */
-static uint8_t ber10k_to_rxqual(uint32_t ber10k)
+uint8_t ber10k_to_rxqual(uint32_t ber10k)
 {
 	/* 05.08 / 8.2.4 */
 	if (ber10k < 20)
@@ -134,56 +187,38 @@ static uint8_t ber10k_to_rxqual(uint32_t ber10k)
 
 static int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 {
+	struct ul_meas_acc *acc = &lchan_bts_state(lchan)->ul_meas;
 	struct gsm_meas_rep_unidir *mru;
-	uint32_t ber_full_sum = 0;
-	uint32_t irssi_full_sum = 0;
+	uint32_t ber_full_sum, irssi_full_sum;
 	uint32_t ber_sub_sum = 0;
 	uint32_t irssi_sub_sum = 0;
-	int32_t taqb_sum = 0;
-	unsigned int num_meas_sub = 0;
-	int i;
-
-	/* if measurement period is not complete, abort */
-	if (!is_meas_complete(lchan->ts->pchan, lchan->ts->nr,
-			      lchan->nr, fn))
-		return 0;
+	uint32_t irssi_var;
+	int32_t taqb_sum;
 
 	/* if there are no measurements, skip computation */
-	if (lchan->meas.num_ul_meas == 0)
+	if (acc->num == 0)
 		return 0;
 
 	/* compute the actual measurements */
-
-	/* step 1: add up */
-	for (i = 0; i < lchan->meas.num_ul_meas; i++) {
-		struct bts_ul_meas *m = &lchan->meas.uplink[i];
-
-		ber_full_sum += m->ber10k;
-		irssi_full_sum += m->inv_rssi;
-		taqb_sum += m->ta_offs_qbits;
-
-		if (m->is_sub) {
-			num_meas_sub++;
-			ber_sub_sum += m->ber10k;
-			irssi_sub_sum += m->inv_rssi;
-		}
-	}
-
-	/* step 2: divide */
-	ber_full_sum = ber_full_sum / lchan->meas.num_ul_meas;
-	irssi_full_sum = irssi_full_sum / lchan->meas.num_ul_meas;
-	taqb_sum = taqb_sum / lchan->meas.num_ul_meas;
-
-	if (num_meas_sub) {
-		ber_sub_sum = ber_sub_sum / num_meas_sub;
-		irssi_sub_sum = irssi_sub_sum / num_meas_sub;
+	ber_full_sum = acc->ber10k_sum / acc->num;
+	irssi_full_sum = acc->irssi_sum / acc->num;
+	taqb_sum = acc->taqb_sum / (int32_t) acc->num;
+	irssi_var = (acc->irssi_sq_sum -
+		     (uint64_t) acc->irssi_sum * acc->irssi_sum / acc->num) /
+		    acc->num;
+
+	if (acc->num_sub) {
+		ber_sub_sum = acc->ber10k_sub_sum / acc->num_sub;
+		irssi_sub_sum = acc->irssi_sub_sum / acc->num_sub;
 	}
 
 	DEBUGP(DMEAS, "%s Computed TA(% 4dqb) BER-FULL(%2u.%02u%%), RSSI-FULL(-%3udBm), "
-		"BER-SUB(%2u.%02u%%), RSSI-SUB(-%3udBm)\n", gsm_lchan_name(lchan),
+		"BER-SUB(%2u.%02u%%), RSSI-SUB(-%3udBm), RSSI-RANGE(-%u..-%udBm), "
+		"RSSI-VAR(%udB^2) from %u/%u samples\n", gsm_lchan_name(lchan),
 		taqb_sum, ber_full_sum/100,
 		ber_full_sum%100, irssi_full_sum, ber_sub_sum/100, ber_sub_sum%100,
-		irssi_sub_sum);
+		irssi_sub_sum, acc->irssi_min, acc->irssi_max, irssi_var,
+		acc->num, acc->num_sub);
 
 	/* store results */
 	mru = &lchan->meas.ul_res;
@@ -193,7 +228,9 @@ static int lchan_meas_check_compute(struct gsm_lchan *lchan, uint32_t fn)
 	mru->sub.rx_qual = ber10k_to_rxqual(ber_sub_sum);
 
 	lchan->meas.flags |= LC_UL_M_F_RES_VALID;
-	lchan->meas.num_ul_meas = 0;
+	memset(acc, 0, sizeof(*acc));
+
+	ta_ctrl_meas(lchan, taqb_sum);
 
 	/* send a signal indicating computation is complete */
 
@@ -211,53 +248,20 @@ int lchan_build_rsl_ul_meas(struct gsm_lchan *lchan, uint8_t *buf)
 	return 3;
 }
 
-/* Copied from OpenBSC and enlarged to _GSM_PCHAN_MAX */
-static const uint8_t subslots_per_pchan[_GSM_PCHAN_MAX] = {
-	[GSM_PCHAN_NONE] = 0,
-	[GSM_PCHAN_CCCH] = 0,
-	[GSM_PCHAN_CCCH_SDCCH4] = 4,
-	[GSM_PCHAN_CCCH_SDCCH4_CBCH] = 4,
-	[GSM_PCHAN_TCH_F] = 1,
-	[GSM_PCHAN_TCH_H] = 2,
-	[GSM_PCHAN_SDCCH8_SACCH8C] = 8,
-	[GSM_PCHAN_SDCCH8_SACCH8C_CBCH] = 8,
-	/* FIXME: what about dynamic TCH_F_TCH_H ? */
-	[GSM_PCHAN_TCH_F_PDCH] = 1,
-};
-
-static int ts_meas_check_compute(struct gsm_bts_trx_ts *ts, uint32_t fn)
-{
-	int i;
-	const int num_subslots = subslots_per_pchan[ts->pchan];
-
-	for (i = 0; i < num_subslots; ++i) {
-		struct gsm_lchan *lchan = &ts->lchan[i];
-
-		if (lchan->state != LCHAN_S_ACTIVE)
-			continue;
-
-		switch (lchan->type) {
-		case GSM_LCHAN_SDCCH:
-		case GSM_LCHAN_TCH_F:
-		case GSM_LCHAN_TCH_H:
-		case GSM_LCHAN_PDTCH:
-			lchan_meas_check_compute(lchan, fn);
-			break;
-		default:
-			break;
-		}
-	}
-	return 0;
-}
-
 /* needs to be called once every TDMA frame ! */
 int trx_meas_check_compute(struct gsm_bts_trx *trx, uint32_t fn)
 {
-	int i;
+	struct trx_meas_sched *ms = trx_meas_sched(trx);
+	uint64_t due;
+
+	/* only the lchans whose measurement period ends now */
+	due = ms->fn104[fn % 104] | ms->fn102[fn % 102];
+	while (due) {
+		int bit = __builtin_ctzll(due);
+		struct gsm_bts_trx_ts *ts = &trx->ts[bit / TS_MAX_LCHAN];
 
-	for (i = 0; i < ARRAY_SIZE(trx->ts); i++) {
-		struct gsm_bts_trx_ts *ts = &trx->ts[i];
-		ts_meas_check_compute(ts, fn);
+		due &= due - 1;
+		lchan_meas_check_compute(&ts->lchan[bit % TS_MAX_LCHAN], fn);
 	}
 	return 0;
 }
@@ -0,0 +1,164 @@
+/* Uplink power control of dedicated channels */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The RSSI and BER of avg_blocks SACCH blocks received while the MS
+ * sends at the power we asked for are averaged.  Then the power is
+ * raised if the uplink RXQUAL reaches rxqual_raise or the level is more
+ * than raise_thresh below the target, and lowered if the level is more
+ * than lower_thresh above it.  A step never exceeds raise_max_db or
+ * lower_max_db, and the power never the one set by the BSC.  Blocks
+ * the MS sent at another power are not looked at, and after every
+ * change a new window is started.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts_model.h>
+#include <osmo-bts/measurement.h>
+#include <osmo-bts/ms_power_ctrl.h>
+
+static struct ms_power_lchan *lchan_ms_power(struct gsm_lchan *lchan)
+{
+	return &lchan_bts_state(lchan)->ms_power;
+}
+
+void ms_power_ctrl_reset(struct gsm_lchan *lchan, int max_valid)
+{
+	struct ms_power_lchan *mp = lchan_ms_power(lchan);
+
+	memset(mp, 0, sizeof(*mp));
+	if (max_valid) {
+		mp->max_valid = 1;
+		mp->max_dbm = ms_pwr_dbm(lchan->ts->trx->bts->band,
+					 lchan->ms_power);
+	}
+}
+
+static void window_reset(struct ms_power_lchan *mp)
+{
+	mp->rssi_sum = 0;
+	mp->ber10k_sum = 0;
+	mp->num = 0;
+}
+
+int ms_power_ctrl_meas(struct gsm_lchan *lchan, int target_dbm,
+		       uint8_t ms_power, int rssi_dbm, unsigned int ber10k)
+{
+	struct ms_power_ctrl *mpc =
+			&bts_role_bts(lchan->ts->trx->bts)->ms_power_ctrl;
+	struct ms_power_lchan *mp = lchan_ms_power(lchan);
+	const enum gsm_band band = lchan->ts->trx->bts->band;
+	int avg_dbm, delta, cur_dBm, new_dBm, new_pwr;
+	uint8_t rxqual;
+
+	if (lchan->ms_power_ctrl.fixed)
+		return 0;
+
+	/* The phone hasn't reached the power level yet */
+	if (lchan->ms_power_ctrl.current != ms_power) {
+		window_reset(mp);
+		return 0;
+	}
+
+	mp->blocks++;
+	mp->rssi_sum += rssi_dbm;
+	mp->ber10k_sum += ber10k;
+	mp->num++;
+	if (mp->num < mpc->avg_blocks)
+		return 0;
+
+	/* rounded to the nearest dB, the sum is negative */
+	avg_dbm = -((-mp->rssi_sum + mp->num / 2) / mp->num);
+	rxqual = ber10k_to_rxqual(mp->ber10k_sum / mp->num);
+	window_reset(mp);
+
+	if (rxqual >= mpc->rxqual_raise)
+		delta = mpc->raise_max_db;
+	else if (avg_dbm < target_dbm - (int) mpc->raise_thresh)
+		delta = OSMO_MIN(target_dbm - avg_dbm, (int) mpc->raise_max_db);
+	else if (avg_dbm > target_dbm + (int) mpc->lower_thresh)
+		delta = -OSMO_MIN(avg_dbm - target_dbm, (int) mpc->lower_max_db);
+	else
+		return 0;
+
+	cur_dBm = ms_pwr_dbm(band, ms_power);
+	new_dBm = cur_dBm + delta;
+
+	/* Clamp negative values and do it depending on the band */
+	if (new_dBm < 0)
+		new_dBm = 0;
+
+	switch (band) {
+	case GSM_BAND_1800:
+		/* If MS_TX_PWR_MAX_CCH is set the values 29,
+		 * 30, 31 are not used. Avoid specifying a dBm
+		 * that would lead to these power levels. The
+		 * phone might not be able to reach them. */
+		if (new_dBm > 30)
+			new_dBm = 30;
+		break;
+	default:
+		break;
+	}
+
+	/* never more than the BSC allows */
+	if (mp->max_valid && new_dBm > mp->max_dbm)
+		new_dBm = mp->max_dbm;
+
+	new_pwr = ms_pwr_ctl_lvl(band, new_dBm);
+	if (lchan->ms_power_ctrl.current == new_pwr)
+		return 0;
+
+	DEBUGP(DMEAS, "%s uplink %d dBm RXQUAL %u, MS power %d -> %d dBm\n",
+		gsm_lchan_name(lchan), avg_dbm, rxqual, cur_dBm, new_dBm);
+
+	if (new_dBm > cur_dBm) {
+		mp->raised++;
+		mpc->raised++;
+	} else {
+		mp->lowered++;
+		mpc->lowered++;
+	}
+
+	lchan->ms_power_ctrl.current = new_pwr;
+	bts_model_adjst_ms_pwr(lchan);
+
+	return 1;
+}
+
+void ms_power_ctrl_init(struct gsm_bts *bts)
+{
+	struct ms_power_ctrl *mpc = &bts_role_bts(bts)->ms_power_ctrl;
+
+	mpc->avg_blocks = MS_PWR_CTRL_AVG_DEFAULT;
+	mpc->raise_thresh = MS_PWR_CTRL_RAISE_THRESH_DEFAULT;
+	mpc->lower_thresh = MS_PWR_CTRL_LOWER_THRESH_DEFAULT;
+	mpc->raise_max_db = MS_PWR_CTRL_RAISE_MAX_DEFAULT;
+	mpc->lower_max_db = MS_PWR_CTRL_LOWER_MAX_DEFAULT;
+	mpc->rxqual_raise = MS_PWR_CTRL_RXQUAL_DEFAULT;
+}
@@ -41,6 +41,7 @@
 #include <osmo-bts/bts_model.h>
 #include <osmo-bts/bts.h>
 #include <osmo-bts/signal.h>
+#include <osmo-bts/measurement.h>
 
 /* FIXME: move this to libosmocore */
 static struct tlv_definition abis_nm_att_tlvdef_ipa = {
@@ -425,6 +426,14 @@ static int oml_rx_set_bts_attr(struct gsm_bts *bts, struct msgb *msg)
 	if (TLVP_PRESENT(&tp, NM_ATT_START_TIME)) {
 		return oml_fom_ack_nack(msg, NM_NACK_SPEC_IMPL_NOTSUPP);
 	}
+	/* 9.4.25 Interference Level Boundaries, X0..X5 */
+	if (TLVP_PRESENT(&tp, NM_ATT_INTERF_BOUND)
+	 && TLVP_LEN(&tp, NM_ATT_INTERF_BOUND) < 6) {
+		LOGP(DOML, LOGL_NOTICE, "Given Interference Level Boundaries "
+			"too short: %u bytes\n",
+			TLVP_LEN(&tp, NM_ATT_INTERF_BOUND));
+		return oml_fom_ack_nack(msg, NM_NACK_INCORR_STRUCT);
+	}
 
 	/* merge existing BTS attributes with new attributes */
 	tp_merged = tlvp_copy(bts->mo.nm_attr, bts);
@@ -444,10 +453,11 @@ static int oml_rx_set_bts_attr(struct gsm_bts *bts, struct msgb *msg)
 	/* ... and actually still parse them */
 
 	/* 9.4.25 Interference Level Boundaries */
-	if (TLVP_PRESENT(&tp, NM_ATT_INTERF_BOUND)) {
+	if (TLVP_PRESENT(&tp, NM_ATT_INTERF_BOUND)
+	 && TLVP_LEN(&tp, NM_ATT_INTERF_BOUND) >= 6) {
 		payload = TLVP_VAL(&tp, NM_ATT_INTERF_BOUND);
 		for (i = 0; i < 6; i++) {
-			int16_t boundary = *payload;
+			int16_t boundary = payload[i];
 			btsb->interference.boundary[i] = -1 * boundary;
 		}
 	}
@@ -649,6 +659,11 @@ static int conf_lchans_for_pchan(struct gsm_bts_trx_ts *ts)
 		/* FIXME */
 		break;
 	}
+
+	/* the measurement periods depend on the pchan */
+	for (i = 0; i < ARRAY_SIZE(ts->lchan); i++)
+		lchan_meas_sched_update(&ts->lchan[i]);
+
 	return 0;
 }
 
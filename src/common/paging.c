@@ -20,7 +20,6 @@
  */
 
 /* TODO:
-	* eMLPP priprity
 	* add P1/P2/P3 rest octets
  */
 
@@ -28,7 +27,6 @@
 #include <stdint.h>
 #include <errno.h>
 #include <string.h>
-#include <time.h>
 
 #include <osmocom/core/talloc.h>
 #include <osmocom/core/linuxlist.h>
@@ -45,6 +43,16 @@
 
 #define MAX_PAGING_BLOCKS_CCCH	9
 #define MAX_BS_PA_MFRMS		9
+#define MAX_PAGING_GROUPS_CCCH	(MAX_PAGING_BLOCKS_CCCH*MAX_BS_PA_MFRMS)
+
+/* number of buckets of the identity index, a power of two */
+#define PAGING_HASH_SIZE	512
+/* number of paging records allocated at once */
+#define PAGING_POOL_CHUNK	64
+/* number of records of a group queue considered for one PCH block */
+#define PAGING_PACK_WINDOW	8
+/* number of paging cycles covered by the expiry wheel of a group */
+#define PAGING_WHEEL_SLOTS	16
 
 enum paging_record_type {
 	PAGING_RECORD_PAGING,
@@ -52,11 +60,30 @@ enum paging_record_type {
 };
 
 struct paging_record {
+	/* group queue, or the pool free list */
 	struct llist_head list;
 	enum paging_record_type type;
+	/* when it was queued, see paging_state.elapsed_fn */
+	uint64_t queued_fn;
 	union {
 		struct {
-			time_t expiration_time;
+			/* identity index bucket */
+			struct llist_head hash_list;
+			/* expiry wheel slot of the group */
+			struct llist_head wheel_list;
+			/* all records of the priority class, oldest first */
+			struct llist_head class_list;
+			/* records of the group not sent yet, oldest first */
+			struct llist_head unsent_list;
+			/* see paging_group_idx() */
+			uint16_t group;
+			uint8_t prio;	/* enum paging_prio */
+			uint8_t sent;
+			/* in 51-multiframes, see paging_now() */
+			uint64_t expiration_mfrm;
+			/* first paging cycle in which the group is served
+			 * after the lifetime has elapsed */
+			uint64_t expiration_cycle;
 			uint8_t chan_needed;
 			uint8_t identity_lv[9];
 		} paging;
@@ -66,6 +93,51 @@ struct paging_record {
 	} u;
 };
 
+struct paging_group {
+	/* one queue per priority class */
+	struct llist_head queue[_NUM_PAGING_PRIO];
+	struct llist_head imm_ass_queue;
+	/* see paging_record.unsent_list */
+	struct llist_head unsent;
+	/* weighted round robin between the classes */
+	int wrr_weight[_NUM_PAGING_PRIO];
+
+	/* paging records, by the paging cycle in which they expire */
+	struct llist_head wheel[PAGING_WHEEL_SLOTS];
+	/* next paging cycle of the wheel to be looked at */
+	uint64_t wheel_next;
+
+	/* PCH blocks of the group, and those that carried a message,
+	 * since the last paging_group_occupancy() */
+	unsigned int blocks;
+	unsigned int used_blocks;
+};
+
+/* share of the PCH blocks of each priority class, if all have records */
+static const int paging_prio_weight[_NUM_PAGING_PRIO] = {
+	[PAGING_PRIO_AB]	= 8,
+	[PAGING_PRIO_0_1]	= 4,
+	[PAGING_PRIO_2_4]	= 2,
+	[PAGING_PRIO_NONE]	= 1,
+};
+
+/* eMLPP priority as in TS 44.018 10.5.2.24: 0 means none, 1..5 are
+ * the levels 4..0, 6 is B and 7 is A */
+static const uint8_t emlpp_paging_prio[8] = {
+	PAGING_PRIO_NONE,
+	PAGING_PRIO_2_4, PAGING_PRIO_2_4, PAGING_PRIO_2_4,
+	PAGING_PRIO_0_1, PAGING_PRIO_0_1,
+	PAGING_PRIO_AB, PAGING_PRIO_AB,
+};
+
+const struct value_string paging_prio_names[] = {
+	{ PAGING_PRIO_AB,	"A/B" },
+	{ PAGING_PRIO_0_1,	"0/1" },
+	{ PAGING_PRIO_2_4,	"2-4" },
+	{ PAGING_PRIO_NONE,	"none" },
+	{ 0, NULL }
+};
+
 struct paging_state {
 	struct gsm_bts_role_bts *btsb;
 
@@ -76,9 +148,27 @@ struct paging_state {
 	unsigned int paging_lifetime; /* in seconds */
 	unsigned int num_paging_max;
 
+	/* the clock of the paging code: frames elapsed since the first
+	 * paging block, derived from the FN of the paging blocks.  64 bit
+	 * so that it never wraps, the expiry wheels rely on that. */
+	uint64_t elapsed_fn;
+	uint32_t last_fn;
+	int last_fn_valid;
+	/* paging_lifetime in 51-multiframes */
+	uint32_t lifetime_mfrm;
+
 	/* total number of currently active paging records in queue */
 	unsigned int num_paging;
-	struct llist_head paging_queue[MAX_PAGING_BLOCKS_CCCH*MAX_BS_PA_MFRMS];
+	struct paging_group group[BTS_MAX_CCCH*MAX_PAGING_GROUPS_CCCH];
+	/* paging records of each priority class, for preemption */
+	struct llist_head class_records[_NUM_PAGING_PRIO];
+
+	/* paging records of all groups, by identity */
+	struct llist_head paging_hash[PAGING_HASH_SIZE];
+	/* unused records, see pr_alloc() */
+	struct llist_head free_records;
+
+	struct paging_stats stats;
 };
 
 unsigned int paging_get_lifetime(struct paging_state *ps)
@@ -91,9 +181,16 @@ unsigned int paging_get_queue_max(struct paging_state *ps)
 	return ps->num_paging_max;
 }
 
+/* a 51-multiframe lasts 51 * 120/26 ms */
+static uint32_t lifetime_to_mfrm(unsigned int lifetime)
+{
+	return (lifetime * 26000 + 6119) / 6120;
+}
+
 void paging_set_lifetime(struct paging_state *ps, unsigned int lifetime)
 {
 	ps->paging_lifetime = lifetime;
+	ps->lifetime_mfrm = lifetime_to_mfrm(lifetime);
 }
 
 void paging_set_queue_max(struct paging_state *ps, unsigned int queue_max)
@@ -164,6 +261,208 @@ static int get_pag_subch_nr(struct paging_state *ps, struct gsm_time *gt)
 	return pag_idx + mfrm_part;
 }
 
+/* index into paging_state.group[] of a paging group on a CCCH */
+static int paging_group_idx(uint8_t ccch, unsigned int paging_group)
+{
+	if (ccch >= BTS_MAX_CCCH || paging_group >= MAX_PAGING_GROUPS_CCCH)
+		return -EINVAL;
+
+	return ccch * MAX_PAGING_GROUPS_CCCH + paging_group;
+}
+
+/* records are never returned to talloc but kept for re-use, which
+ * avoids an allocation for every PAGING CMD during paging storms */
+static struct paging_record *pr_alloc(struct paging_state *ps)
+{
+	struct paging_record *pr;
+	int i;
+
+	if (llist_empty(&ps->free_records)) {
+		pr = talloc_zero_array(ps, struct paging_record,
+				       PAGING_POOL_CHUNK);
+		if (!pr)
+			return NULL;
+		for (i = 0; i < PAGING_POOL_CHUNK; i++)
+			llist_add_tail(&pr[i].list, &ps->free_records);
+		ps->stats.pool_size += PAGING_POOL_CHUNK;
+	}
+
+	pr = llist_entry(ps->free_records.next, struct paging_record, list);
+	llist_del(&pr->list);
+	memset(pr, 0, sizeof(*pr));
+
+	return pr;
+}
+
+/* give back a record that is no longer in any group queue */
+static void pr_free(struct paging_state *ps, struct paging_record *pr)
+{
+	if (pr->type == PAGING_RECORD_PAGING) {
+		llist_del(&pr->u.paging.hash_list);
+		llist_del(&pr->u.paging.wheel_list);
+		llist_del(&pr->u.paging.class_list);
+		if (!pr->u.paging.sent)
+			llist_del(&pr->u.paging.unsent_list);
+	}
+	llist_add(&pr->list, &ps->free_records);
+}
+
+static void paging_update_time(struct paging_state *ps, uint32_t fn)
+{
+	if (ps->last_fn_valid)
+		ps->elapsed_fn += (fn + GSM_MAX_FN - ps->last_fn) % GSM_MAX_FN;
+	ps->last_fn = fn;
+	ps->last_fn_valid = 1;
+}
+
+/* current time in 51-multiframes */
+static uint64_t paging_now(struct paging_state *ps)
+{
+	return ps->elapsed_fn / 51;
+}
+
+/* each paging group is served once per paging cycle */
+static uint64_t paging_cycle(struct paging_state *ps, uint64_t mfrm)
+{
+	return mfrm / (ps->chan_desc.bs_pa_mfrms + 2);
+}
+
+/* first paging cycle in which a group is served at or after mfrm */
+static uint64_t group_cycle(struct paging_state *ps, unsigned int group,
+			    uint64_t mfrm)
+{
+	unsigned int n_pag_blks_51 = gsm0502_get_n_pag_blocks(&ps->chan_desc);
+	unsigned int mfrms = ps->chan_desc.bs_pa_mfrms + 2;
+	unsigned int offset = (group % MAX_PAGING_GROUPS_CCCH) / n_pag_blks_51;
+
+	if (mfrm <= offset)
+		return 0;
+
+	return (mfrm - offset + mfrms - 1) / mfrms;
+}
+
+static struct llist_head *wheel_slot(struct paging_state *ps, unsigned int group,
+				     uint64_t cycle)
+{
+	return &ps->group[group].wheel[cycle % PAGING_WHEEL_SLOTS];
+}
+
+static void pr_add_to_wheel(struct paging_state *ps,
+			    struct paging_record *pr)
+{
+	unsigned int group = pr->u.paging.group;
+	uint64_t cycle;
+
+	cycle = group_cycle(ps, group, pr->u.paging.expiration_mfrm);
+	pr->u.paging.expiration_cycle = cycle;
+	llist_add_tail(&pr->u.paging.wheel_list, wheel_slot(ps, group, cycle));
+}
+
+/* (re)start the lifetime of a paging record */
+static void pr_set_expiration(struct paging_state *ps,
+			      struct paging_record *pr)
+{
+	pr->u.paging.expiration_mfrm = paging_now(ps) + ps->lifetime_mfrm;
+	pr_add_to_wheel(ps, pr);
+}
+
+/* the paging cycles changed, sort all records into the wheels again */
+static void paging_rebuild_wheels(struct paging_state *ps)
+{
+	uint64_t cycle = paging_cycle(ps, paging_now(ps));
+	struct paging_record *pr, *pr2;
+	LLIST_HEAD(tmp);
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(ps->group); i++) {
+		for (j = 0; j < PAGING_WHEEL_SLOTS; j++)
+			llist_splice_init(&ps->group[i].wheel[j], &tmp);
+		ps->group[i].wheel_next = cycle;
+	}
+
+	llist_for_each_entry_safe(pr, pr2, &tmp, u.paging.wheel_list) {
+		llist_del(&pr->u.paging.wheel_list);
+		pr_add_to_wheel(ps, pr);
+	}
+}
+
+static void paging_expire_slot(struct paging_state *ps, unsigned int group,
+			       uint64_t slot_cycle, uint64_t cycle)
+{
+	struct llist_head *slot = wheel_slot(ps, group, slot_cycle);
+	struct llist_head *next = wheel_slot(ps, group, slot_cycle + 1);
+	struct paging_record *pr, *pr2;
+
+	llist_for_each_entry_safe(pr, pr2, slot, u.paging.wheel_list) {
+		/* in a later round of the wheel */
+		if (pr->u.paging.expiration_cycle > cycle)
+			continue;
+		/* page everybody at least once */
+		if (!pr->u.paging.sent) {
+			llist_move_tail(&pr->u.paging.wheel_list, next);
+			continue;
+		}
+		ps->stats.expired++;
+		ps->stats.prio[pr->u.paging.prio].expired++;
+		llist_del(&pr->list);
+		pr_free(ps, pr);
+		ps->num_paging--;
+		LOGP(DPAG, LOGL_INFO, "Removed paging record, queue_len=%u\n",
+			ps->num_paging);
+	}
+}
+
+/* Remove the expired records of a group, called when the group has
+ * been served.  Normally only the wheel slot of the current paging
+ * cycle is looked at, the slots of cycles in which the group was not
+ * served (e.g. after a jump of the FN) are caught up with. */
+static void paging_expire(struct paging_state *ps, unsigned int group)
+{
+	uint64_t cycle = paging_cycle(ps, paging_now(ps));
+	uint64_t c = ps->group[group].wheel_next;
+
+	/* already done in this cycle */
+	if (c > cycle)
+		return;
+	if (cycle - c >= PAGING_WHEEL_SLOTS)
+		c = cycle - PAGING_WHEEL_SLOTS + 1;
+	for (; c <= cycle; c++)
+		paging_expire_slot(ps, group, c, cycle);
+
+	ps->group[group].wheel_next = cycle + 1;
+}
+
+static unsigned int identity_hash(const uint8_t *identity_lv)
+{
+	unsigned int i, h = 0;
+
+	for (i = 1; i <= identity_lv[0]; i++)
+		h = h * 31 + identity_lv[i];
+
+	return h & (PAGING_HASH_SIZE - 1);
+}
+
+static struct paging_record *find_identity(struct paging_state *ps,
+					   unsigned int paging_group,
+					   const uint8_t *identity_lv)
+{
+	struct llist_head *bucket = &ps->paging_hash[identity_hash(identity_lv)];
+	struct paging_record *pr;
+
+	ps->stats.lookups++;
+
+	llist_for_each_entry(pr, bucket, u.paging.hash_list) {
+		ps->stats.lookup_cmps++;
+		if (pr->u.paging.group == paging_group &&
+		    identity_lv[0] == pr->u.paging.identity_lv[0] &&
+		    !memcmp(identity_lv+1, pr->u.paging.identity_lv+1,
+							identity_lv[0]))
+			return pr;
+	}
+
+	return NULL;
+}
+
 int paging_buffer_space(struct paging_state *ps)
 {
 	if (ps->num_paging >= ps->num_paging_max)
@@ -172,65 +471,121 @@ int paging_buffer_space(struct paging_state *ps)
 		return ps->num_paging_max - ps->num_paging;
 }
 
+/* Make room for a record of the given class by removing the oldest
+ * record of the lowest class below it */
+static int paging_preempt(struct paging_state *ps, int prio)
+{
+	struct paging_record *pr;
+	int i;
+
+	for (i = _NUM_PAGING_PRIO - 1; i > prio; i--) {
+		if (llist_empty(&ps->class_records[i]))
+			continue;
+		pr = llist_entry(ps->class_records[i].next,
+				 struct paging_record, u.paging.class_list);
+		LOGP(DPAG, LOGL_INFO, "Preempting paging of priority %s "
+			"(ccch=%u, group=%u)\n",
+			get_value_string(paging_prio_names, i),
+			pr->u.paging.group / MAX_PAGING_GROUPS_CCCH,
+			pr->u.paging.group % MAX_PAGING_GROUPS_CCCH);
+		llist_del(&pr->list);
+		pr_free(ps, pr);
+		ps->num_paging--;
+		ps->stats.prio[i].preempted++;
+		return 0;
+	}
+
+	return -ENOSPC;
+}
+
 /* Add an identity to the paging queue */
-int paging_add_identity(struct paging_state *ps, uint8_t paging_group,
-			const uint8_t *identity_lv, uint8_t chan_needed)
+int paging_add_identity(struct paging_state *ps, uint8_t ccch,
+			uint8_t paging_group, const uint8_t *identity_lv,
+			uint8_t chan_needed, uint8_t emlpp_prio)
 {
-	struct llist_head *group_q = &ps->paging_queue[paging_group];
+	int prio = emlpp_paging_prio[emlpp_prio & 7];
+	int idx = paging_group_idx(ccch, paging_group);
+	struct paging_group *grp;
 	struct paging_record *pr;
 
-	if (ps->num_paging >= ps->num_paging_max) {
-		LOGP(DPAG, LOGL_NOTICE, "Dropping paging, queue full (%u)\n",
-			ps->num_paging);
-		return -ENOSPC;
+	if (idx < 0) {
+		LOGP(DPAG, LOGL_ERROR, "Invalid paging group %u on CCCH %u\n",
+			paging_group, ccch);
+		return -EINVAL;
 	}
+	grp = &ps->group[idx];
+
+	if (*identity_lv + 1 > sizeof(pr->u.paging.identity_lv))
+		return -E2BIG;
 
 	/* Check if we already have this identity */
-	llist_for_each_entry(pr, group_q, list) {
-		if (pr->type != PAGING_RECORD_PAGING)
-			continue;
-		if (identity_lv[0] == pr->u.paging.identity_lv[0] &&
-		    !memcmp(identity_lv+1, pr->u.paging.identity_lv+1,
-							identity_lv[0])) {
-			LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
-			pr->u.paging.expiration_time =
-					time(NULL) + ps->paging_lifetime;
-			return -EEXIST;
+	pr = find_identity(ps, idx, identity_lv);
+	if (pr) {
+		LOGP(DPAG, LOGL_INFO, "Ignoring duplicate paging\n");
+		llist_del(&pr->u.paging.wheel_list);
+		pr_set_expiration(ps, pr);
+		/* it may be repeated with a higher priority */
+		if (prio < pr->u.paging.prio) {
+			pr->u.paging.prio = prio;
+			llist_move(&pr->list, &grp->queue[prio]);
+			llist_move_tail(&pr->u.paging.class_list,
+					&ps->class_records[prio]);
 		}
+		ps->stats.duplicates++;
+		return -EEXIST;
 	}
 
-	pr = talloc_zero(ps, struct paging_record);
+	if (ps->num_paging >= ps->num_paging_max &&
+	    paging_preempt(ps, prio) < 0) {
+		LOGP(DPAG, LOGL_NOTICE, "Dropping paging of priority %s, "
+			"queue full (%u)\n",
+			get_value_string(paging_prio_names, prio),
+			ps->num_paging);
+		ps->stats.dropped++;
+		ps->stats.prio[prio].dropped++;
+		return -ENOSPC;
+	}
+
+	pr = pr_alloc(ps);
 	if (!pr)
 		return -ENOMEM;
 	pr->type = PAGING_RECORD_PAGING;
 
-	if (*identity_lv + 1 > sizeof(pr->u.paging.identity_lv)) {
-		talloc_free(pr);
-		return -E2BIG;
-	}
-
-	LOGP(DPAG, LOGL_INFO, "Add paging to queue (group=%u, queue_len=%u)\n",
-		paging_group, ps->num_paging+1);
+	LOGP(DPAG, LOGL_INFO, "Add paging to queue (ccch=%u, group=%u, "
+		"prio=%s, queue_len=%u)\n", ccch, paging_group,
+		get_value_string(paging_prio_names, prio), ps->num_paging+1);
 
-	pr->u.paging.expiration_time = time(NULL) + ps->paging_lifetime;
 	pr->u.paging.chan_needed = chan_needed;
+	pr->u.paging.group = idx;
+	pr->u.paging.prio = prio;
+	pr_set_expiration(ps, pr);
 	memcpy(&pr->u.paging.identity_lv, identity_lv, identity_lv[0]+1);
 
 	/* enqueue the new identity to the HEAD of the queue,
 	 * to ensure it will be paged quickly at least once.  */
-	llist_add(&pr->list, group_q);
+	llist_add(&pr->list, &grp->queue[prio]);
+	llist_add(&pr->u.paging.hash_list,
+		  &ps->paging_hash[identity_hash(identity_lv)]);
+	llist_add_tail(&pr->u.paging.class_list, &ps->class_records[prio]);
+	llist_add_tail(&pr->u.paging.unsent_list, &grp->unsent);
+	pr->queued_fn = ps->elapsed_fn;
 	ps->num_paging++;
 
+	ps->stats.added++;
+	ps->stats.prio[prio].added++;
+	if (ps->num_paging > ps->stats.max_queue_len)
+		ps->stats.max_queue_len = ps->num_paging;
+
 	return 0;
 }
 
 /* Add an IMM.ASS message to the paging queue */
-int paging_add_imm_ass(struct paging_state *ps, const uint8_t *data,
-		       uint8_t len)
+int paging_add_imm_ass(struct paging_state *ps, uint8_t ccch,
+		       const uint8_t *data, uint8_t len)
 {
-	struct llist_head *group_q;
 	struct paging_record *pr;
 	uint16_t imsi, paging_group;
+	int idx;
 
 	if (len != GSM_MACBLOCK_LEN + 3) {
 		LOGP(DPAG, LOGL_ERROR, "IMM.ASS invalid length %d\n", len);
@@ -243,19 +598,23 @@ int paging_add_imm_ass(struct paging_state *ps, const uint8_t *data,
 	imsi += (*(data++)) - '0';
 	paging_group = gsm0502_calc_paging_group(&ps->chan_desc, imsi);
 
-	group_q = &ps->paging_queue[paging_group];
+	idx = paging_group_idx(ccch, paging_group);
+	if (idx < 0)
+		return -EINVAL;
 
-	pr = talloc_zero(ps, struct paging_record);
+	pr = pr_alloc(ps);
 	if (!pr)
 		return -ENOMEM;
 	pr->type = PAGING_RECORD_IMM_ASS;
 
-	LOGP(DPAG, LOGL_INFO, "Add IMM.ASS to queue (group=%u)\n",
-		paging_group);
+	LOGP(DPAG, LOGL_INFO, "Add IMM.ASS to queue (ccch=%u, group=%u)\n",
+		ccch, paging_group);
 	memcpy(pr->u.imm_ass.msg, data, GSM_MACBLOCK_LEN);
+	pr->queued_fn = ps->elapsed_fn;
 
-	/* enqueue the new message to the HEAD of the queue */
-	llist_add(&pr->list, group_q);
+	/* enqueue the new message to the HEAD of the queue, it is sent
+	 * ahead of all paging records */
+	llist_add(&pr->list, &ps->group[idx].imm_ass_queue);
 
 	return 0;
 }
@@ -338,54 +697,108 @@ static int fill_paging_type_3(uint8_t *out_buf, const uint8_t *tmsi1_lv,
 
 static const uint8_t empty_id_lv[] = { 0x01, 0xF0 };
 
-static struct paging_record *dequeue_pr(struct llist_head *group_q)
+static int pr_is_tmsi(struct paging_record *pr)
 {
-	struct paging_record *pr;
-
-	pr = llist_entry(group_q->next, struct paging_record, list);
-	llist_del(&pr->list);
-
-	return pr;
-}
-
-static int pr_is_imsi(struct paging_record *pr)
-{
-	if ((pr->u.paging.identity_lv[1] & 7) == GSM_MI_TYPE_IMSI)
+	if (pr->u.paging.identity_lv[0] == 5 &&
+	    (pr->u.paging.identity_lv[1] & 7) == GSM_MI_TYPE_TMSI)
 		return 1;
 	else
 		return 0;
 }
 
-static void sort_pr_tmsi_imsi(struct paging_record *pr[], unsigned int n)
+/* Choose the priority class to be served by the next PCH block of a
+ * group, using a smooth weighted round robin among the classes that
+ * have records queued.  Returns -1 if there are none. */
+static int paging_sched_prio(struct paging_group *grp)
 {
-	int i, j;
-	struct paging_record *t;
+	int i, best = -1, total = 0;
 
-	if (n < 2)
-		return;
+	for (i = 0; i < _NUM_PAGING_PRIO; i++) {
+		if (llist_empty(&grp->queue[i])) {
+			grp->wrr_weight[i] = 0;
+			continue;
+		}
+		grp->wrr_weight[i] += paging_prio_weight[i];
+		total += paging_prio_weight[i];
+		if (best < 0 || grp->wrr_weight[i] > grp->wrr_weight[best])
+			best = i;
+	}
 
-	/* simple bubble sort */
-	for (i = n-2; i >= 0; i--) {
-		for (j=0; j<=i ; j++) {
-			if (pr_is_imsi(pr[j]) > pr_is_imsi(pr[j+1])) {
-				t = pr[j];
-				pr[j] = pr[j+1];
-				pr[j+1] = t;
-			}
+	if (best >= 0)
+		grp->wrr_weight[best] -= total;
+
+	return best;
+}
+
+/* Select the paging records for the next PCH block among the first
+ * PAGING_PACK_WINDOW records of a group, taken from the queue of the
+ * scheduled class first and then from the others by priority.  The
+ * record at the head of the scheduled queue is always taken, so nobody
+ * is overtaken for longer than the window, the others are taken in
+ * order such that the block carries as many identities as possible.
+ * TMSIs are put ahead of the other identities in pr[].  Returns the
+ * number of records and the PAGING REQUEST type to use. */
+static unsigned int pack_paging_records(struct paging_group *grp, int prio,
+					struct paging_record *pr[4],
+					int *type)
+{
+	struct paging_record *tmsi[4], *other[2], *first[2];
+	unsigned int num_tmsi = 0, num_other = 0, num = 0, n = 0;
+	struct paging_record *cur;
+	int i, q;
+
+	for (i = -1; i < _NUM_PAGING_PRIO; i++) {
+		q = i < 0 ? prio : i;
+		if (i == prio)
+			continue;
+		llist_for_each_entry(cur, &grp->queue[q], list) {
+			if (n++ >= PAGING_PACK_WINDOW)
+				break;
+			if (num < ARRAY_SIZE(first))
+				first[num++] = cur;
+			if (pr_is_tmsi(cur)) {
+				if (num_tmsi < ARRAY_SIZE(tmsi))
+					tmsi[num_tmsi++] = cur;
+			} else if (num_other < ARRAY_SIZE(other))
+				other[num_other++] = cur;
 		}
 	}
+
+	if (num_tmsi == 4 && tmsi[0] == first[0]) {
+		/* 4 TMSI, starting with the head of the queue */
+		*type = 3;
+		memcpy(pr, tmsi, 4 * sizeof(pr[0]));
+		return 4;
+	} else if (num_tmsi >= 2 && num_other >= 1) {
+		/* 2 TMSI and 1 xMSI, one of them the head of the queue */
+		*type = 2;
+		pr[0] = tmsi[0];
+		pr[1] = tmsi[1];
+		pr[2] = other[0];
+		return 3;
+	} else if (num_tmsi >= 3) {
+		*type = 2;
+		memcpy(pr, tmsi, 3 * sizeof(pr[0]));
+		return 3;
+	}
+
+	/* the first one or two of the queue, of any type */
+	*type = 1;
+	memcpy(pr, first, num * sizeof(pr[0]));
+	return num;
 }
 
 /* generate paging message for given gsm time */
-int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *gt,
-		   int *is_empty)
+int paging_gen_msg(struct paging_state *ps, uint8_t ccch, uint8_t *out_buf,
+		   struct gsm_time *gt, int *is_empty)
 {
-	struct llist_head *group_q;
-	int group;
+	struct paging_group *grp;
+	int group, prio;
 	int len;
 
 	*is_empty = 0;
 	ps->btsb->load.ccch.pch_total += 1;
+	paging_update_time(ps, gt->fn);
 
 	group = get_pag_subch_nr(ps, gt);
 	if (group < 0) {
@@ -394,62 +807,54 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 		     gt->fn, gt->t1, gt->t2, gt->t3);
 		return -1;
 	}
+	group = paging_group_idx(ccch, group);
+	if (group < 0)
+		return -1;
+
+	grp = &ps->group[group];
+	grp->blocks++;
 
-	group_q = &ps->paging_queue[group];
+	/* an IMMEDIATE ASSIGNMENT is sent right away */
+	if (!llist_empty(&grp->imm_ass_queue)) {
+		struct paging_record *pr;
+
+		ps->btsb->load.ccch.pch_used += 1;
+		grp->used_blocks++;
+
+		/* get message and free record */
+		pr = llist_entry(grp->imm_ass_queue.next,
+				 struct paging_record, list);
+		llist_del(&pr->list);
+		memcpy(out_buf, pr->u.imm_ass.msg, GSM_MACBLOCK_LEN);
+		pcu_tx_pch_data_cnf(gt->fn, pr->u.imm_ass.msg,
+				    GSM_MACBLOCK_LEN);
+		pr_free(ps, pr);
+		ps->stats.pch_imm_ass++;
+		paging_expire(ps, group);
+		return GSM_MACBLOCK_LEN;
+	}
+
+	prio = paging_sched_prio(grp);
 
 	/* There is nobody to be paged, send Type1 with two empty ID */
-	if (llist_empty(group_q)) {
+	if (prio < 0) {
 		//DEBUGP(DPAG, "Tx PAGING TYPE 1 (empty)\n");
 		len = fill_paging_type_1(out_buf, empty_id_lv, 0,
 					 NULL, 0);
 		*is_empty = 1;
+		ps->stats.pch_blocks[0]++;
 	} else {
 		struct paging_record *pr[4];
-		unsigned int num_pr = 0, imm_ass = 0;
-		time_t now = time(NULL);
-		unsigned int i, num_imsi = 0;
+		unsigned int num_pr, i;
+		int type;
 
 		ps->btsb->load.ccch.pch_used += 1;
+		grp->used_blocks++;
 
-		/* get (if we have) up to four paging records */
-		for (i = 0; i < ARRAY_SIZE(pr); i++) {
-			if (llist_empty(group_q))
-				break;
-			pr[i] = dequeue_pr(group_q);
-
-			/* check for IMM.ASS */
-			if (pr[i]->type == PAGING_RECORD_IMM_ASS) {
-				imm_ass = 1;
-				break;
-			}
-
-			num_pr++;
+		num_pr = pack_paging_records(grp, prio, pr, &type);
 
-			/* count how many IMSIs are among them */
-			if (pr_is_imsi(pr[i]))
-				num_imsi++;
-		}
-
-		/* if we have an IMMEDIATE ASSIGNMENT */
-		if (imm_ass) {
-			/* re-add paging records */
-			for (i = 0; i < num_pr; i++)
-				llist_add(&pr[i]->list, group_q);
-
-			/* get message and free record */
-			memcpy(out_buf, pr[num_pr]->u.imm_ass.msg,
-							GSM_MACBLOCK_LEN);
-			pcu_tx_pch_data_cnf(gt->fn, pr[num_pr]->u.imm_ass.msg,
-							GSM_MACBLOCK_LEN);
-			talloc_free(pr[num_pr]);
-			return GSM_MACBLOCK_LEN;
-		}
-
-		/* make sure the TMSIs are ahead of the IMSIs in the array */
-		sort_pr_tmsi_imsi(pr, num_pr);
-
-		if (num_pr == 4 && num_imsi == 0) {
-			/* No IMSI: easy case, can use TYPE 3 */
+		switch (type) {
+		case 3:
 			DEBUGP(DPAG, "Tx PAGING TYPE 3 (4 TMSI)\n");
 			len = fill_paging_type_3(out_buf,
 						 pr[0]->u.paging.identity_lv,
@@ -458,8 +863,8 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 						 pr[1]->u.paging.chan_needed,
 						 pr[2]->u.paging.identity_lv,
 						 pr[3]->u.paging.identity_lv);
-		} else if (num_pr >= 3 && num_imsi <= 1) {
-			/* 3 or 4, of which only up to 1 is IMSI */
+			break;
+		case 2:
 			DEBUGP(DPAG, "Tx PAGING TYPE 2 (2 TMSI,1 xMSI)\n");
 			len = fill_paging_type_2(out_buf,
 						 pr[0]->u.paging.identity_lv,
@@ -467,62 +872,123 @@ int paging_gen_msg(struct paging_state *ps, uint8_t *out_buf, struct gsm_time *g
 						 pr[1]->u.paging.identity_lv,
 						 pr[1]->u.paging.chan_needed,
 						 pr[2]->u.paging.identity_lv);
-			if (num_pr == 4) {
-				/* re-add #4 for next time */
-				llist_add(&pr[3]->list, group_q);
-				pr[3] = NULL;
-			}
-		} else if (num_pr == 1) {
-			DEBUGP(DPAG, "Tx PAGING TYPE 1 (1 xMSI,1 empty)\n");
-			len = fill_paging_type_1(out_buf,
+			break;
+		default:
+			if (num_pr == 1) {
+				DEBUGP(DPAG, "Tx PAGING TYPE 1 (1 xMSI,1 empty)\n");
+				len = fill_paging_type_1(out_buf,
 						 pr[0]->u.paging.identity_lv,
 						 pr[0]->u.paging.chan_needed,
 						 NULL, 0);
-		} else {
-			/* 2 (any type) or
-			 * 3 or 4, of which only 2 will be sent */
-			DEBUGP(DPAG, "Tx PAGING TYPE 1 (2 xMSI)\n");
-			len = fill_paging_type_1(out_buf,
+			} else {
+				DEBUGP(DPAG, "Tx PAGING TYPE 1 (2 xMSI)\n");
+				len = fill_paging_type_1(out_buf,
 						 pr[0]->u.paging.identity_lv,
 						 pr[0]->u.paging.chan_needed,
 						 pr[1]->u.paging.identity_lv,
 						 pr[1]->u.paging.chan_needed);
-			if (num_pr >= 3) {
-				/* re-add #4 for next time */
-				llist_add(&pr[2]->list, group_q);
-				pr[2] = NULL;
-			}
-			if (num_pr == 4) {
-				/* re-add #4 for next time */
-				llist_add(&pr[3]->list, group_q);
-				pr[3] = NULL;
 			}
+			break;
 		}
+		ps->stats.pch_blocks[num_pr]++;
 
 		for (i = 0; i < num_pr; i++) {
-			/* skip those that we might have re-added above */
-			if (pr[i] == NULL)
-				continue;
-			/* check if we can expire the paging record,
-			 * or if we need to re-queue it */
-			if (pr[i]->u.paging.expiration_time <= now) {
-				talloc_free(pr[i]);
-				ps->num_paging--;
-				LOGP(DPAG, LOGL_INFO, "Removed paging record, queue_len=%u\n",
-					ps->num_paging);
-			} else
-				llist_add_tail(&pr[i]->list, group_q);
+			/* re-queue it, paging_expire() decides whether
+			 * it is paged again */
+			if (!pr[i]->u.paging.sent)
+				llist_del(&pr[i]->u.paging.unsent_list);
+			pr[i]->u.paging.sent = 1;
+			llist_move_tail(&pr[i]->list,
+					&grp->queue[pr[i]->u.paging.prio]);
+			ps->stats.prio[pr[i]->u.paging.prio].sent++;
 		}
+		paging_expire(ps, group);
 	}
 	memset(out_buf+len, 0x2B, GSM_MACBLOCK_LEN-len);
 	return len;
 }
 
+/*! \brief how long the most urgent message of a paging block waits
+ *  \returns age in frames of the oldest IMM.ASS or identity not paged
+ *  yet of the paging group served at the given time, -1 if there is
+ *  none (repetitions of identities that were paged already don't count)
+ */
+int paging_block_age(struct paging_state *ps, uint8_t ccch,
+		     struct gsm_time *gt)
+{
+	struct paging_group *grp;
+	struct paging_record *pr;
+	int group;
+
+	paging_update_time(ps, gt->fn);
+
+	group = get_pag_subch_nr(ps, gt);
+	if (group < 0)
+		return -1;
+	group = paging_group_idx(ccch, group);
+	if (group < 0)
+		return -1;
+	grp = &ps->group[group];
+
+	/* IMM.ASS are queued at the head */
+	if (!llist_empty(&grp->imm_ass_queue))
+		pr = llist_entry(grp->imm_ass_queue.prev,
+				 struct paging_record, list);
+	else if (!llist_empty(&grp->unsent))
+		pr = llist_entry(grp->unsent.next,
+				 struct paging_record, u.paging.unsent_list);
+	else
+		return -1;
+
+	return ps->elapsed_fn - pr->queued_fn;
+}
+
+/* each paging group is served once in that many frames */
+unsigned int paging_get_cycle_frames(struct paging_state *ps)
+{
+	return (ps->chan_desc.bs_pa_mfrms + 2) * 51;
+}
+
+/*! \brief how busy the paging groups were since the last call
+ *  \param[out] hist number of paging groups by the share of their PCH
+ *  blocks that carried a message, in steps of 1 / num_bins
+ *  \param[in] num_bins size of hist
+ *
+ * Paging groups that had no PCH block since the last call (because
+ * they don't exist with the current BS_PA_MFRMS, or the CCCH is not
+ * configured) are not counted.
+ */
+void paging_group_occupancy(struct paging_state *ps, unsigned int *hist,
+			    unsigned int num_bins)
+{
+	unsigned int i, bin;
+
+	memset(hist, 0, num_bins * sizeof(*hist));
+
+	for (i = 0; i < ARRAY_SIZE(ps->group); i++) {
+		struct paging_group *grp = &ps->group[i];
+
+		if (!grp->blocks)
+			continue;
+		bin = grp->used_blocks * num_bins / grp->blocks;
+		if (bin >= num_bins)
+			bin = num_bins - 1;
+		hist[bin]++;
+		grp->blocks = grp->used_blocks = 0;
+	}
+}
+
 int paging_si_update(struct paging_state *ps, struct gsm48_control_channel_descr *chan_desc)
 {
 	LOGP(DPAG, LOGL_INFO, "Paging SI update\n");
 
-	ps->chan_desc = *chan_desc;
+	if (ps->chan_desc.bs_pa_mfrms != chan_desc->bs_pa_mfrms ||
+	    ps->chan_desc.bs_ag_blks_res != chan_desc->bs_ag_blks_res ||
+	    ps->chan_desc.ccch_conf != chan_desc->ccch_conf) {
+		ps->chan_desc = *chan_desc;
+		paging_rebuild_wheels(ps);
+	} else
+		ps->chan_desc = *chan_desc;
 
 	/* FIXME: do we need to re-sort the old paging_records? */
 
@@ -563,11 +1029,25 @@ struct paging_state *paging_init(struct gsm_bts_role_bts *btsb,
 		return NULL;
 
 	ps->btsb = btsb;
-	ps->paging_lifetime = paging_lifetime;
+	paging_set_lifetime(ps, paging_lifetime);
 	ps->num_paging_max = num_paging_max;
 
-	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++)
-		INIT_LLIST_HEAD(&ps->paging_queue[i]);
+	for (i = 0; i < ARRAY_SIZE(ps->group); i++) {
+		struct paging_group *grp = &ps->group[i];
+		int j;
+
+		for (j = 0; j < _NUM_PAGING_PRIO; j++)
+			INIT_LLIST_HEAD(&grp->queue[j]);
+		INIT_LLIST_HEAD(&grp->imm_ass_queue);
+		INIT_LLIST_HEAD(&grp->unsent);
+		for (j = 0; j < PAGING_WHEEL_SLOTS; j++)
+			INIT_LLIST_HEAD(&grp->wheel[j]);
+	}
+	for (i = 0; i < ARRAY_SIZE(ps->class_records); i++)
+		INIT_LLIST_HEAD(&ps->class_records[i]);
+	for (i = 0; i < ARRAY_SIZE(ps->paging_hash); i++)
+		INIT_LLIST_HEAD(&ps->paging_hash[i]);
+	INIT_LLIST_HEAD(&ps->free_records);
 
 	if (!initialized) {
 		osmo_signal_register_handler(SS_GLOBAL, paging_signal_cbfn, NULL);
@@ -581,21 +1061,30 @@ void paging_config(struct paging_state *ps,
 		  unsigned int paging_lifetime)
 {
 	ps->num_paging_max = num_paging_max;
-	ps->paging_lifetime = paging_lifetime;
+	paging_set_lifetime(ps, paging_lifetime);
 }
 
-void paging_reset(struct paging_state *ps)
+static void paging_flush_queue(struct paging_state *ps,
+			       struct llist_head *queue)
 {
-	int i;
+	struct paging_record *pr, *pr2;
 
-	for (i = 0; i < ARRAY_SIZE(ps->paging_queue); i++) {
-		struct llist_head *queue = &ps->paging_queue[i];
-		struct paging_record *pr, *pr2;
-		llist_for_each_entry_safe(pr, pr2, queue, list) {
-			llist_del(&pr->list);
-			talloc_free(pr);
+	llist_for_each_entry_safe(pr, pr2, queue, list) {
+		llist_del(&pr->list);
+		if (pr->type == PAGING_RECORD_PAGING)
 			ps->num_paging--;
-		}
+		pr_free(ps, pr);
+	}
+}
+
+void paging_reset(struct paging_state *ps)
+{
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(ps->group); i++) {
+		for (j = 0; j < _NUM_PAGING_PRIO; j++)
+			paging_flush_queue(ps, &ps->group[i].queue[j]);
+		paging_flush_queue(ps, &ps->group[i].imm_ass_queue);
 	}
 
 	if (ps->num_paging != 0)
@@ -607,14 +1096,27 @@ void paging_reset(struct paging_state *ps)
 /**
  * \brief Helper for the unit tests
  */
-int paging_group_queue_empty(struct paging_state *ps, uint8_t grp)
+int paging_group_queue_empty(struct paging_state *ps, uint8_t ccch,
+			     uint8_t group)
 {
-	if (grp >= ARRAY_SIZE(ps->paging_queue))
+	int grp = paging_group_idx(ccch, group);
+	int i;
+
+	if (grp < 0)
 		return 1;
-	return llist_empty(&ps->paging_queue[grp]);
+	for (i = 0; i < _NUM_PAGING_PRIO; i++) {
+		if (!llist_empty(&ps->group[grp].queue[i]))
+			return 0;
+	}
+	return llist_empty(&ps->group[grp].imm_ass_queue);
 }
 
 int paging_queue_length(struct paging_state *ps)
 {
 	return ps->num_paging;
 }
+
+const struct paging_stats *paging_get_stats(struct paging_state *ps)
+{
+	return &ps->stats;
+}
@@ -483,9 +483,16 @@ static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
 			 * is used instead. */
 		} else {
 			struct gsm_bts_role_bts *btsb = bts->role;
+			int ccch = bts_ccch_index(data_req->ts_nr);
 
-			paging_add_imm_ass(btsb->paging_state, data_req->data,
-				data_req->len);
+			if (ccch < 0) {
+				LOGP(DPCU, LOGL_ERROR, "PCU PCH request on "
+					"non-CCCH TS %u\n", data_req->ts_nr);
+				rc = -EINVAL;
+				break;
+			}
+			paging_add_imm_ass(btsb->paging_state, ccch,
+				data_req->data, data_req->len);
 		}
 		break;
 	case PCU_IF_SAPI_AGCH:
@@ -496,7 +503,7 @@ static int pcu_rx_data_req(struct gsm_bts *bts, uint8_t msg_type,
 		}
 		msg->l3h = msgb_put(msg, data_req->len);
 		memcpy(msg->l3h, data_req->data, data_req->len);
-		if (bts_agch_enqueue(bts, msg) < 0) {
+		if (bts_agch_enqueue(bts, data_req->ts_nr, msg) < 0) {
 			msgb_free(msg);
 			rc = -EIO;
 		}
@@ -0,0 +1,311 @@
+/* BTS side RACH overload control */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * After a power outage all phones of a site try to register at once.
+ * Every RACH burst turns into a CHAN RQD, the BSC runs out of SDCCH and
+ * the AGCH fills with rejects, and the phones keep retrying.
+ *
+ * Every RACH_OVLD_TICK_MS the RACH rate, the AGCH queue and the time
+ * the BSC takes to answer a CHAN RQD are checked against thresholds,
+ * all of them off by default.  Each RACH_OVLD_RAISE_MS in overload
+ * raises the overload level by one, each release_ms without overload
+ * lowers it by one.  At level n only (10 - n) / 10 of the configured
+ * RACH rate is passed on to the BSC, emergency calls always are.  The
+ * level stops at 9, so normal access never stops completely even while
+ * the retries of the MS keep the RACH rate up.  Optionally n of the
+ * access classes 0..9 are barred in the SYSTEM INFORMATION we
+ * broadcast.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <osmocom/core/timer.h>
+#include <osmocom/gsm/gsm_utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
+#include <osmo-bts/rach_overload.h>
+
+/* SYSTEM INFORMATION with RACH Control Parameters */
+static const struct {
+	enum osmo_sysinfo_type type;
+	size_t offset;
+} rach_si[RACH_OVLD_NUM_SI] = {
+	{ SYSINFO_TYPE_1,
+	  offsetof(struct gsm48_system_information_type_1, rach_control) },
+	{ SYSINFO_TYPE_2,
+	  offsetof(struct gsm48_system_information_type_2, rach_control) },
+	{ SYSINFO_TYPE_2bis,
+	  offsetof(struct gsm48_system_information_type_2bis, rach_control) },
+	{ SYSINFO_TYPE_3,
+	  offsetof(struct gsm48_system_information_type_3, rach_control) },
+	{ SYSINFO_TYPE_4,
+	  offsetof(struct gsm48_system_information_type_4, rach_control) },
+};
+
+/* establishment cause 101xxxxx, GSM 04.08 Table 9.9 */
+static int ra_is_emergency(uint8_t ra)
+{
+	return (ra & 0xe0) == 0xa0;
+}
+
+/* Request Reference as sent in the CHAN RQD, GSM 04.08 10.5.2.30 */
+static void gen_req_ref(uint8_t *ref, uint8_t ra, uint32_t fn)
+{
+	uint8_t t1 = (fn / (26 * 51)) % 32;
+	uint8_t t2 = fn % 26;
+	uint8_t t3 = fn % 51;
+
+	ref[0] = ra;
+	ref[1] = (t1 << 3) | (t3 >> 3);
+	ref[2] = (t3 << 5) | t2;
+}
+
+/*! \brief bar access classes 0..9 in the RACH Control Parameters of
+ *  the SI according to the overload level */
+void rach_overload_update_si(struct gsm_bts *bts)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+	uint16_t barred = 0, bsc_barred, si_barred;
+	int i, ac;
+
+	if (ro->acc_barring) {
+		for (i = 0; i < ro->level; i++)
+			barred |= 1 << ((ro->acc_rotate + i) % 10);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(rach_si); i++) {
+		struct gsm48_rach_control *rc;
+
+		if (!(bts->si_valid & (1 << rach_si[i].type)))
+			continue;
+		rc = (void *) (bts->si_buf[rach_si[i].type] +
+			       rach_si[i].offset);
+
+		/* not what we sent last, the BSC updated it */
+		if (rc->t2 != ro->acc[i].t2_tx || rc->t3 != ro->acc[i].t3_tx) {
+			ro->acc[i].t2 = rc->t2;
+			ro->acc[i].t3 = rc->t3;
+		}
+
+		/* if the BSC bars all the others, leave the last class
+		 * we bar open */
+		bsc_barred = (ro->acc[i].t2 << 8) | ro->acc[i].t3;
+		si_barred = barred;
+		for (ac = ro->level - 1; ac >= 0; ac--) {
+			uint16_t bit = 1 << ((ro->acc_rotate + ac) % 10);
+
+			if (((bsc_barred | si_barred) & 0x3ff) != 0x3ff)
+				break;
+			if (!(bsc_barred & bit))
+				si_barred &= ~bit;
+		}
+
+		rc->t2 = ro->acc[i].t2 | (si_barred >> 8);
+		rc->t3 = ro->acc[i].t3 | (si_barred & 0xff);
+		ro->acc[i].t2_tx = rc->t2;
+		ro->acc[i].t3_tx = rc->t3;
+	}
+}
+
+static void rach_overload_set_level(struct gsm_bts *bts, int level)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+
+	if (ro->level == 0)
+		ro->stats.overloads++;
+
+	LOGP(DRSL, level > ro->level ? LOGL_NOTICE : LOGL_INFO,
+	     "RACH overload level %d -> %d\n", ro->level, level);
+	ro->level = level;
+	rach_overload_update_si(bts);
+}
+
+/* highest occupancy of the AGCH queues, in % of their limit */
+static unsigned int agch_occupancy(struct gsm_bts_role_bts *btsb)
+{
+	unsigned int i, occ, max_occ = 0;
+	int max_len = btsb->agch_max_queue_length;
+
+	if (max_len <= 0)
+		max_len = 1;
+
+	for (i = 0; i < ARRAY_SIZE(btsb->agch); i++) {
+		occ = btsb->agch[i].length * 100 / max_len;
+		if (occ > max_occ)
+			max_occ = occ;
+	}
+
+	return max_occ;
+}
+
+static void rach_overload_tick(void *data)
+{
+	struct gsm_bts *bts = data;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct rach_overload *ro = &btsb->rach_ovld;
+	unsigned int rate = ro->rach_count * 1000 / RACH_OVLD_TICK_MS;
+	unsigned int base;
+	int overload = 0;
+
+	if (ro->rach_thresh && rate > ro->rach_thresh)
+		overload = 1;
+	if (ro->agch_thresh && agch_occupancy(btsb) >= ro->agch_thresh)
+		overload = 1;
+	if (ro->abis_thresh_ms && ro->abis_delay_ms >= ro->abis_thresh_ms)
+		overload = 1;
+
+	if (overload) {
+		ro->release_ticks = 0;
+		if (ro->level < RACH_OVLD_MAX_LEVEL &&
+		    ++ro->raise_ticks * RACH_OVLD_TICK_MS >= RACH_OVLD_RAISE_MS) {
+			ro->raise_ticks = 0;
+			rach_overload_set_level(bts, ro->level + 1);
+		}
+	} else {
+		ro->raise_ticks = 0;
+		if (ro->level > 0 &&
+		    ++ro->release_ticks * RACH_OVLD_TICK_MS >= ro->release_ms) {
+			ro->release_ticks = 0;
+			rach_overload_set_level(bts, ro->level - 1);
+		}
+	}
+
+	/* rotate the barred access classes once per second */
+	if (ro->acc_barring && ro->level > 0 &&
+	    ++ro->ticks % (1000 / RACH_OVLD_TICK_MS) == 0) {
+		ro->acc_rotate++;
+		rach_overload_update_si(bts);
+	}
+
+	/* budget of CHAN RQD for the next tick, a fraction of the
+	 * configured RACH rate, or of the current one without */
+	base = ro->rach_thresh ? ro->rach_thresh : rate;
+	ro->credit = base * RACH_OVLD_TICK_MS *
+		(RACH_OVLD_NUM_STEPS - ro->level) / RACH_OVLD_NUM_STEPS;
+	ro->rach_count = 0;
+
+	/* without answers the response time fades out */
+	if (!ro->abis_answers)
+		ro->abis_delay_ms -= ro->abis_delay_ms / 8;
+	ro->abis_answers = 0;
+
+	osmo_timer_schedule(&ro->timer, 0, RACH_OVLD_TICK_MS * 1000);
+}
+
+/*! \brief decide whether a RACH is passed on to the BSC
+ *  \param[in] ra the RA of the access burst
+ *  \param[in] fn the frame number it was received in
+ *  \returns 1 to send a CHAN RQD, 0 to drop the RACH
+ */
+int rach_overload_admit(struct gsm_bts *bts, uint8_t ra, uint32_t fn)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+
+	ro->rach_count++;
+
+	if (ra_is_emergency(ra)) {
+		ro->stats.emergency++;
+	} else if (ro->level > 0) {
+		if (ro->credit < 1000) {
+			ro->stats.dropped++;
+			return 0;
+		}
+		ro->credit -= 1000;
+	}
+	ro->stats.admitted++;
+
+	gen_req_ref(ro->req[ro->req_next].ref, ra, fn);
+	ro->req[ro->req_next].fn = fn;
+	ro->req[ro->req_next].valid = 1;
+	ro->req_next = (ro->req_next + 1) % RACH_OVLD_REQ_HIST;
+
+	return 1;
+}
+
+static void rach_overload_answer(struct gsm_bts *bts,
+				 const struct gsm48_req_ref *req_ref)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct rach_overload *ro = &btsb->rach_ovld;
+	unsigned int i, delay;
+
+	for (i = 0; i < RACH_OVLD_REQ_HIST; i++) {
+		if (!ro->req[i].valid ||
+		    memcmp(ro->req[i].ref, req_ref, sizeof(ro->req[i].ref)))
+			continue;
+
+		ro->req[i].valid = 0;
+		delay = (btsb->ccch_sched.last_fn + GSM_MAX_FN - ro->req[i].fn)
+			% GSM_MAX_FN;
+		delay = delay * 120 / 26;	/* frames to ms */
+		/* moving average over ~8 answers */
+		ro->abis_delay_ms = (ro->abis_delay_ms * 7 + delay) / 8;
+		ro->abis_answers++;
+		return;
+	}
+}
+
+/*! \brief measure the response time of the BSC to our CHAN RQD
+ *  \param[in] data IMMEDIATE ASSIGNMENT (REJECT) from the BSC
+ */
+void rach_overload_imm_ass(struct gsm_bts *bts, const uint8_t *data,
+			   unsigned int len)
+{
+	const struct gsm48_imm_ass *ia = (const void *) data;
+	const struct gsm48_imm_ass_rej *rej = (const void *) data;
+
+	if (len < sizeof(*ia))
+		return;
+
+	switch (ia->msg_type) {
+	case GSM48_MT_RR_IMM_ASS:
+		rach_overload_answer(bts, &ia->req_ref);
+		break;
+	case GSM48_MT_RR_IMM_ASS_REJ:
+		if (len < sizeof(*rej))
+			return;
+		rach_overload_answer(bts, &rej->req_ref1);
+		rach_overload_answer(bts, &rej->req_ref2);
+		rach_overload_answer(bts, &rej->req_ref3);
+		rach_overload_answer(bts, &rej->req_ref4);
+		break;
+	}
+}
+
+void rach_overload_init(struct gsm_bts *bts)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+
+	ro->rach_thresh = RACH_OVLD_RACH_THRESH_DEFAULT;
+	ro->agch_thresh = RACH_OVLD_AGCH_THRESH_DEFAULT;
+	ro->abis_thresh_ms = RACH_OVLD_ABIS_THRESH_DEFAULT;
+	ro->release_ms = RACH_OVLD_RELEASE_DEFAULT;
+
+	ro->timer.data = bts;
+	ro->timer.cb = rach_overload_tick;
+	osmo_timer_schedule(&ro->timer, 0, RACH_OVLD_TICK_MS * 1000);
+}
@@ -47,6 +47,9 @@
 #include <osmo-bts/pcu_if.h>
 #include <osmo-bts/handover.h>
 #include <osmo-bts/cbch.h>
+#include <osmo-bts/voice_stats.h>
+#include <osmo-bts/bs_power_ctrl.h>
+#include <osmo-bts/ta_ctrl.h>
 
 //#define FAKE_CIPH_MODE_COMPL
 
@@ -388,9 +391,9 @@ static int rsl_rx_paging_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 {
 	struct gsm_bts_role_bts *btsb = trx->bts->role;
 	struct tlv_parsed tp;
-	uint8_t chan_needed = 0, paging_group;
+	uint8_t chan_needed = 0, emlpp_prio = 0, paging_group;
 	const uint8_t *identity_lv;
-	int rc;
+	int ccch, rc;
 
 	rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg));
 
@@ -404,8 +407,17 @@ static int rsl_rx_paging_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 	if (TLVP_PRESENT(&tp, RSL_IE_CHAN_NEEDED))
 		chan_needed = *TLVP_VAL(&tp, RSL_IE_CHAN_NEEDED);
 
-	rc = paging_add_identity(btsb->paging_state, paging_group,
-				 identity_lv, chan_needed);
+	/* 9.3.49 */
+	if (TLVP_PRESENT(&tp, RSL_IE_EMLPP_PRIO))
+		emlpp_prio = *TLVP_VAL(&tp, RSL_IE_EMLPP_PRIO) & 7;
+
+	/* with several CCCH, the channel number tells which one */
+	ccch = bts_ccch_index(msg->lchan->ts->nr);
+	if (ccch < 0)
+		return rsl_tx_error_report(trx, RSL_ERR_IE_CONTENT);
+
+	rc = paging_add_identity(btsb->paging_state, ccch, paging_group,
+				 identity_lv, chan_needed, emlpp_prio);
 	if (rc < 0) {
 		/* FIXME: notfiy the BSC somehow ?*/
 	}
@@ -439,6 +451,7 @@ static int rsl_rx_sms_bcast_cmd(struct gsm_bts_trx *trx, struct msgb *msg)
 static int rsl_rx_sacch_fill(struct gsm_bts_trx *trx, struct msgb *msg)
 {
 	struct gsm_bts *bts = trx->bts;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
 	struct tlv_parsed tp;
 	uint8_t rsl_si;
 	enum osmo_sysinfo_type osmo_si;
@@ -464,6 +477,7 @@ static int rsl_rx_sacch_fill(struct gsm_bts_trx *trx, struct msgb *msg)
 		if (len > sizeof(sysinfo_buf_t)-2)
 			len = sizeof(sysinfo_buf_t)-2;
 		bts->si_valid |= (1 << osmo_si);
+		btsb->sacch_fill.valid |= (1 << osmo_si);
 		bts->si_buf[osmo_si][0] = 0x03;	/* C/R + EA */
 		bts->si_buf[osmo_si][1] = 0x03;	/* UI frame */
 		memset(bts->si_buf[osmo_si]+2, 0x2b, sizeof(sysinfo_buf_t)-2);
@@ -473,9 +487,12 @@ static int rsl_rx_sacch_fill(struct gsm_bts_trx *trx, struct msgb *msg)
 			get_value_string(osmo_sitype_strs, osmo_si));
 	} else {
 		bts->si_valid &= ~(1 << osmo_si);
+		btsb->sacch_fill.valid &= ~(1 << osmo_si);
 		LOGP(DRSL, LOGL_INFO, " Rx RSL Disabling SACCH FILLING (SI%s)\n",
 			get_value_string(osmo_sitype_strs, osmo_si));
 	}
+	/* lchans on the BTS filling pick it up with their next block */
+	btsb->sacch_fill.version++;
 	osmo_signal_dispatch(SS_GLOBAL, S_NEW_SYSINFO, bts);
 
 	return 0;
@@ -498,8 +515,10 @@ static int rsl_rx_imm_ass(struct gsm_bts_trx *trx, struct msgb *msg)
 	msg->l2h = NULL;
 	msg->len = TLVP_LEN(&tp, RSL_IE_FULL_IMM_ASS_INFO);
 
-	/* put into the AGCH queue of the BTS */
-	if (bts_agch_enqueue(trx->bts, msg) < 0) {
+	rach_overload_imm_ass(trx->bts, msg->l3h, msg->len);
+
+	/* put into the AGCH queue of the CCCH */
+	if (bts_agch_enqueue(trx->bts, msg->lchan->ts->nr, msg) < 0) {
 		/* if there is no space in the queue: send DELETE IND */
 		msgb_free(msg);
 	}
@@ -518,6 +537,9 @@ int rsl_tx_rf_rel_ack(struct gsm_lchan *lchan)
 	struct msgb *msg;
 	uint8_t chan_nr = gsm_lchan2chan_nr(lchan);
 
+	/* the TRX might not need that much power any more */
+	bs_power_ctrl_apply(lchan);
+
 	if (lchan->rel_act_kind != LCHAN_REL_ACT_RSL) {
 		LOGP(DRSL, LOGL_NOTICE, "%s not sending REL ACK\n",
 			gsm_lchan_name(lchan));
@@ -568,6 +590,8 @@ int rsl_tx_chan_act_ack(struct gsm_lchan *lchan, struct gsm_time *gtime)
 
 	/* since activation was successful, do some lchan initialization */
 	lchan->meas.res_nr = 0;
+	meas_preproc_reset(lchan);
+	bs_power_ctrl_apply(lchan);
 
 	return abis_bts_rsl_sendmsg(msg);
 }
@@ -671,29 +695,6 @@ int rsl_tx_chan_rqd(struct gsm_bts_trx *trx, struct gsm_time *gtime,
 	return abis_bts_rsl_sendmsg(nmsg);
 }
 
-/* copy the SACCH related sysinfo from BTS global buffer to lchan specific buffer */
-static void copy_sacch_si_to_lchan(struct gsm_lchan *lchan)
-{
-	struct gsm_bts *bts = lchan->ts->trx->bts;
-	unsigned int i;
-
-	for (i = 0; i < ARRAY_SIZE(rsl_sacch_sitypes); i++) {
-		uint8_t rsl_si = rsl_sacch_sitypes[i];
-		uint8_t osmo_si = osmo_rsl2sitype(rsl_si);
-		uint8_t osmo_si_shifted = (1 << osmo_si);
-		if (osmo_si == SYSINFO_TYPE_NONE)
-			continue;
-		if (!(bts->si_valid & osmo_si_shifted)) {
-			lchan->si.valid &= ~osmo_si_shifted;
-			continue;
-		}
-		lchan->si.valid |= osmo_si_shifted;
-		memcpy(lchan->si.buf[osmo_si], bts->si_buf[osmo_si],
-			sizeof(sysinfo_buf_t));
-	}
-}
-
-
 static int encr_info2lchan(struct gsm_lchan *lchan,
 			   const uint8_t *val, uint8_t len)
 {
@@ -723,6 +724,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 {
 	struct abis_rsl_dchan_hdr *dch = msgb_l2(msg);
 	struct gsm_lchan *lchan = msg->lchan;
+	struct lchan_sacch *ls = &lchan_bts_state(lchan)->sacch;
 	struct rsl_ie_chan_mode *cm;
 	struct tlv_parsed tp;
 	uint8_t type;
@@ -736,6 +738,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 	}
 
 	/* Initialize channel defaults */
+	lchan->bs_power = 0;
 	lchan->ms_power = ms_pwr_ctl_lvl(lchan->ts->trx->bts->band, 0);
 	lchan->ms_power_ctrl.current = lchan->ms_power;
 	lchan->ms_power_ctrl.fixed = 0;
@@ -778,21 +781,26 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 	/* 9.3.4 BS Power */
 	if (TLVP_PRESENT(&tp, RSL_IE_BS_POWER))
 		lchan->bs_power = *TLVP_VAL(&tp, RSL_IE_BS_POWER);
+	bs_power_ctrl_reset(lchan, 0);
 	/* 9.3.13 MS Power */
 	if (TLVP_PRESENT(&tp, RSL_IE_MS_POWER)) {
 		lchan->ms_power = *TLVP_VAL(&tp, RSL_IE_MS_POWER);
 		lchan->ms_power_ctrl.current = lchan->ms_power;
 		lchan->ms_power_ctrl.fixed = 0;
 	}
+	ms_power_ctrl_reset(lchan, TLVP_PRESENT(&tp, RSL_IE_MS_POWER));
 	/* 9.3.24 Timing Advance */
 	if (TLVP_PRESENT(&tp, RSL_IE_TIMING_ADVANCE))
 		lchan->rqd_ta = *TLVP_VAL(&tp, RSL_IE_TIMING_ADVANCE);
+	ta_ctrl_reset(lchan);
 
 	/* 9.3.32 BS Power Parameters */
 	/* 9.3.31 MS Power Parameters */
 	/* 9.3.16 Physical Context */
 
 	/* 9.3.29 SACCH Information */
+	ls->own = 0;
+	ls->off = 0;
 	if (TLVP_PRESENT(&tp, RSL_IE_SACCH_INFO)) {
 		uint8_t tot_len = TLVP_LEN(&tp, RSL_IE_SACCH_INFO);
 		const uint8_t *val = TLVP_VAL(&tp, RSL_IE_SACCH_INFO);
@@ -818,7 +826,7 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 			/* We have to pre-fix with the two-byte LAPDM UI header */
 			if (copy_len > sizeof(sysinfo_buf_t)-2)
 				copy_len = sizeof(sysinfo_buf_t)-2;
-			lchan->si.valid |= (1 << osmo_si);
+			ls->own |= (1 << osmo_si);
 			lchan->si.buf[osmo_si][0] = 0x03;
 			lchan->si.buf[osmo_si][1] = 0x03;
 			memset(lchan->si.buf[osmo_si]+2, 0x2b, sizeof(sysinfo_buf_t)-2);
@@ -830,10 +838,12 @@ static int rsl_rx_chan_activ(struct msgb *msg)
 				return rsl_tx_error_report(msg->trx, RSL_ERR_IE_CONTENT);
 			}
 		}
-	} else {
-		/* use standard SACCH filling of the BTS */
-		copy_sacch_si_to_lchan(lchan);
+		/* none of the SACCH filling of the BTS */
+		ls->off = ~0;
 	}
+	/* otherwise the standard SACCH filling of the BTS is used */
+	lchan_sacch_update(lchan);
+
 	/* 9.3.52 MultiRate Configuration */
 	if (TLVP_PRESENT(&tp, RSL_IE_MR_CONFIG)) {
 		if (TLVP_LEN(&tp, RSL_IE_MR_CONFIG) > sizeof(lchan->mr_conf)) {
@@ -1079,6 +1089,7 @@ static int rsl_rx_mode_modif(struct msgb *msg)
 	}
 	cm = (struct rsl_ie_chan_mode *) TLVP_VAL(&tp, RSL_IE_CHAN_MODE);
 	lchan_tchmode_from_cmode(lchan, cm);
+	lchan_meas_sched_update(lchan);
 
 	/* 9.3.7 Encryption Information */
 	if (TLVP_PRESENT(&tp, RSL_IE_ENCR_INFO)) {
@@ -1136,10 +1147,48 @@ static int rsl_rx_ms_pwr_ctrl(struct msgb *msg)
 	return 0;
 }
 
+/* 8.4.16 BS POWER CONTROL */
+static int rsl_rx_bs_pwr_ctrl(struct msgb *msg)
+{
+	struct gsm_lchan *lchan = msg->lchan;
+	struct tlv_parsed tp;
+
+	rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg));
+	if (TLVP_PRESENT(&tp, RSL_IE_BS_POWER)) {
+		lchan->bs_power = *TLVP_VAL(&tp, RSL_IE_BS_POWER);
+		/* without BS Power Parameters we must not control it */
+		bs_power_ctrl_reset(lchan,
+			!TLVP_PRESENT(&tp, RSL_IE_BS_POWER_PARAM));
+
+		LOGP(DRSL, LOGL_NOTICE, "%s setting BS Power to %d\n",
+			gsm_lchan_name(lchan), lchan->bs_power & 0x0f);
+		bts_model_adjst_bs_pwr(lchan);
+	}
+
+	return 0;
+}
+
+/* 8.4.17 PREPROCess CONFIGure */
+static int rsl_rx_preproc_config(struct msgb *msg)
+{
+	struct gsm_lchan *lchan = msg->lchan;
+	struct tlv_parsed tp;
+
+	rsl_tlv_parse(&tp, msgb_l3(msg), msgb_l3len(msg));
+	if (!TLVP_PRESENT(&tp, RSL_IE_PREPROC_PARAM))
+		return rsl_tx_error_report(msg->trx, RSL_ERR_MAND_IE_ERROR);
+
+	meas_preproc_config(lchan, TLVP_VAL(&tp, RSL_IE_PREPROC_PARAM),
+			    TLVP_LEN(&tp, RSL_IE_PREPROC_PARAM));
+
+	return 0;
+}
+
 /* 8.4.20 SACCH INFO MODify */
 static int rsl_rx_sacch_inf_mod(struct msgb *msg)
 {
 	struct gsm_lchan *lchan = msg->lchan;
+	struct lchan_sacch *ls = &lchan_bts_state(lchan)->sacch;
 	struct tlv_parsed tp;
 	uint8_t rsl_si, osmo_si;
 
@@ -1169,7 +1218,7 @@ static int rsl_rx_sacch_inf_mod(struct msgb *msg)
 		/* We have to pre-fix with the two-byte LAPDM UI header */
 		if (len > sizeof(sysinfo_buf_t)-2)
 			len = sizeof(sysinfo_buf_t)-2;
-		lchan->si.valid |= (1 << osmo_si);
+		ls->own |= (1 << osmo_si);
 		lchan->si.buf[osmo_si][0] = 0x03;
 		lchan->si.buf[osmo_si][1] = 0x03;
 		memset(lchan->si.buf[osmo_si]+2, 0x2b, sizeof(sysinfo_buf_t)-2);
@@ -1179,11 +1228,13 @@ static int rsl_rx_sacch_inf_mod(struct msgb *msg)
 			gsm_lchan_name(lchan),
 			get_value_string(osmo_sitype_strs, osmo_si));
 	} else {
-		lchan->si.valid &= (1 << osmo_si);
+		ls->own &= ~(1 << osmo_si);
+		ls->off |= (1 << osmo_si);
 		LOGP(DRSL, LOGL_INFO, "%s Rx RSL Disabling SACCH FILLING (SI%s)\n",
 			gsm_lchan_name(lchan),
 			get_value_string(osmo_sitype_strs, osmo_si));
 	}
+	lchan_sacch_update(lchan);
 
 	return 0;
 }
@@ -1192,6 +1243,39 @@ static int rsl_rx_sacch_inf_mod(struct msgb *msg)
  * ip.access related messages
  */
 
+/* ip.access RTP connection statistics, in network byte order */
+struct ipac_conn_stat {
+	uint32_t packets_sent;
+	uint32_t octets_sent;
+	uint32_t packets_recv;
+	uint32_t octets_recv;
+	uint32_t packets_lost;
+	uint32_t arrival_jitter;	/* in ms */
+	uint32_t avg_tx_delay;
+} __attribute__((packed));
+
+/* append the statistics of the call that is being torn down */
+static void rsl_add_conn_stat(struct msgb *msg, struct gsm_lchan *lchan)
+{
+	struct ipac_conn_stat stat;
+	struct voice_quality vq;
+
+	lchan_voice_quality(lchan, &vq);
+	lchan_voice_quality_log(lchan, &vq);
+
+	stat.packets_sent = htonl(vq.rtp_tx_pkts);
+	stat.octets_sent = htonl(vq.rtp_tx_octets);
+	stat.packets_recv = htonl(vq.rtp_rx_pkts);
+	stat.octets_recv = htonl(vq.rtp_rx_octets);
+	stat.packets_lost = htonl(vq.rtp_rx_lost);
+	stat.arrival_jitter = htonl(vq.rtp_jitter_ms);
+	/* not measured */
+	stat.avg_tx_delay = 0;
+
+	msgb_tlv_put(msg, RSL_IE_IPAC_CONN_STAT, sizeof(stat),
+		     (uint8_t *) &stat);
+}
+
 int rsl_tx_ipac_dlcx_ind(struct gsm_lchan *lchan, uint8_t cause)
 {
 	struct msgb *nmsg;
@@ -1204,6 +1288,8 @@ int rsl_tx_ipac_dlcx_ind(struct gsm_lchan *lchan, uint8_t cause)
 		return -ENOMEM;
 
 	msgb_tlv_put(nmsg, RSL_IE_CAUSE, 1, &cause);
+	if (lchan->abis_ip.rtp_socket)
+		rsl_add_conn_stat(nmsg, lchan);
 	rsl_ipa_push_hdr(nmsg, RSL_MT_IPAC_DLCX_IND, gsm_lchan2chan_nr(lchan));
 
 	nmsg->trx = lchan->ts->trx;
@@ -1276,6 +1362,8 @@ static int rsl_tx_ipac_dlcx_ack(struct gsm_lchan *lchan, int inc_conn_id)
 
 	if (inc_conn_id)
 		msgb_tv_put(msg, RSL_IE_IPAC_CONN_ID, lchan->abis_ip.conn_id);
+	if (lchan->abis_ip.rtp_socket)
+		rsl_add_conn_stat(msg, lchan);
 
 	rsl_ipa_push_hdr(msg, RSL_MT_IPAC_DLCX_ACK, chan_nr);
 	msg->trx = lchan->ts->trx;
@@ -1445,6 +1533,7 @@ static int rsl_rx_ipac_XXcx(struct msgb *msg)
 					  btsb->rtp_jitter_buf_ms);
 		lchan->abis_ip.rtp_socket->priv = lchan;
 		lchan->abis_ip.rtp_socket->rx_cb = &bts_model_rtp_rx_cb;
+		lchan_voice_stats_reset(lchan);
 
 		if (connect_ip && connect_port) {
 			/* if CRCX specifies a remote IP, we can bind()
@@ -1554,11 +1643,14 @@ static int rsl_rx_ipac_dlcx(struct msgb *msg)
 	if (TLVP_PRESENT(&tp, RSL_IE_IPAC_CONN_ID))
 		inc_conn_id = 1;
 
+	/* the ACK reports the statistics of the RTP socket */
+	rc = rsl_tx_ipac_dlcx_ack(lchan, inc_conn_id);
+
 	osmo_rtp_socket_free(lchan->abis_ip.rtp_socket);
 	lchan->abis_ip.rtp_socket = NULL;
 	msgb_queue_flush(&lchan->dl_tch_queue);
 
-	return rsl_tx_ipac_dlcx_ack(lchan, inc_conn_id);
+	return rc;
 }
 
 /*
@@ -1640,6 +1732,15 @@ static int rsl_tx_meas_res(struct gsm_lchan *lchan, uint8_t *l3, int l3_len)
 {
 	struct msgb *msg;
 	uint8_t chan_nr = gsm_lchan2chan_nr(lchan);
+	int ms_to;
+
+	bs_power_ctrl_meas(lchan, l3, l3_len);
+
+	if (!meas_preproc_check(lchan, l3, l3_len)) {
+		/* nothing new for the BSC in this period */
+		lchan->meas.flags &= ~(LC_UL_M_F_RES_VALID | LC_UL_M_F_L1_VALID);
+		return 0;
+	}
 
 	LOGP(DRSL, LOGL_NOTICE, "%s Tx MEAS RES\n", gsm_lchan_name(lchan));
 
@@ -1662,7 +1763,9 @@ static int rsl_tx_meas_res(struct gsm_lchan *lchan, uint8_t *l3, int l3_len)
 		lchan->meas.flags &= ~LC_UL_M_F_L1_VALID;
 	}
 	msgb_tl16v_put(msg, RSL_IE_L3_INFO, l3_len, l3);
-		//msgb_tv_put(msg, RSL_IE_MS_TIMING_OFFSET, FIXME);
+	ms_to = ta_ctrl_ms_timing_offset(lchan);
+	if (ms_to >= 0)
+		msgb_tv_put(msg, RSL_IE_MS_TIMING_OFFSET, ms_to);
 
 	rsl_dch_push_hdr(msg, RSL_MT_MEAS_RES, chan_nr);
 	msg->trx = lchan->ts->trx;
@@ -1803,8 +1906,13 @@ static int rsl_rx_dchan(struct gsm_bts_trx *trx, struct msgb *msg)
 	case RSL_MT_MS_POWER_CONTROL:
 		ret = rsl_rx_ms_pwr_ctrl(msg);
 		break;
-	case RSL_MT_PHY_CONTEXT_REQ:
+	case RSL_MT_BS_POWER_CONTROL:
+		ret = rsl_rx_bs_pwr_ctrl(msg);
+		break;
 	case RSL_MT_PREPROC_CONFIG:
+		ret = rsl_rx_preproc_config(msg);
+		break;
+	case RSL_MT_PHY_CONTEXT_REQ:
 	case RSL_MT_RTD_REP:
 	case RSL_MT_PRE_HANDO_NOTIF:
 	case RSL_MT_MR_CODEC_MOD_REQ:
@@ -18,26 +18,115 @@
  */
 
 #include <stdint.h>
+#include <string.h>
+#include <strings.h>
 
 #include <osmocom/gsm/gsm_utils.h>
 #include <osmocom/gsm/sysinfo.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
 
 #include <osmo-bts/gsm_data.h>
+#include <osmo-bts/bts.h>
 
 #define BTS_HAS_SI(bts, sinum)	((bts)->si_valid & (1 << sinum))
 
-/* Apply the rules from 05.02 6.3.1.3 Mapping of BCCH Data */
-uint8_t *bts_sysinfo_get(struct gsm_bts *bts, struct gsm_time *g_time)
+/* what SI 3 announces about the optional SI types */
+struct si3_sched_info {
+	int si9;		/* SI 9 is sent */
+	int si13_ext;		/* SI 13 on BCCH Ext */
+	int si2quater_ext;	/* SI 2quater on BCCH Ext */
+};
+
+/* a bit of the rest octets, past the end they hold padding */
+static int ro_bit(const uint8_t *ro, unsigned int len, unsigned int *pos)
+{
+	unsigned int p = (*pos)++;
+
+	if (p / 8 >= len)
+		return (0x2b >> (7 - p % 8)) & 1;
+	return (ro[p / 8] >> (7 - p % 8)) & 1;
+}
+
+/* H/L bits are relative to the 0x2b padding, 1 for H */
+static int ro_high(const uint8_t *ro, unsigned int len, unsigned int *pos)
+{
+	unsigned int p = *pos;
+
+	return ro_bit(ro, len, pos) != ((0x2b >> (7 - p % 8)) & 1);
+}
+
+/* SI 3 Rest Octets, TS 44.018 10.5.2.34 */
+static void parse_si3_ro(struct si3_sched_info *info, const uint8_t *ro,
+			 unsigned int len)
+{
+	unsigned int pos = 0;
+
+	memset(info, 0, sizeof(*info));
+
+	/* Optional Selection Parameters */
+	if (ro_high(ro, len, &pos))
+		pos += 15;
+	/* Optional Power Offset */
+	if (ro_high(ro, len, &pos))
+		pos += 2;
+	/* System Information 2ter Indicator */
+	pos += 1;
+	/* Early Classmark Sending Control */
+	pos += 1;
+	/* Scheduling if and where */
+	if (ro_high(ro, len, &pos)) {
+		info->si9 = 1;
+		pos += 3;
+	}
+	/* GPRS Indicator: RA COLOUR, SI13 POSITION */
+	if (ro_high(ro, len, &pos)) {
+		pos += 3;
+		info->si13_ext = ro_bit(ro, len, &pos);
+	}
+	/* 3G Early Classmark Sending Restriction */
+	pos += 1;
+	/* SI2quater Indicator: SI2quater POSITION */
+	if (ro_high(ro, len, &pos))
+		info->si2quater_ext = ro_bit(ro, len, &pos);
+}
+
+/* Apply the rules from 05.02 6.3.1.3 Mapping of BCCH Data and build the
+ * schedule of BCCH Norm and BCCH Ext for 4 occurrences of each TC */
+void bts_sysinfo_sched_update(struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct si3_sched_info si3 = { 0, 0, 0 };
+	uint8_t tc4_sub[4];
 	unsigned int tc4_cnt = 0;
-	unsigned int tc4_sub[4];
+	uint8_t tc5_norm = SYSINFO_TYPE_NONE;
+	int has_2bis, has_2ter, has_2quater;
+	unsigned int i;
+
+	if (BTS_HAS_SI(bts, SYSINFO_TYPE_3)) {
+		struct gsm48_system_information_type_3 *si =
+			(struct gsm48_system_information_type_3 *)
+					GSM_BTS_SI(bts, SYSINFO_TYPE_3);
+
+		parse_si3_ro(&si3, si->rest_octets, sizeof(sysinfo_buf_t) -
+			     sizeof(*si));
+	}
+
+	has_2bis = BTS_HAS_SI(bts, SYSINFO_TYPE_2bis);
+	has_2ter = BTS_HAS_SI(bts, SYSINFO_TYPE_2ter);
+	has_2quater = BTS_HAS_SI(bts, SYSINFO_TYPE_2quater);
 
 	/* System information type 2 bis or 2 ter messages are sent if
 	 * needed, as determined by the system operator.  If only one of
 	 * them is needed, it is sent when TC = 5.  If both are needed,
 	 * 2bis is sent when TC = 5 and 2ter is sent at least once
 	 * within any of 4 consecutive occurrences of TC = 4.  */
+	if (has_2bis)
+		tc5_norm = SYSINFO_TYPE_2bis;
+	else if (has_2ter)
+		tc5_norm = SYSINFO_TYPE_2ter;
+	if (has_2bis && has_2ter)
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_2ter;
+
 	/* System information type 2 quater is sent if needed, as
 	 * determined by the system operator. If sent on BCCH Norm, it
 	 * shall be sent when TC = 5 if neither of 2bis and 2ter are
@@ -45,9 +134,13 @@ uint8_t *bts_sysinfo_get(struct gsm_bts *bts, struct gsm_time *g_time)
 	 * 4 consecutive occurrences of TC = 4. If sent on BCCH Ext, it
 	 * is sent at least once within any of 4 consecutive occurrences
 	 * of TC = 5. */
-	/* System Information type 9 is sent in those blocks with
-	 * TC = 4 which are specified in system information type 3 as
-	 * defined in 3GPP TS 04.08.  */
+	if (has_2quater && !si3.si2quater_ext) {
+		if (has_2bis || has_2ter)
+			tc4_sub[tc4_cnt++] = SYSINFO_TYPE_2quater;
+		else
+			tc5_norm = SYSINFO_TYPE_2quater;
+	}
+
 	/* System Information Type 13 need only be sent if GPRS support
 	 * is indicated in one or more of System Information Type 3 or 4
 	 * or 7 or 8 messages. These messages also indicate if the
@@ -55,91 +148,111 @@ uint8_t *bts_sysinfo_get(struct gsm_bts *bts, struct gsm_time *g_time)
 	 * transmitted on the BCCH Ext. In the case that the message is
 	 * sent on the BCCH Norm, it is sent at least once within any of
 	 * 4 consecutive occurrences of TC = 4. */
+	if (BTS_HAS_SI(bts, SYSINFO_TYPE_13) && !si3.si13_ext)
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_13;
 
-	/* We only implement BCCH Norm at this time */
-	switch (g_time->tc) {
-	case 0:
-		/* System Information Type 1 need only be sent if
-		 * frequency hopping is in use or when the NCH is
-		 * present in a cell. If the MS finds another message
-		 * when TC = 0, it can assume that System Information
-		 * Type 1 is not in use.  */
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_1);
-	case 1:
-		/* A SI 2 message will be sent at least every time TC = 1. */
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-	case 2:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 3:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
-	case 4:
-		/* iterate over 2ter, 2quater, 9, 13 */
-		/* determine how many SI we need to send on TC=4,
-		 * and which of them we send when */
-		if (BTS_HAS_SI(bts, SYSINFO_TYPE_2ter)) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2ter;
-			tc4_cnt += 1; /* 2bis */
-		}
-		if (BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-		    (BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) ||
-		     BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_2quater;
-			tc4_cnt += 1;
-		}
-		if (BTS_HAS_SI(bts, SYSINFO_TYPE_13)) {
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_13;
-			tc4_cnt += 1;
-		}
-		if (BTS_HAS_SI(bts, SYSINFO_TYPE_9)) {
-			/* FIXME: check SI3 scheduling info! */
-			tc4_sub[tc4_cnt] = SYSINFO_TYPE_9;
-			tc4_cnt += 1;
-		}
-		/* simply send SI2 if we have nothing else to send */
-		if (tc4_cnt == 0)
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2);
-		else {
-			/* increment static counter by one, modulo count */
-			btsb->si.tc4_ctr = (btsb->si.tc4_ctr + 1) % tc4_cnt;
-			return GSM_BTS_SI(bts, tc4_sub[btsb->si.tc4_ctr]);
+	/* System Information type 9 is sent in those blocks with
+	 * TC = 4 which are specified in system information type 3 as
+	 * defined in 3GPP TS 04.08.  */
+	if (BTS_HAS_SI(bts, SYSINFO_TYPE_9) && si3.si9)
+		tc4_sub[tc4_cnt++] = SYSINFO_TYPE_9;
+
+	for (i = 0; i < BCCH_SCHED_LEN; i++) {
+		uint8_t norm = SYSINFO_TYPE_NONE, ext = SYSINFO_TYPE_NONE;
+
+		switch (i % 8) {
+		case 0:
+			/* System Information Type 1 need only be sent if
+			 * frequency hopping is in use or when the NCH is
+			 * present in a cell. If the MS finds another message
+			 * when TC = 0, it can assume that System Information
+			 * Type 1 is not in use.  */
+			norm = SYSINFO_TYPE_1;
+			if (si3.si13_ext)
+				ext = SYSINFO_TYPE_13;
+			break;
+		case 1:
+			/* A SI 2 message will be sent at least every time
+			 * TC = 1. */
+			norm = SYSINFO_TYPE_2;
+			break;
+		case 2:
+		case 6:
+			norm = SYSINFO_TYPE_3;
+			break;
+		case 3:
+		case 7:
+			norm = SYSINFO_TYPE_4;
+			break;
+		case 4:
+			/* cycle through 2ter, 2quater, 13 and 9, or
+			 * simply send SI2 if there is nothing else */
+			if (tc4_cnt)
+				norm = tc4_sub[(i / 8) % tc4_cnt];
+			else
+				norm = SYSINFO_TYPE_2;
+			break;
+		case 5:
+			norm = tc5_norm;
+			if (si3.si2quater_ext)
+				ext = SYSINFO_TYPE_2quater;
+			break;
 		}
-	case 5:
-		/* 2bis, 2ter, 2quater */
-		if (BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) &&
-		    !BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
-
-		else if (BTS_HAS_SI(bts, SYSINFO_TYPE_2ter) &&
-			 !BTS_HAS_SI(bts, SYSINFO_TYPE_2bis))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2ter);
-
-		else if (BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) &&
-			 BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2bis);
-
-		else if (BTS_HAS_SI(bts, SYSINFO_TYPE_2quater) &&
-			 !BTS_HAS_SI(bts, SYSINFO_TYPE_2bis) &&
-			 !BTS_HAS_SI(bts, SYSINFO_TYPE_2ter))
-			return GSM_BTS_SI(bts, SYSINFO_TYPE_2quater);
-		break;
-	case 6:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_3);
-	case 7:
-		return GSM_BTS_SI(bts, SYSINFO_TYPE_4);
+
+		btsb->si.norm[i] = BTS_HAS_SI(bts, norm) ? norm
+							 : SYSINFO_TYPE_NONE;
+		btsb->si.ext[i] = BTS_HAS_SI(bts, ext) ? ext
+						       : SYSINFO_TYPE_NONE;
 	}
+}
+
+uint8_t *bts_sysinfo_get(struct gsm_bts *bts, struct gsm_time *g_time)
+{
+	uint8_t si = bts_role_bts(bts)->si.norm[(g_time->fn / 51) %
+						BCCH_SCHED_LEN];
 
-	return NULL;
+	return si ? GSM_BTS_SI(bts, si) : NULL;
+}
+
+uint8_t *bts_sysinfo_get_ext(struct gsm_bts *bts, struct gsm_time *g_time)
+{
+	uint8_t si = bts_role_bts(bts)->si.ext[(g_time->fn / 51) %
+					       BCCH_SCHED_LEN];
+
+	return si ? GSM_BTS_SI(bts, si) : NULL;
+}
+
+void lchan_sacch_update(struct gsm_lchan *lchan)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(lchan->ts->trx->bts);
+	struct lchan_sacch *ls = &lchan_bts_state(lchan)->sacch;
+
+	lchan->si.valid = ls->own | (btsb->sacch_fill.valid & ~ls->off);
+	ls->version = btsb->sacch_fill.version;
 }
 
 uint8_t *lchan_sacch_get(struct gsm_lchan *lchan)
 {
-	uint32_t tmp;
+	struct gsm_bts *bts = lchan->ts->trx->bts;
+	struct lchan_sacch *ls = &lchan_bts_state(lchan)->sacch;
+	uint32_t next;
+	unsigned int tmp;
 
-	for (tmp = lchan->si.last + 1; tmp != lchan->si.last; tmp = (tmp + 1) % _MAX_SYSINFO_TYPE) {
-		if (lchan->si.valid & (1 << tmp)) {
-			lchan->si.last = tmp;
-			return lchan->si.buf[tmp];
-		}
-	}
-	return NULL;
+	/* pick up a new SACCH FILLING of the BTS */
+	if (ls->version != bts_role_bts(bts)->sacch_fill.version)
+		lchan_sacch_update(lchan);
+
+	if (!lchan->si.valid)
+		return NULL;
+
+	/* the lowest type after the last one sent, else start over */
+	next = lchan->si.valid & ~((2U << lchan->si.last) - 1);
+	if (!next)
+		next = lchan->si.valid;
+	tmp = ffs(next) - 1;
+	lchan->si.last = tmp;
+
+	if (ls->own & (1 << tmp))
+		return lchan->si.buf[tmp];
+	return bts->si_buf[tmp];
 }
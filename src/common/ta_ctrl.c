@@ -0,0 +1,147 @@
+/* Timing advance control of dedicated channels */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * The BSC only sets the TA when it activates a lchan.  A MS moving
+ * away from or towards the BTS drifts out of its timeslot until the
+ * bursts get clipped.  At the end of every measurement period the
+ * average timing offset of its bursts is looked at: if it is at least
+ * hyst_qb quarter bits, the TA sent in the SACCH L1 header is moved by
+ * the rounded offset, at most max_step bits.  As the MS only applies
+ * the new TA with the next SACCH block, the next change is made
+ * interval periods later at the earliest, and not before the MS
+ * reports the new TA in the L1 header of its uplink SACCH blocks.
+ * The period in which it does may still have started with the old
+ * TA, so its offset is not used either.
+ *
+ * The BSC sees the TA the MS uses in the L1 Information of every
+ * MEASUREMENT RESULT, and the remaining offset in its MS Timing Offset.
+ * It is not told about the changes otherwise, so the loop is off until
+ * the operator enables it.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/ta_ctrl.h>
+
+static struct ta_ctrl_lchan *lchan_ta_ctrl(struct gsm_lchan *lchan)
+{
+	return &lchan_bts_state(lchan)->ta_ctrl;
+}
+
+void ta_ctrl_reset(struct gsm_lchan *lchan)
+{
+	memset(lchan_ta_ctrl(lchan), 0, sizeof(struct ta_ctrl_lchan));
+}
+
+/* offset in bits, rounded to the nearest one */
+static int qb2bits(int offs_qb)
+{
+	if (offs_qb < 0)
+		return -((-offs_qb + 2) / 4);
+	return (offs_qb + 2) / 4;
+}
+
+int ta_ctrl_ms_timing_offset(struct gsm_lchan *lchan)
+{
+	struct ta_ctrl_lchan *tl = lchan_ta_ctrl(lchan);
+	int val;
+
+	if (!tl->valid)
+		return -1;
+
+	/* TS 48.058 9.3.37, in bit periods with an offset of 63 */
+	val = qb2bits(tl->offs_qb) + 63;
+	if (val < 0)
+		val = 0;
+	if (val > 255)
+		val = 255;
+
+	return val;
+}
+
+void ta_ctrl_meas(struct gsm_lchan *lchan, int offs_qb)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(lchan->ts->trx->bts);
+	struct ta_ctrl *tc = &btsb->ta_ctrl;
+	struct ta_ctrl_lchan *tl = lchan_ta_ctrl(lchan);
+	int step, new_ta;
+
+	tl->offs_qb = offs_qb;
+	tl->valid = 1;
+
+	if (!tc->enabled)
+		return;
+
+	/* the MS might still be using the previous TA */
+	if (tl->hold)
+		tl->hold--;
+	if (tl->pending) {
+		if (lchan->meas.l1_info[1] != lchan->rqd_ta)
+			return;
+		tl->pending = 0;
+		return;
+	}
+	if (tl->hold)
+		return;
+
+	if (abs(offs_qb) < tc->hyst_qb)
+		return;
+
+	step = abs(qb2bits(offs_qb));
+	if (step == 0)
+		step = 1;
+	if (step > tc->max_step)
+		step = tc->max_step;
+
+	new_ta = lchan->rqd_ta + (offs_qb > 0 ? step : -step);
+	if (new_ta < 0)
+		new_ta = 0;
+	if (new_ta > btsb->max_ta)
+		new_ta = btsb->max_ta;
+	if (new_ta > 63)
+		new_ta = 63;
+	if (new_ta == lchan->rqd_ta)
+		return;
+
+	LOGP(DMEAS, LOGL_INFO, "%s timing offset %d qb, TA %u -> %d\n",
+		gsm_lchan_name(lchan), offs_qb, lchan->rqd_ta, new_ta);
+
+	lchan->rqd_ta = new_ta;
+	tl->hold = tc->interval - 1;
+	tl->pending = 1;
+	tl->changes++;
+	tc->changes++;
+}
+
+void ta_ctrl_init(struct gsm_bts *bts)
+{
+	struct ta_ctrl *tc = &bts_role_bts(bts)->ta_ctrl;
+
+	tc->enabled = 0;
+	tc->hyst_qb = TA_CTRL_HYST_DEFAULT;
+	tc->interval = TA_CTRL_INTERVAL_DEFAULT;
+	tc->max_step = TA_CTRL_MAX_STEP_DEFAULT;
+}
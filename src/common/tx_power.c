@@ -289,3 +289,21 @@ int power_ramp_start(struct gsm_bts_trx *trx, int p_total_tgt_mdBm, int bypass)
 
 	return 0;
 }
+
+/* change the output power without ramping, as needed by power control.
+ * A ramp in progress is restarted towards the new target. */
+int power_ctrl_change(struct gsm_bts_trx *trx, int p_total_tgt_mdBm)
+{
+	struct trx_power_params *tpp = &trx->power_params;
+
+	if (p_total_tgt_mdBm > get_p_nominal_mdBm(trx))
+		return -ERANGE;
+
+	if (tpp->ramp.attenuation_mdB != 0)
+		return power_ramp_start(trx, p_total_tgt_mdBm, 0);
+
+	tpp->p_total_tgt_mdBm = p_total_tgt_mdBm;
+	power_ramp_timer_cb(trx);
+
+	return 0;
+}
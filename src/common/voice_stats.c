@@ -0,0 +1,168 @@
+/* Voice quality statistics of traffic channels */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
+#include <osmocom/trau/osmo_ortp.h>
+
+#include <osmo-bts/logging.h>
+#include <osmo-bts/gsm_data.h>
+#include <osmo-bts/voice_stats.h>
+
+/* one-way delay added by speech framing, interleaving and the air
+ * interface.  The delay outside of the BTS is unknown to us. */
+#define VOICE_BTS_DELAY_MS	60
+
+/* RTP clock of all GSM speech codecs */
+#define VOICE_RTP_CLOCK_KHZ	8
+
+/* E-model parameters of the GSM speech codecs: equipment impairment
+ * factor Ie from ITU-T G.113 Appendix I and a packet loss robustness
+ * factor Bpl.  For AMR the values of the 12.2 kbit/s mode are used. */
+static const struct {
+	uint8_t ie;
+	uint8_t bpl;
+} codec_impairment[] = {
+	{ 20, 10 },	/* FR */
+	{ 23, 10 },	/* HR */
+	{  5, 10 },	/* EFR */
+	{  5, 10 },	/* AMR */
+};
+
+/*! \brief estimate the MOS of a call using a simplified E-model
+ *  \param[in] tch_mode GSM48_CMODE_* of the lchan
+ *  \param[in] full_rate TCH/F (1) or TCH/H (0)
+ *  \param[in] loss_pm frame loss in per mille
+ *  \param[in] delay_ms one-way delay
+ *  \returns MOS * 100 or 0 if the lchan carries no speech
+ *
+ * See ITU-T G.107, all impairments apart from the delay and the codec
+ * (including its frame loss) are assumed to be at their default values.
+ */
+unsigned int voice_mos_estimate(uint8_t tch_mode, int full_rate,
+				unsigned int loss_pm, unsigned int delay_ms)
+{
+	double ppl = loss_pm / 10.0;
+	double d = delay_ms;
+	double ie_eff, id, r, mos;
+	int codec;
+
+	switch (tch_mode) {
+	case GSM48_CMODE_SPEECH_V1:
+		codec = full_rate ? 0 : 1;
+		break;
+	case GSM48_CMODE_SPEECH_EFR:
+		codec = 2;
+		break;
+	case GSM48_CMODE_SPEECH_AMR:
+		codec = 3;
+		break;
+	default:
+		return 0;
+	}
+
+	ie_eff = codec_impairment[codec].ie +
+		(95 - codec_impairment[codec].ie) * ppl /
+		(ppl + codec_impairment[codec].bpl);
+
+	id = 0.024 * d;
+	if (d > 177.3)
+		id += 0.11 * (d - 177.3);
+
+	r = 93.2 - id - ie_eff;
+	if (r <= 0)
+		return 100;
+	if (r >= 100)
+		return 450;
+
+	mos = 1 + 0.035 * r + 7e-6 * r * (r - 60) * (100 - r);
+
+	return mos * 100 + 0.5;
+}
+
+struct voice_stats *lchan_voice_stats(struct gsm_lchan *lchan)
+{
+	return &lchan_bts_state(lchan)->voice;
+}
+
+/*! \brief reset the voice statistics at the start of a call */
+void lchan_voice_stats_reset(struct gsm_lchan *lchan)
+{
+	memset(lchan_voice_stats(lchan), 0, sizeof(struct voice_stats));
+}
+
+static unsigned int per_mille(uint32_t part, uint32_t total)
+{
+	if (!total)
+		return 0;
+	return (uint64_t) part * 1000 / total;
+}
+
+/*! \brief take a snapshot of the voice quality of a lchan */
+void lchan_voice_quality(struct gsm_lchan *lchan, struct voice_quality *vq)
+{
+	struct gsm_bts_role_bts *btsb = bts_role_bts(lchan->ts->trx->bts);
+	int full_rate = lchan->type == GSM_LCHAN_TCH_F;
+	uint32_t jitter = 0;
+
+	memset(vq, 0, sizeof(*vq));
+	vq->cnt = *lchan_voice_stats(lchan);
+
+	if (lchan->abis_ip.rtp_socket)
+		osmo_rtp_socket_stats(lchan->abis_ip.rtp_socket,
+				      &vq->rtp_tx_pkts, &vq->rtp_tx_octets,
+				      &vq->rtp_rx_pkts, &vq->rtp_rx_octets,
+				      &vq->rtp_rx_lost, &jitter);
+
+	/* duplicates can make the RTP stack report a negative loss */
+	if ((int32_t) vq->rtp_rx_lost < 0)
+		vq->rtp_rx_lost = 0;
+	vq->rtp_jitter_ms = jitter / VOICE_RTP_CLOCK_KHZ;
+
+	vq->dl_loss_pm = per_mille(vq->rtp_rx_lost,
+				   vq->rtp_rx_pkts + vq->rtp_rx_lost);
+	vq->ul_bfi_pm = per_mille(vq->cnt.ul_bfi, vq->cnt.ul_frames);
+
+	/* downlink frames wait in the jitter buffer, and the jitter
+	 * eats into it */
+	vq->mos_dl = voice_mos_estimate(lchan->tch_mode, full_rate,
+					vq->dl_loss_pm,
+					btsb->rtp_jitter_buf_ms +
+					vq->rtp_jitter_ms + VOICE_BTS_DELAY_MS);
+	vq->mos_ul = voice_mos_estimate(lchan->tch_mode, full_rate,
+					vq->ul_bfi_pm, VOICE_BTS_DELAY_MS);
+}
+
+void lchan_voice_quality_log(struct gsm_lchan *lchan,
+			     const struct voice_quality *vq)
+{
+	LOGP(DRTP, LOGL_NOTICE, "%s voice quality: RTP rx=%u lost=%u "
+		"jitter=%ums, DL underruns=%u/%u, UL BFI=%u/%u, "
+		"MOS DL=%u.%02u UL=%u.%02u\n", gsm_lchan_name(lchan),
+		vq->rtp_rx_pkts, vq->rtp_rx_lost, vq->rtp_jitter_ms,
+		vq->cnt.dl_underruns, vq->cnt.dl_blocks,
+		vq->cnt.ul_bfi, vq->cnt.ul_frames,
+		vq->mos_dl / 100, vq->mos_dl % 100,
+		vq->mos_ul / 100, vq->mos_ul % 100);
+}
@@ -161,6 +161,7 @@ DEFUN(cfg_bts_trx, cfg_bts_trx_cmd,
 static void config_write_bts_single(struct vty *vty, struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct rach_overload *ro = &btsb->rach_ovld;
 	struct gsm_bts_trx *trx;
 
 	vty_out(vty, "bts %u%s", bts->nr, VTY_NEWLINE);
@@ -182,6 +183,102 @@ static void config_write_bts_single(struct vty *vty, struct gsm_bts *bts)
 		vty_out(vty, " agch-queue-mgmt threshold %d low %d high %d%s",
 			btsb->agch_queue_thresh_level, btsb->agch_queue_low_level,
 			btsb->agch_queue_high_level, VTY_NEWLINE);
+	if (btsb->agch_queue_hard_limit != GSM_BTS_AGCH_QUEUE_HARD_LIMIT_DEFAULT)
+		vty_out(vty, " agch-queue-mgmt hard-limit %d%s",
+			btsb->agch_queue_hard_limit, VTY_NEWLINE);
+	if (btsb->ccch_sched.agch_target_ms != GSM_BTS_CCCH_AGCH_TARGET_DEFAULT
+	    || btsb->ccch_sched.paging_target_ms != GSM_BTS_CCCH_PAGING_TARGET_DEFAULT)
+		vty_out(vty, " ccch-scheduler agch-target %u paging-target %u%s",
+			btsb->ccch_sched.agch_target_ms,
+			btsb->ccch_sched.paging_target_ms, VTY_NEWLINE);
+	if (ro->rach_thresh != RACH_OVLD_RACH_THRESH_DEFAULT)
+		vty_out(vty, " overload rach-threshold %u%s", ro->rach_thresh,
+			VTY_NEWLINE);
+	if (ro->agch_thresh != RACH_OVLD_AGCH_THRESH_DEFAULT)
+		vty_out(vty, " overload agch-threshold %u%s", ro->agch_thresh,
+			VTY_NEWLINE);
+	if (ro->abis_thresh_ms != RACH_OVLD_ABIS_THRESH_DEFAULT)
+		vty_out(vty, " overload abis-threshold %u%s", ro->abis_thresh_ms,
+			VTY_NEWLINE);
+	if (ro->release_ms != RACH_OVLD_RELEASE_DEFAULT)
+		vty_out(vty, " overload release-time %u%s", ro->release_ms,
+			VTY_NEWLINE);
+	if (ro->acc_barring)
+		vty_out(vty, " overload access-class-barring%s", VTY_NEWLINE);
+	if (btsb->meas_preproc.mode != MEAS_PREPROC_BSC)
+		vty_out(vty, " meas-preproc mode %s%s",
+			get_value_string(meas_preproc_mode_names,
+					 btsb->meas_preproc.mode), VTY_NEWLINE);
+	if (btsb->meas_preproc.avg_periods != MEAS_PREPROC_AVG_DEFAULT)
+		vty_out(vty, " meas-preproc averaging %u%s",
+			btsb->meas_preproc.avg_periods, VTY_NEWLINE);
+	if (btsb->meas_preproc.rxlev_delta != MEAS_PREPROC_RXLEV_DELTA_DEFAULT
+	    || btsb->meas_preproc.rxqual_delta != MEAS_PREPROC_RXQUAL_DELTA_DEFAULT)
+		vty_out(vty, " meas-preproc change rxlev %u rxqual %u%s",
+			btsb->meas_preproc.rxlev_delta,
+			btsb->meas_preproc.rxqual_delta, VTY_NEWLINE);
+	if (btsb->meas_preproc.trig_rxlev != MEAS_PREPROC_TRIG_RXLEV_DEFAULT
+	    || btsb->meas_preproc.trig_rxqual != MEAS_PREPROC_TRIG_RXQUAL_DEFAULT)
+		vty_out(vty, " meas-preproc trigger rxlev %u rxqual %u%s",
+			btsb->meas_preproc.trig_rxlev,
+			btsb->meas_preproc.trig_rxqual, VTY_NEWLINE);
+	if (btsb->meas_preproc.interval != MEAS_PREPROC_INTERVAL_DEFAULT)
+		vty_out(vty, " meas-preproc interval %u%s",
+			btsb->meas_preproc.interval, VTY_NEWLINE);
+	if (btsb->bs_power_ctrl.mode != BS_PWR_CTRL_OFF)
+		vty_out(vty, " bs-power-control %s%s",
+			get_value_string(bs_pwr_ctrl_mode_names,
+					 btsb->bs_power_ctrl.mode), VTY_NEWLINE);
+	if (btsb->bs_power_ctrl.target != BS_PWR_CTRL_TARGET_DEFAULT
+	    || btsb->bs_power_ctrl.hyst != BS_PWR_CTRL_HYST_DEFAULT)
+		vty_out(vty, " bs-power-control target-rxlev %u hysteresis %u%s",
+			btsb->bs_power_ctrl.target, btsb->bs_power_ctrl.hyst,
+			VTY_NEWLINE);
+	if (btsb->bs_power_ctrl.raise_db != BS_PWR_CTRL_RAISE_DEFAULT
+	    || btsb->bs_power_ctrl.lower_db != BS_PWR_CTRL_LOWER_DEFAULT)
+		vty_out(vty, " bs-power-control step raise %u lower %u%s",
+			btsb->bs_power_ctrl.raise_db,
+			btsb->bs_power_ctrl.lower_db, VTY_NEWLINE);
+	if (btsb->bs_power_ctrl.max_red_db != BS_PWR_CTRL_MAX_RED_DEFAULT)
+		vty_out(vty, " bs-power-control max-reduction %u%s",
+			btsb->bs_power_ctrl.max_red_db, VTY_NEWLINE);
+	if (btsb->bs_power_ctrl.rxqual_max != BS_PWR_CTRL_RXQUAL_DEFAULT)
+		vty_out(vty, " bs-power-control rxqual-max %u%s",
+			btsb->bs_power_ctrl.rxqual_max, VTY_NEWLINE);
+	if (btsb->ms_power_ctrl.avg_blocks != MS_PWR_CTRL_AVG_DEFAULT)
+		vty_out(vty, " ms-power-control averaging %u%s",
+			btsb->ms_power_ctrl.avg_blocks, VTY_NEWLINE);
+	if (btsb->ms_power_ctrl.raise_thresh != MS_PWR_CTRL_RAISE_THRESH_DEFAULT
+	    || btsb->ms_power_ctrl.lower_thresh != MS_PWR_CTRL_LOWER_THRESH_DEFAULT)
+		vty_out(vty, " ms-power-control threshold raise %u lower %u%s",
+			btsb->ms_power_ctrl.raise_thresh,
+			btsb->ms_power_ctrl.lower_thresh, VTY_NEWLINE);
+	if (btsb->ms_power_ctrl.raise_max_db != MS_PWR_CTRL_RAISE_MAX_DEFAULT
+	    || btsb->ms_power_ctrl.lower_max_db != MS_PWR_CTRL_LOWER_MAX_DEFAULT)
+		vty_out(vty, " ms-power-control max-step raise %u lower %u%s",
+			btsb->ms_power_ctrl.raise_max_db,
+			btsb->ms_power_ctrl.lower_max_db, VTY_NEWLINE);
+	if (btsb->ms_power_ctrl.rxqual_raise != MS_PWR_CTRL_RXQUAL_DEFAULT)
+		vty_out(vty, " ms-power-control rxqual-raise %u%s",
+			btsb->ms_power_ctrl.rxqual_raise, VTY_NEWLINE);
+	if (btsb->ta_ctrl.enabled)
+		vty_out(vty, " ta-control on%s", VTY_NEWLINE);
+	if (btsb->ta_ctrl.hyst_qb != TA_CTRL_HYST_DEFAULT)
+		vty_out(vty, " ta-control hysteresis %u%s",
+			btsb->ta_ctrl.hyst_qb, VTY_NEWLINE);
+	if (btsb->ta_ctrl.interval != TA_CTRL_INTERVAL_DEFAULT)
+		vty_out(vty, " ta-control interval %u%s",
+			btsb->ta_ctrl.interval, VTY_NEWLINE);
+	if (btsb->ta_ctrl.max_step != TA_CTRL_MAX_STEP_DEFAULT)
+		vty_out(vty, " ta-control max-step %u%s",
+			btsb->ta_ctrl.max_step, VTY_NEWLINE);
+	if (btsb->load_stats.statsd.host)
+		vty_out(vty, " load-stats statsd %s %u%s",
+			btsb->load_stats.statsd.host,
+			btsb->load_stats.statsd.port, VTY_NEWLINE);
+	if (btsb->load_stats.statsd.interval != LOAD_STATS_STATSD_INTERVAL_DEFAULT)
+		vty_out(vty, " load-stats statsd-interval %u%s",
+			btsb->load_stats.statsd.interval, VTY_NEWLINE);
 
 	bts_model_config_write_bts(vty, bts);
 
@@ -383,6 +480,37 @@ DEFUN(cfg_bts_agch_queue_mgmt_params,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_bts_agch_queue_mgmt_hard_limit,
+	cfg_bts_agch_queue_mgmt_hard_limit_cmd,
+	"agch-queue-mgmt hard-limit <1-4000>",
+	AGCH_QUEUE_STR
+	"Maximum number of messages queued per CCCH timeslot\n"
+	"Number of messages, each one takes one msgb\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->agch_queue_hard_limit = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ccch_scheduler,
+	cfg_bts_ccch_scheduler_cmd,
+	"ccch-scheduler agch-target <10-10000> paging-target <10-10000>",
+	"Sharing of the PCH blocks between paging and AGCH\n"
+	"Target delay of access grants\nin milliseconds\n"
+	"Target delay of new paging\nin milliseconds\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ccch_sched.agch_target_ms = atoi(argv[0]);
+	btsb->ccch_sched.paging_target_ms = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_bts_agch_queue_mgmt_default,
 	cfg_bts_agch_queue_mgmt_default_cmd,
 	"agch-queue-mgmt default",
@@ -395,6 +523,436 @@ DEFUN(cfg_bts_agch_queue_mgmt_default,
 	btsb->agch_queue_thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DEFAULT;
 	btsb->agch_queue_low_level = GSM_BTS_AGCH_QUEUE_LOW_LEVEL_DEFAULT;
 	btsb->agch_queue_high_level = GSM_BTS_AGCH_QUEUE_HIGH_LEVEL_DEFAULT;
+	btsb->agch_queue_hard_limit = GSM_BTS_AGCH_QUEUE_HARD_LIMIT_DEFAULT;
+
+	return CMD_SUCCESS;
+}
+
+#define OVERLOAD_STR "RACH overload control\n"
+
+DEFUN(cfg_bts_overload_rach,
+	cfg_bts_overload_rach_cmd,
+	"overload rach-threshold <0-1000>",
+	OVERLOAD_STR
+	"RACH rate above which the cell is overloaded\n"
+	"RACH per second, 0 to disable\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.rach_thresh = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_overload_agch,
+	cfg_bts_overload_agch_cmd,
+	"overload agch-threshold <0-100>",
+	OVERLOAD_STR
+	"AGCH queue length above which the cell is overloaded\n"
+	"in %% of the maximum queue length, 0 to disable\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.agch_thresh = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_overload_abis,
+	cfg_bts_overload_abis_cmd,
+	"overload abis-threshold <0-10000>",
+	OVERLOAD_STR
+	"Response time of the BSC to a CHAN RQD above which the cell is overloaded\n"
+	"in milliseconds, 0 to disable\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.abis_thresh_ms = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_overload_release,
+	cfg_bts_overload_release_cmd,
+	"overload release-time <100-60000>",
+	OVERLOAD_STR
+	"Time without overload until the overload level is lowered\n"
+	"in milliseconds\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.release_ms = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_overload_barring,
+	cfg_bts_overload_barring_cmd,
+	"overload access-class-barring",
+	OVERLOAD_STR
+	"Bar access classes 0..9 in the SYSTEM INFORMATION under overload\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.acc_barring = 1;
+	rach_overload_update_si(bts);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_overload_barring,
+	cfg_bts_no_overload_barring_cmd,
+	"no overload access-class-barring",
+	NO_STR OVERLOAD_STR
+	"Bar access classes 0..9 in the SYSTEM INFORMATION under overload\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->rach_ovld.acc_barring = 0;
+	rach_overload_update_si(bts);
+
+	return CMD_SUCCESS;
+}
+
+#define MEAS_PREPROC_STR "Pre-processing of the measurement reports\n"
+
+DEFUN(cfg_bts_meas_preproc_mode,
+	cfg_bts_meas_preproc_mode_cmd,
+	"meas-preproc mode (bsc|always|never)",
+	MEAS_PREPROC_STR
+	"When to pre-process the measurement reports\n"
+	"When requested by the BSC with PRE-PROCESSING CONFIGURE\n"
+	"On all dedicated channels\n"
+	"Never, send every measurement report to the BSC\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->meas_preproc.mode = get_string_value(meas_preproc_mode_names,
+						   argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_meas_preproc_avg,
+	cfg_bts_meas_preproc_avg_cmd,
+	"meas-preproc averaging <1-32>",
+	MEAS_PREPROC_STR
+	"Weight of the moving average of level and quality\n"
+	"in SACCH periods\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->meas_preproc.avg_periods = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_meas_preproc_change,
+	cfg_bts_meas_preproc_change_cmd,
+	"meas-preproc change rxlev <1-63> rxqual <1-7>",
+	MEAS_PREPROC_STR
+	"Change of an average since the last report that is reported\n"
+	"Change of RXLEV\nin dB\n"
+	"Change of RXQUAL\nin steps of RXQUAL\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->meas_preproc.rxlev_delta = atoi(argv[0]);
+	btsb->meas_preproc.rxqual_delta = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_meas_preproc_trigger,
+	cfg_bts_meas_preproc_trigger_cmd,
+	"meas-preproc trigger rxlev <0-63> rxqual <0-7>",
+	MEAS_PREPROC_STR
+	"Report every period while the link is poor\n"
+	"RXLEV below which the link is poor\nRXLEV\n"
+	"RXQUAL above which the link is poor\nRXQUAL\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->meas_preproc.trig_rxlev = atoi(argv[0]);
+	btsb->meas_preproc.trig_rxqual = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_meas_preproc_interval,
+	cfg_bts_meas_preproc_interval_cmd,
+	"meas-preproc interval <1-255>",
+	MEAS_PREPROC_STR
+	"Longest time without a report\nin SACCH periods\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->meas_preproc.interval = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+#define BS_PWR_CTRL_STR "Downlink power control of dedicated channels\n"
+
+DEFUN(cfg_bts_bs_pwr_ctrl_mode,
+	cfg_bts_bs_pwr_ctrl_mode_cmd,
+	"bs-power-control (off|on)",
+	BS_PWR_CTRL_STR
+	"Always use the BS Power set by the BSC\n"
+	"Reduce the power below the BS Power set by the BSC, a TRX "
+	"with one transmit power uses the highest any of its lchans "
+	"needs\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->bs_power_ctrl.mode = get_string_value(bs_pwr_ctrl_mode_names,
+						    argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_bs_pwr_ctrl_target,
+	cfg_bts_bs_pwr_ctrl_target_cmd,
+	"bs-power-control target-rxlev <0-63> hysteresis <0-30>",
+	BS_PWR_CTRL_STR
+	"Downlink RXLEV the MS should measure\nRXLEV\n"
+	"Deviation from the target that is tolerated\nin dB\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->bs_power_ctrl.target = atoi(argv[0]);
+	btsb->bs_power_ctrl.hyst = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_bs_pwr_ctrl_step,
+	cfg_bts_bs_pwr_ctrl_step_cmd,
+	"bs-power-control step raise <2-10> lower <2-10>",
+	BS_PWR_CTRL_STR
+	"Largest change of the power per measurement report\n"
+	"Step to raise the power\nin dB, rounded up to 2 dB\n"
+	"Step to lower the power\nin dB, rounded up to 2 dB\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->bs_power_ctrl.raise_db = atoi(argv[0]);
+	btsb->bs_power_ctrl.lower_db = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_bs_pwr_ctrl_max_red,
+	cfg_bts_bs_pwr_ctrl_max_red_cmd,
+	"bs-power-control max-reduction <0-30>",
+	BS_PWR_CTRL_STR
+	"Largest reduction below the BS Power set by the BSC\nin dB\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->bs_power_ctrl.max_red_db = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_bs_pwr_ctrl_rxqual,
+	cfg_bts_bs_pwr_ctrl_rxqual_cmd,
+	"bs-power-control rxqual-max <0-7>",
+	BS_PWR_CTRL_STR
+	"Raise the power if the downlink RXQUAL is worse\nRXQUAL\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->bs_power_ctrl.rxqual_max = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+#define MS_PWR_CTRL_STR "Uplink power control of dedicated channels\n"
+
+DEFUN(cfg_bts_ms_pwr_ctrl_avg,
+	cfg_bts_ms_pwr_ctrl_avg_cmd,
+	"ms-power-control averaging <1-32>",
+	MS_PWR_CTRL_STR
+	"Number of SACCH blocks whose RSSI and BER are averaged\n"
+	"SACCH blocks\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ms_power_ctrl.avg_blocks = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ms_pwr_ctrl_thresh,
+	cfg_bts_ms_pwr_ctrl_thresh_cmd,
+	"ms-power-control threshold raise <0-30> lower <0-30>",
+	MS_PWR_CTRL_STR
+	"Deviation from the uplink power target that is tolerated\n"
+	"Raise the power below the target minus that\nin dB\n"
+	"Lower the power above the target plus that\nin dB\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ms_power_ctrl.raise_thresh = atoi(argv[0]);
+	btsb->ms_power_ctrl.lower_thresh = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ms_pwr_ctrl_step,
+	cfg_bts_ms_pwr_ctrl_step_cmd,
+	"ms-power-control max-step raise <2-30> lower <2-30>",
+	MS_PWR_CTRL_STR
+	"Largest change of the power at once\n"
+	"Largest step up\nin dB\n"
+	"Largest step down\nin dB\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ms_power_ctrl.raise_max_db = atoi(argv[0]);
+	btsb->ms_power_ctrl.lower_max_db = atoi(argv[1]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ms_pwr_ctrl_rxqual,
+	cfg_bts_ms_pwr_ctrl_rxqual_cmd,
+	"ms-power-control rxqual-raise <1-7>",
+	MS_PWR_CTRL_STR
+	"Raise the power at this or a worse uplink RXQUAL\nRXQUAL\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ms_power_ctrl.rxqual_raise = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+#define TA_CTRL_STR "Timing advance control of dedicated channels\n"
+
+DEFUN(cfg_bts_ta_ctrl,
+	cfg_bts_ta_ctrl_cmd,
+	"ta-control (on|off)",
+	TA_CTRL_STR
+	"Follow the timing offset of the MS\n"
+	"Keep the TA set by the BSC\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ta_ctrl.enabled = !strcmp(argv[0], "on");
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ta_ctrl_hyst,
+	cfg_bts_ta_ctrl_hyst_cmd,
+	"ta-control hysteresis <1-16>",
+	TA_CTRL_STR
+	"Average timing offset that changes the TA\n"
+	"in quarter bits\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ta_ctrl.hyst_qb = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ta_ctrl_interval,
+	cfg_bts_ta_ctrl_interval_cmd,
+	"ta-control interval <1-16>",
+	TA_CTRL_STR
+	"Shortest time between two changes of the TA\n"
+	"in SACCH periods\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ta_ctrl.interval = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_ta_ctrl_step,
+	cfg_bts_ta_ctrl_step_cmd,
+	"ta-control max-step <1-8>",
+	TA_CTRL_STR
+	"Largest change of the TA at once\nin bits\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->ta_ctrl.max_step = atoi(argv[0]);
+
+	return CMD_SUCCESS;
+}
+
+#define LOAD_STATS_STR "Statistics of the CCCH and RACH load\n"
+
+DEFUN(cfg_bts_load_stats_statsd,
+	cfg_bts_load_stats_statsd_cmd,
+	"load-stats statsd A.B.C.D <1-65535>",
+	LOAD_STATS_STR
+	"Send the statistics to a statsd daemon\n"
+	"IP address of the daemon\nUDP port of the daemon\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	if (load_stats_statsd_set(bts, argv[0], atoi(argv[1])) < 0) {
+		vty_out(vty, "%% Cannot send to %s:%s%s", argv[0], argv[1],
+			VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_no_load_stats_statsd,
+	cfg_bts_no_load_stats_statsd_cmd,
+	"no load-stats statsd",
+	NO_STR LOAD_STATS_STR
+	"Send the statistics to a statsd daemon\n")
+{
+	struct gsm_bts *bts = vty->index;
+
+	load_stats_statsd_set(bts, NULL, 0);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_bts_load_stats_interval,
+	cfg_bts_load_stats_interval_cmd,
+	"load-stats statsd-interval <1-3600>",
+	LOAD_STATS_STR
+	"Interval between two reports to the statsd daemon\nin seconds\n")
+{
+	struct gsm_bts *bts = vty->index;
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+
+	btsb->load_stats.statsd.interval = atoi(argv[0]);
 
 	return CMD_SUCCESS;
 }
@@ -500,6 +1058,8 @@ static unsigned int llist_length(struct llist_head *list)
 static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 {
 	struct gsm_bts_role_bts *btsb = bts->role;
+	const struct paging_stats *pstats;
+	int i;
 
 	vty_out(vty, "BTS %u is of %s type in band %s, has CI %u LAC %u, "
 		"BSIC %u, TSC %u and %u TRX%s",
@@ -519,14 +1079,101 @@ static void bts_dump_vty(struct vty *vty, struct gsm_bts *bts)
 	vty_out(vty, "  Paging: Queue size %u, occupied %u, lifetime %us%s",
 		paging_get_queue_max(btsb->paging_state), paging_queue_length(btsb->paging_state),
 		paging_get_lifetime(btsb->paging_state), VTY_NEWLINE);
-	vty_out(vty, "  AGCH: Queue limit %u, occupied %d, "
-		"dropped %llu, merged %llu, rejected %llu, "
+	pstats = paging_get_stats(btsb->paging_state);
+	vty_out(vty, "  Paging: added %llu, duplicate %llu, dropped %llu, "
+		"peak occupied %u, pool %u, lookups %llu (%llu compares)%s",
+		(unsigned long long) pstats->added,
+		(unsigned long long) pstats->duplicates,
+		(unsigned long long) pstats->dropped,
+		pstats->max_queue_len, pstats->pool_size,
+		(unsigned long long) pstats->lookups,
+		(unsigned long long) pstats->lookup_cmps, VTY_NEWLINE);
+	vty_out(vty, "  PCH blocks by identities 0/1/2/3/4: "
+		"%llu/%llu/%llu/%llu/%llu, IMM.ASS %llu%s",
+		(unsigned long long) pstats->pch_blocks[0],
+		(unsigned long long) pstats->pch_blocks[1],
+		(unsigned long long) pstats->pch_blocks[2],
+		(unsigned long long) pstats->pch_blocks[3],
+		(unsigned long long) pstats->pch_blocks[4],
+		(unsigned long long) pstats->pch_imm_ass, VTY_NEWLINE);
+	for (i = 0; i < _NUM_PAGING_PRIO; i++)
+		vty_out(vty, "  Paging priority %s: added %llu, dropped %llu, "
+			"preempted %llu, expired %llu, sent %llu%s",
+			get_value_string(paging_prio_names, i),
+			(unsigned long long) pstats->prio[i].added,
+			(unsigned long long) pstats->prio[i].dropped,
+			(unsigned long long) pstats->prio[i].preempted,
+			(unsigned long long) pstats->prio[i].expired,
+			(unsigned long long) pstats->prio[i].sent, VTY_NEWLINE);
+	vty_out(vty, "  AGCH: Queue limit %u (hard %d), occupied %d, "
+		"dropped %llu, merged %llu, packed %llu, rejected %llu, "
 		"ag-res %llu, non-res %llu%s",
-		btsb->agch_max_queue_length, btsb->agch_queue_length,
+		btsb->agch_max_queue_length, btsb->agch_queue_hard_limit,
+		btsb->agch_queue_length,
 		btsb->agch_queue_dropped_msgs, btsb->agch_queue_merged_msgs,
+		btsb->agch_queue_packed_msgs,
 		btsb->agch_queue_rejected_msgs, btsb->agch_queue_agch_msgs,
 		btsb->agch_queue_pch_msgs,
 		VTY_NEWLINE);
+	vty_out(vty, "  CCCH blocks: paging %llu, AGCH %llu, idle %llu, "
+		"paging deferred %llu%s",
+		(unsigned long long) btsb->ccch_sched.paging_blocks,
+		(unsigned long long) (btsb->agch_queue_agch_msgs +
+				      btsb->agch_queue_pch_msgs),
+		(unsigned long long) btsb->ccch_sched.idle_blocks,
+		(unsigned long long) btsb->ccch_sched.paging_deferred,
+		VTY_NEWLINE);
+	vty_out(vty, "  RACH overload: level %d, CHAN RQD %llu "
+		"(emergency %llu), dropped %llu, overloads %llu, "
+		"BSC response %u ms%s", btsb->rach_ovld.level,
+		(unsigned long long) btsb->rach_ovld.stats.admitted,
+		(unsigned long long) btsb->rach_ovld.stats.emergency,
+		(unsigned long long) btsb->rach_ovld.stats.dropped,
+		(unsigned long long) btsb->rach_ovld.stats.overloads,
+		btsb->rach_ovld.abis_delay_ms, VTY_NEWLINE);
+	vty_out(vty, "  Measurement pre-processing (%s): MEAS RES sent %llu "
+		"(triggered %llu), suppressed %llu%s",
+		get_value_string(meas_preproc_mode_names, btsb->meas_preproc.mode),
+		(unsigned long long) btsb->meas_preproc.stats.sent,
+		(unsigned long long) btsb->meas_preproc.stats.triggered,
+		(unsigned long long) btsb->meas_preproc.stats.suppressed,
+		VTY_NEWLINE);
+	vty_out(vty, "  Downlink power control %s: BS Power changes %llu%s",
+		get_value_string(bs_pwr_ctrl_mode_names, btsb->bs_power_ctrl.mode),
+		(unsigned long long) btsb->bs_power_ctrl.changes, VTY_NEWLINE);
+	vty_out(vty, "  Uplink power control: MS power raised %llu, "
+		"lowered %llu times%s",
+		(unsigned long long) btsb->ms_power_ctrl.raised,
+		(unsigned long long) btsb->ms_power_ctrl.lowered, VTY_NEWLINE);
+	vty_out(vty, "  Timing advance control %s: TA changes %llu%s",
+		btsb->ta_ctrl.enabled ? "on" : "off",
+		(unsigned long long) btsb->ta_ctrl.changes, VTY_NEWLINE);
+	vty_out(vty, "  Load 1s/10s/60s: PCH %u/%u/%u%%, RACH busy %u/%u/%u%%, "
+		"access bursts %u/%u/%u per s%s",
+		load_stats_pch_load(bts, LOAD_STATS_TC_1S) / 10,
+		load_stats_pch_load(bts, LOAD_STATS_TC_10S) / 10,
+		load_stats_pch_load(bts, LOAD_STATS_TC_60S) / 10,
+		load_stats_rach_load(bts, LOAD_STATS_TC_1S) / 10,
+		load_stats_rach_load(bts, LOAD_STATS_TC_10S) / 10,
+		load_stats_rach_load(bts, LOAD_STATS_TC_60S) / 10,
+		load_stats_avg(bts, LOAD_STATS_RACH_ACCESS, LOAD_STATS_TC_1S) / 1000,
+		load_stats_avg(bts, LOAD_STATS_RACH_ACCESS, LOAD_STATS_TC_10S) / 1000,
+		load_stats_avg(bts, LOAD_STATS_RACH_ACCESS, LOAD_STATS_TC_60S) / 1000,
+		VTY_NEWLINE);
+	vty_out(vty, "  AGCH waiting time (ms):");
+	for (i = 0; i < LOAD_STATS_WAIT_BINS; i++) {
+		if (load_stats_wait_bound_ms[i])
+			vty_out(vty, " <%u %llu", load_stats_wait_bound_ms[i],
+				(unsigned long long) btsb->load_stats.agch_wait[i]);
+		else
+			vty_out(vty, " more %llu",
+				(unsigned long long) btsb->load_stats.agch_wait[i]);
+	}
+	vty_out(vty, "%s  Paging groups by used blocks (10%% steps):",
+		VTY_NEWLINE);
+	for (i = 0; i < LOAD_STATS_GROUP_BINS; i++)
+		vty_out(vty, " %u", btsb->load_stats.group_occ[i]);
+	vty_out(vty, "%s", VTY_NEWLINE);
 	vty_out(vty, "  CBCH backlog queue length: %u%s",
 		llist_length(&btsb->smscb_state.queue), VTY_NEWLINE);
 #if 0
@@ -660,6 +1307,35 @@ int bts_vty_init(const struct log_info *cat)
 	install_element(BTS_NODE, &cfg_bts_paging_lifetime_cmd);
 	install_element(BTS_NODE, &cfg_bts_agch_queue_mgmt_default_cmd);
 	install_element(BTS_NODE, &cfg_bts_agch_queue_mgmt_params_cmd);
+	install_element(BTS_NODE, &cfg_bts_agch_queue_mgmt_hard_limit_cmd);
+	install_element(BTS_NODE, &cfg_bts_ccch_scheduler_cmd);
+	install_element(BTS_NODE, &cfg_bts_overload_rach_cmd);
+	install_element(BTS_NODE, &cfg_bts_overload_agch_cmd);
+	install_element(BTS_NODE, &cfg_bts_overload_abis_cmd);
+	install_element(BTS_NODE, &cfg_bts_overload_release_cmd);
+	install_element(BTS_NODE, &cfg_bts_overload_barring_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_overload_barring_cmd);
+	install_element(BTS_NODE, &cfg_bts_meas_preproc_mode_cmd);
+	install_element(BTS_NODE, &cfg_bts_meas_preproc_avg_cmd);
+	install_element(BTS_NODE, &cfg_bts_meas_preproc_change_cmd);
+	install_element(BTS_NODE, &cfg_bts_meas_preproc_trigger_cmd);
+	install_element(BTS_NODE, &cfg_bts_meas_preproc_interval_cmd);
+	install_element(BTS_NODE, &cfg_bts_bs_pwr_ctrl_mode_cmd);
+	install_element(BTS_NODE, &cfg_bts_bs_pwr_ctrl_target_cmd);
+	install_element(BTS_NODE, &cfg_bts_bs_pwr_ctrl_step_cmd);
+	install_element(BTS_NODE, &cfg_bts_bs_pwr_ctrl_max_red_cmd);
+	install_element(BTS_NODE, &cfg_bts_bs_pwr_ctrl_rxqual_cmd);
+	install_element(BTS_NODE, &cfg_bts_ms_pwr_ctrl_avg_cmd);
+	install_element(BTS_NODE, &cfg_bts_ms_pwr_ctrl_thresh_cmd);
+	install_element(BTS_NODE, &cfg_bts_ms_pwr_ctrl_step_cmd);
+	install_element(BTS_NODE, &cfg_bts_ms_pwr_ctrl_rxqual_cmd);
+	install_element(BTS_NODE, &cfg_bts_ta_ctrl_cmd);
+	install_element(BTS_NODE, &cfg_bts_ta_ctrl_hyst_cmd);
+	install_element(BTS_NODE, &cfg_bts_ta_ctrl_interval_cmd);
+	install_element(BTS_NODE, &cfg_bts_ta_ctrl_step_cmd);
+	install_element(BTS_NODE, &cfg_bts_load_stats_statsd_cmd);
+	install_element(BTS_NODE, &cfg_bts_no_load_stats_statsd_cmd);
+	install_element(BTS_NODE, &cfg_bts_load_stats_interval_cmd);
 
 	/* add and link to TRX config node */
 	install_element(BTS_NODE, &cfg_bts_trx_cmd);
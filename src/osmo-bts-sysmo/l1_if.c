@@ -463,12 +463,19 @@ static int handle_ph_readytosend_ind(struct femtol1_hdl *fl1,
 		}
 		/* get a msgb from the dl_tx_queue */
 		resp_msg = msgb_dequeue(&lchan->dl_tch_queue);
+		voice_stats_dl_block(lchan_voice_stats(lchan), !resp_msg);
 		/* if there is none, try to generate empty TCH frame
-		 * like AMR SID_BAD */
+		 * like AMR SID_BAD.  With DTXd we only send the
+		 * mandated SID frames and leave all other blocks
+		 * empty */
 		if (!resp_msg) {
 			LOGP(DL1C, LOGL_DEBUG, "%s DL TCH Tx queue underrun\n",
 				gsm_lchan_name(lchan));
-			resp_msg = gen_empty_tch_msg(lchan);
+			if (fl1->dtx_dl)
+				resp_msg = gen_dtx_tch_msg(lchan,
+							   rts_ind->u32Fn);
+			else
+				resp_msg = gen_empty_tch_msg(lchan);
 			/* if there really is none, break here and send empty */
 			if (!resp_msg)
 				break;
@@ -561,7 +568,8 @@ static int handle_ph_readytosend_ind(struct femtol1_hdl *fl1,
 		break;
 	case GsmL1_Sapi_Agch:
 	case GsmL1_Sapi_Pch:
-		rc = bts_ccch_copy_msg(bts, msu_param->u8Buffer, &g_time,
+		rc = bts_ccch_copy_msg(bts, rts_ind->u8Tn,
+				       msu_param->u8Buffer, &g_time,
 				       rts_ind->sapi == GsmL1_Sapi_Agch);
 		if (rc <= 0)
 			memcpy(msu_param->u8Buffer, fill_frame, GSM_MACBLOCK_LEN);
@@ -646,7 +654,10 @@ static int handle_mph_time_ind(struct femtol1_hdl *fl1,
 		else
 			num_rach_per_frame = 51;
 
-		btsb->load.rach.total += frames_expired * num_rach_per_frame;
+		/* there is a RACH on every CCCH timeslot, the secondary
+		 * ones are activated by opstart_compl() just like TS0 */
+		btsb->load.rach.total += frames_expired * num_rach_per_frame *
+					 bts_num_ccch(bts);
 	}
 
 	return 0;
@@ -751,8 +762,14 @@ static int handle_ph_data_ind(struct femtol1_hdl *fl1, GsmL1_PhDataInd_t *data_i
 	process_meas_res(lchan, &data_ind->measParam);
 
 	if (data_ind->measParam.fLinkQuality < fl1->min_qual_norm
-	 && data_ind->msgUnitParam.u8Size != 0)
+	 && data_ind->msgUnitParam.u8Size != 0) {
+		/* the TCH code needs to know about the bad frame to keep
+		 * the RTP clock running and to flag it */
+		if (data_ind->sapi == GsmL1_Sapi_TchF
+		 || data_ind->sapi == GsmL1_Sapi_TchH)
+			return l1if_tch_rx(lchan, l1p_msg, 1);
 		return 0;
+	}
 
 	DEBUGP(DL1C, "Rx PH-DATA.ind %s (hL2 %08x): %s",
 		get_value_string(femtobts_l1sapi_names, data_ind->sapi),
@@ -781,7 +798,8 @@ static int handle_ph_data_ind(struct femtol1_hdl *fl1, GsmL1_PhDataInd_t *data_i
 		 */
 		l1if_ms_pwr_ctrl(lchan, fl1->ul_power_target,
 				data_ind->msgUnitParam.u8Buffer[0] & 0x1f,
-				data_ind->measParam.fRssi);
+				data_ind->measParam.fRssi,
+				data_ind->measParam.fBer);
 
 		/* Some brilliant engineer decided that the ordering of
 		 * fields on the Um interface is different from the
@@ -827,7 +845,7 @@ static int handle_ph_data_ind(struct femtol1_hdl *fl1, GsmL1_PhDataInd_t *data_i
 	case GsmL1_Sapi_TchF:
 	case GsmL1_Sapi_TchH:
 		/* TCH speech frame handling */
-		rc = l1if_tch_rx(lchan, l1p_msg);
+		rc = l1if_tch_rx(lchan, l1p_msg, 0);
 		break;
 	case GsmL1_Sapi_Pdtch:
 	case GsmL1_Sapi_Pacch:
@@ -942,6 +960,11 @@ static int handle_ph_ra_ind(struct femtol1_hdl *fl1, GsmL1_PhRaInd_t *ra_ind)
 			ra_ind->msgUnitParam.u8Buffer[0], ra_ind->u32Fn);
 	}
 
+	/* rate limit the CHAN RQD towards the BSC */
+	if (!rach_overload_admit(bts, ra_ind->msgUnitParam.u8Buffer[0],
+				 ra_ind->u32Fn))
+		return 0;
+
 	osmo_prim_init(&pp.oph, SAP_GSM_PH, PRIM_PH_RACH,
 			PRIM_OP_INDICATION, NULL);
 
@@ -1698,67 +1721,18 @@ int l1if_rf_clock_info_correct(struct femtol1_hdl *fl1h)
 #endif
 
 /*
- * Check if manual power control is needed
- * Check if fixed power was selected
- * Check if the MS is already using our level if not
- * the value is bogus..
+ * Check if manual power control is needed, the loop itself is
+ * ms_power_ctrl_meas().
  * TODO: Add a timeout.. e.g. if the ms is not capable of reaching
  * the value we have set.
  */
 inline int l1if_ms_pwr_ctrl(struct gsm_lchan *lchan, const int ul_power_target,
-			const uint8_t ms_power, const float rxLevel)
+			const uint8_t ms_power, const float rxLevel,
+			const float ber)
 {
-	float rx;
-	int cur_dBm, new_dBm, new_pwr;
-	const enum gsm_band band = lchan->ts->trx->bts->band;
-
 	if (!trx_ms_pwr_ctrl_is_osmo(lchan->ts->trx))
 		return 0;
-	if (lchan->ms_power_ctrl.fixed)
-		return 0;
 
-	/* The phone hasn't reached the power level yet */
-	if (lchan->ms_power_ctrl.current != ms_power)
-		return 0;
-
-	/*
-	 * What is the difference between what we want and received?
-	 * Ignore a margin that is within the range of measurement
-	 * and MS output issues.
-	 */
-	rx = ul_power_target - rxLevel;
-	if (rx >= 0 && rx < 1.5f)
-		return 0;
-	if (rx < 0 && rx > -1.5f)
-		return 0;
-
-	/* We don't really care about the truncation of int + float */
-	cur_dBm = ms_pwr_dbm(band, ms_power);
-	new_dBm = cur_dBm + rx;
-
-	/* Clamp negative values and do it depending on the band */
-	if (new_dBm < 0)
-		new_dBm = 0;
-
-	switch (band) {
-	case GSM_BAND_1800:
-		/* If MS_TX_PWR_MAX_CCH is set the values 29,
-		 * 30, 31 are not used. Avoid specifying a dBm
-		 * that would lead to these power levels. The
-		 * phone might not be able to reach them. */
-		if (new_dBm > 30)
-			new_dBm = 30;
-		break;
-	default:
-		break;
-	}
-
-	new_pwr = ms_pwr_ctl_lvl(band, new_dBm);
-	if (lchan->ms_power_ctrl.current != new_pwr) {
-		lchan->ms_power_ctrl.current = new_pwr;
-		bts_model_adjst_ms_pwr(lchan);
-		return 1;
-	}
-
-	return 0;
+	return ms_power_ctrl_meas(lchan, ul_power_target, ms_power,
+				  (int) rxLevel, (unsigned int) (ber * 100));
 }
@@ -7,6 +7,8 @@
 #include <osmocom/core/timer.h>
 #include <osmocom/gsm/gsm_utils.h>
 
+#include <osmo-bts/amr.h>
+
 #include <sysmocom/femtobts/gsml1prim.h>
 
 enum {
@@ -40,6 +42,26 @@ enum {
 	FIXUP_NOT_NEEDED,
 };
 
+/* per-lchan state of the TCH glue in tch.c */
+struct femtol1_tch_state {
+	/* uplink DTX */
+	int ul_marker;			/* next UL RTP frame starts a talk spurt */
+	unsigned int ul_sid;		/* SID frames passed on to RTP */
+	unsigned int ul_no_data;	/* frames suppressed during silence */
+	unsigned int ul_bfi;		/* bad frames */
+
+	/* downlink DTX */
+	int dl_dtx_active;		/* in a downlink silence period */
+	unsigned int dl_sid_age;	/* TCH blocks since the last SID */
+	unsigned int dl_sid_tx;		/* SID frames sent during silence */
+	unsigned int dl_dtx_blocks;	/* TCH blocks not transmitted */
+	uint8_t dl_sid_len;
+	uint8_t dl_sid[40];		/* last FR/HR SID frame, L1 format */
+
+	/* AMR uplink codec mode adaptation */
+	struct amr_link_adapt amr_la;
+};
+
 struct femtol1_hdl {
 	struct gsm_time gsm_time;
 	uint32_t hLayer1;			/* handle to the L1 instance in the DSP */
@@ -50,6 +72,7 @@ struct femtol1_hdl {
 	uint8_t clk_src;
 	float min_qual_rach;
 	float min_qual_norm;
+	int dtx_dl;			/* downlink DTX enabled */
 	char *calib_path;
 	struct llist_head wlc_list;
 
@@ -82,6 +105,9 @@ struct femtol1_hdl {
 	struct calib_send_state st;
 
 	uint8_t last_rf_mute[8];
+
+	/* indexed by timeslot and lchan number */
+	struct femtol1_tch_state tch_state[8][8];
 };
 
 #define msgb_l1prim(msg)	((GsmL1_Prim_t *)(msg)->l1h)
@@ -110,9 +136,12 @@ uint32_t l1if_lchan_to_hLayer(struct gsm_lchan *lchan);
 struct gsm_lchan *l1if_hLayer_to_lchan(struct gsm_bts_trx *trx, uint32_t hLayer);
 
 /* tch.c */
-int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg);
+int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg, int bfi);
+void l1if_tch_reset(struct gsm_lchan *lchan);
+void l1if_tch_mode_modify(struct gsm_lchan *lchan);
 int l1if_tch_fill(struct gsm_lchan *lchan, uint8_t *l1_buffer);
 struct msgb *gen_empty_tch_msg(struct gsm_lchan *lchan);
+struct msgb *gen_dtx_tch_msg(struct gsm_lchan *lchan, uint32_t fn);
 
 /* ciphering */
 int l1if_set_ciphering(struct femtol1_hdl *fl1h,
@@ -133,5 +162,6 @@ void bts_check_for_first_ciphrd(struct femtol1_hdl *fl1h,
 				GsmL1_MsgUnitParam_t *msgUnitParam,
 				struct gsm_lchan *lchan);
 inline int l1if_ms_pwr_ctrl(struct gsm_lchan *lchan, const int uplink_target,
-			const uint8_t ms_power, const float rxLevel);
+			const uint8_t ms_power, const float rxLevel,
+			const float ber);
 #endif /* _FEMTO_L1_H */
@@ -219,6 +219,19 @@ static int opstart_compl(struct gsm_abis_mo *mo, struct msgb *l1_msg)
 		}
 	}
 
+	/* same for the secondary CCCH on TS 2, 4 and 6 of the BCCH carrier */
+	if (mo->obj_class == NM_OC_CHANNEL && mo->obj_inst.trx_nr == 0 &&
+	    mo->obj_inst.ts_nr != 0 &&
+	    bts_ccch_index(mo->obj_inst.ts_nr) >= 0 &&
+	    mo->bts->c0->ts[mo->obj_inst.ts_nr].pchan == GSM_PCHAN_CCCH) {
+		struct gsm_lchan *lchan =
+			&mo->bts->c0->ts[mo->obj_inst.ts_nr].lchan[4];
+		DEBUGP(DL1C, "====> trying to activate lchans of CCCH on TS%u\n",
+			mo->obj_inst.ts_nr);
+		lchan->rel_act_kind = LCHAN_REL_ACT_OML;
+		lchan_activate(lchan);
+	}
+
 	/* Send OPSTART ack */
 	return oml_mo_opstart_ack(mo);
 }
@@ -472,6 +485,14 @@ static const struct sapi_dir ccch_sapis[] = {
 	{ GsmL1_Sapi_Rach,	GsmL1_Dir_RxUplink },
 };
 
+/* FCCH and SCH only exist on TS0, see TS 05.02 Clause 6.4 */
+static const struct sapi_dir sccch_sapis[] = {
+	{ GsmL1_Sapi_Bcch,	GsmL1_Dir_TxDownlink },
+	{ GsmL1_Sapi_Agch,	GsmL1_Dir_TxDownlink },
+	{ GsmL1_Sapi_Pch,	GsmL1_Dir_TxDownlink },
+	{ GsmL1_Sapi_Rach,	GsmL1_Dir_RxUplink },
+};
+
 static const struct sapi_dir tchf_sapis[] = {
 	{ GsmL1_Sapi_TchF,	GsmL1_Dir_TxDownlink },
 	{ GsmL1_Sapi_TchF,	GsmL1_Dir_RxUplink },
@@ -550,6 +571,11 @@ static const struct lchan_sapis sapis_for_lchan[_GSM_LCHAN_MAX] = {
 	},
 };
 
+static const struct lchan_sapis sapis_for_sccch = {
+	.sapis = sccch_sapis,
+	.num_sapis = ARRAY_SIZE(sccch_sapis),
+};
+
 static const struct lchan_sapis sapis_for_ho = {
 	.sapis = ho_sapis,
 	.num_sapis = ARRAY_SIZE(ho_sapis),
@@ -1021,6 +1047,10 @@ int lchan_activate(struct gsm_lchan *lchan)
 			"%s Trying to activate lchan, but commands in queue\n",
 			gsm_lchan_name(lchan));
 
+	/* a secondary CCCH has no FCCH/SCH of its own */
+	if (lchan->type == GSM_LCHAN_CCCH && lchan->ts->nr != 0)
+		s4l = &sapis_for_sccch;
+
 	/* override the regular SAPIs if this is the first hand-over
 	 * related activation of the LCHAN */
 	if (lchan->ho.active == HANDOVER_ENABLED)
@@ -1042,6 +1072,7 @@ int lchan_activate(struct gsm_lchan *lchan)
 
 #warning "FIXME: Should this be in sapi_activate_cb?"
 	lchan_init_lapdm(lchan);
+	l1if_tch_reset(lchan);
 
 	lchan->s = btsb->radio_link_timeout;
 
@@ -1319,6 +1350,30 @@ int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan)
 	return 0;
 }
 
+/* The L1 has only one transmit power for the whole TRX, so use the
+ * highest one any active lchan of the TRX asks for.  The BCCH carrier
+ * always stays at full power. */
+int bts_model_adjst_bs_pwr(struct gsm_lchan *lchan)
+{
+	struct gsm_bts_trx *trx = lchan->ts->trx;
+	struct trx_power_params *tpp = &trx->power_params;
+	int bs_power;
+	int p_tgt_mdBm;
+
+	if (trx == trx->bts->c0)
+		return -EINVAL;
+
+	bs_power = bs_power_ctrl_trx_power(trx);
+	if (bs_power < 0)
+		return 0;
+
+	p_tgt_mdBm = get_p_target_mdBm(trx, bs_power);
+	if (p_tgt_mdBm == tpp->p_total_tgt_mdBm)
+		return 0;
+
+	return power_ctrl_change(trx, p_tgt_mdBm);
+}
+
 int bts_model_rsl_mode_modify(struct gsm_lchan *lchan)
 {
 	if (lchan->state != LCHAN_S_ACTIVE)
@@ -1327,6 +1382,7 @@ int bts_model_rsl_mode_modify(struct gsm_lchan *lchan)
 	/* channel mode, encryption and/or multirate have changed */
 
 	/* update multi-rate config */
+	l1if_tch_mode_modify(lchan);
 	tx_confreq_logchpar(lchan, GsmL1_Dir_RxUplink);
 	tx_confreq_logchpar(lchan, GsmL1_Dir_TxDownlink);
 
@@ -242,6 +242,30 @@ DEFUN(cfg_trx_min_qual_norm, cfg_trx_min_qual_norm_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(cfg_trx_dtx_dl, cfg_trx_dtx_dl_cmd,
+	"dtx-downlink",
+	"Use discontinuous transmission on the downlink of TCH\n")
+{
+	struct gsm_bts_trx *trx = vty->index;
+	struct femtol1_hdl *fl1h = trx_femtol1_hdl(trx);
+
+	fl1h->dtx_dl = 1;
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(cfg_trx_no_dtx_dl, cfg_trx_no_dtx_dl_cmd,
+	"no dtx-downlink",
+	NO_STR "Use discontinuous transmission on the downlink of TCH\n")
+{
+	struct gsm_bts_trx *trx = vty->index;
+	struct femtol1_hdl *fl1h = trx_femtol1_hdl(trx);
+
+	fl1h->dtx_dl = 0;
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(cfg_trx_nominal_power, cfg_trx_nominal_power_cmd,
 	"nominal-tx-power <0-100>",
 	"Set the nominal transmit output power in dBm\n"
@@ -386,6 +410,89 @@ DEFUN(show_sys_info, show_sys_info_cmd,
 	return CMD_SUCCESS;
 }
 
+DEFUN(show_amr_la, show_amr_la_cmd,
+	"show trx <0-0> <0-7> amr-link-adaptation <0-1>",
+	SHOW_TRX_STR
+	"Timeslot number\n"
+	"Display AMR link adaptation state\n"
+	"Logical Channel Number\n")
+{
+	int trx_nr = atoi(argv[0]);
+	int ts_nr = atoi(argv[1]);
+	int lchan_nr = atoi(argv[2]);
+	struct gsm_bts_trx *trx = gsm_bts_trx_num(vty_bts, trx_nr);
+	struct gsm_lchan *lchan;
+	struct amr_link_adapt *la;
+	uint32_t total = 0;
+	int i;
+
+	if (!trx) {
+		vty_out(vty, "Cannot find TRX number %u%s",
+			trx_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	lchan = &trx->ts[ts_nr].lchan[lchan_nr];
+	la = &trx_femtol1_hdl(trx)->tch_state[ts_nr][lchan_nr].amr_la;
+
+	if (lchan->tch_mode != GSM48_CMODE_SPEECH_AMR) {
+		vty_out(vty, "%% %s is not using AMR%s",
+			gsm_lchan_name(lchan), VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+
+	vty_out(vty, "%s: UL C/I %d.%d dB, BER %u.%02u%%, "
+		"codec mode changes %u%s", gsm_lchan_name(lchan),
+		la->ci_avg_cB / 10, abs(la->ci_avg_cB % 10),
+		la->ber_avg10k / 100, la->ber_avg10k % 100,
+		la->num_changes, VTY_NEWLINE);
+	vty_out(vty, "%s: DL mode requested by the MS (CMR) %u, "
+		"passed on to RTP%s", gsm_lchan_name(lchan),
+		lchan->tch.last_cmr, VTY_NEWLINE);
+
+	for (i = 0; i < lchan->tch.amr_mr.num_modes; i++)
+		total += la->residency[i];
+	for (i = 0; i < lchan->tch.amr_mr.num_modes; i++)
+		vty_out(vty, " %c mode[%u] (AMR mode %u): %u frames (%u%%)%s",
+			i == la->mode_idx ? '*' : ' ', i,
+			lchan->tch.amr_mr.mode[i].mode, la->residency[i],
+			total ? la->residency[i] * 100 / total : 0,
+			VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
+DEFUN(show_dtx, show_dtx_cmd,
+	"show trx <0-0> <0-7> dtx <0-1>",
+	SHOW_TRX_STR
+	"Timeslot number\n"
+	"Display DTX statistics\n"
+	"Logical Channel Number\n")
+{
+	int trx_nr = atoi(argv[0]);
+	int ts_nr = atoi(argv[1]);
+	int lchan_nr = atoi(argv[2]);
+	struct gsm_bts_trx *trx = gsm_bts_trx_num(vty_bts, trx_nr);
+	struct gsm_lchan *lchan;
+	struct femtol1_tch_state *st;
+
+	if (!trx) {
+		vty_out(vty, "Cannot find TRX number %u%s",
+			trx_nr, VTY_NEWLINE);
+		return CMD_WARNING;
+	}
+	lchan = &trx->ts[ts_nr].lchan[lchan_nr];
+	st = &trx_femtol1_hdl(trx)->tch_state[ts_nr][lchan_nr];
+
+	vty_out(vty, "%s: UL SID frames %u, suppressed frames %u, "
+		"bad frames %u%s", gsm_lchan_name(lchan), st->ul_sid,
+		st->ul_no_data, st->ul_bfi, VTY_NEWLINE);
+	vty_out(vty, "%s: DL DTX %s, SID frames %u, blocks not sent %u%s",
+		gsm_lchan_name(lchan), st->dl_dtx_active ? "active" : "idle",
+		st->dl_sid_tx, st->dl_dtx_blocks, VTY_NEWLINE);
+
+	return CMD_SUCCESS;
+}
+
 DEFUN(activate_lchan, activate_lchan_cmd,
 	"trx <0-0> <0-7> (activate|deactivate) <0-7>",
 	TRX_STR
@@ -546,6 +653,8 @@ void bts_model_config_write_trx(struct vty *vty, struct gsm_bts_trx *trx)
 		VTY_NEWLINE);
 	vty_out(vty, "  min-qual-norm %.0f%s", fl1h->min_qual_norm * 10.0f,
 		VTY_NEWLINE);
+	if (fl1h->dtx_dl)
+		vty_out(vty, "  dtx-downlink%s", VTY_NEWLINE);
 	if (trx->nominal_power != sysmobts_get_nominal_power(trx))
 		vty_out(vty, "  nominal-tx-power %d%s", trx->nominal_power,
 			VTY_NEWLINE);
@@ -595,6 +704,8 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	install_element_ve(&show_dsp_trace_f_cmd);
 	install_element_ve(&show_sys_info_cmd);
 	install_element_ve(&show_trx_clksrc_cmd);
+	install_element_ve(&show_amr_la_cmd);
+	install_element_ve(&show_dtx_cmd);
 	install_element_ve(&dsp_trace_f_cmd);
 	install_element_ve(&no_dsp_trace_f_cmd);
 
@@ -620,6 +731,8 @@ int bts_model_vty_init(struct gsm_bts *bts)
 	install_element(TRX_NODE, &cfg_trx_min_qual_rach_cmd);
 	install_element(TRX_NODE, &cfg_trx_min_qual_norm_cmd);
 	install_element(TRX_NODE, &cfg_trx_nominal_power_cmd);
+	install_element(TRX_NODE, &cfg_trx_dtx_dl_cmd);
+	install_element(TRX_NODE, &cfg_trx_no_dtx_dl_cmd);
 
 	return 0;
 }
@@ -48,53 +48,67 @@
 
 #include "femtobts.h"
 #include "l1_if.h"
+#include "tch_conv.h"
 
-/* input octet-aligned, output not octet-aligned */
-void osmo_nibble_shift_right(uint8_t *out, const uint8_t *in,
-			     unsigned int num_nibbles)
-{
-	unsigned int i;
-	unsigned int num_whole_bytes = num_nibbles / 2;
-
-	/* first byte: upper nibble empty, lower nibble from src */
-	out[0] = (in[0] >> 4);
+#define GSM_FR_BITS	260
+#define GSM_EFR_BITS	244
 
-	/* bytes 1.. */
-	for (i = 1; i < num_whole_bytes; i++)
-		out[i] = ((in[i-1] & 0xF) << 4) | (in[i] >> 4);
+#define GSM_FR_BYTES	33	/* TS 101318 Chapter 5.1: 260 bits + 4bit sig */
+#define GSM_HR_BYTES	14	/* TS 101318 Chapter 5.2: 112 bits, no sig */
+#define GSM_EFR_BYTES	31	/* TS 101318 Chapter 5.3: 244 bits + 4bit sig */
 
-	/* shift the last nibble, in case there's an odd count */
-	i = num_whole_bytes;
-	if (num_nibbles & 1)
-		out[i] = ((in[i-1] & 0xF) << 4) | (in[i] >> 4);
-	else
-		out[i] = (in[i-1] & 0xF) << 4;
-}
+#define GSM_RTP_DURATION	160	/* 20ms at 8kHz */
 
+enum amr_frame_type {
+	AMR_FT_SID_AMR	= 8,
+	AMR_FT_NO_DATA	= 15,
+};
 
-/* input unaligned, output octet-aligned */
-void osmo_nibble_shift_left_unal(uint8_t *out, const uint8_t *in,
-				unsigned int num_nibbles)
+static struct femtol1_tch_state *lchan_tch_state(struct gsm_lchan *lchan)
 {
-	unsigned int i;
-	unsigned int num_whole_bytes = num_nibbles / 2;
+	struct femtol1_hdl *fl1h = trx_femtol1_hdl(lchan->ts->trx);
 
-	for (i = 0; i < num_whole_bytes; i++)
-		out[i] = ((in[i] & 0xF) << 4) | (in[i+1] >> 4);
-
-	/* shift the last nibble, in case there's an odd count */
-	i = num_whole_bytes;
-	if (num_nibbles & 1)
-		out[i] = (in[i] & 0xF) << 4;
+	return &fl1h->tch_state[lchan->ts->nr][lchan->nr];
 }
 
+static int rtp_bit(const uint8_t *rtp_pl, unsigned int pos)
+{
+	return (rtp_pl[pos / 8] >> (7 - pos % 8)) & 1;
+}
 
-#define GSM_FR_BITS	260
-#define GSM_EFR_BITS	244
+/*! \brief check the SID code word of a FR or HR frame in RTP format
+ *
+ * HR (GSM 06.41): the 79 bits after R0 and the LPC are all 1.
+ * FR (GSM 06.12): the code word is made of RPE pulse bits that are all
+ * 0, the MSB of each of the 52 pulses is checked.  A speech frame with
+ * all pulses in the lower half of their range does not happen.
+ */
+static int rtp_is_sid(struct gsm_lchan *lchan, const uint8_t *rtp_pl,
+		      unsigned int rtp_pl_len)
+{
+	unsigned int i, j, pos;
+
+	if (lchan->type == GSM_LCHAN_TCH_F) {
+		if (rtp_pl_len < GSM_FR_BYTES || (rtp_pl[0] >> 4) != 0xd)
+			return 0;
+		/* signature and LARc, then 4 sub-frames of 56 bits:
+		 * Nc, bc, Mc, xmaxc (17 bits) and 13 pulses of 3 bits */
+		for (i = 0; i < 4; i++) {
+			pos = 4 + 36 + i * 56 + 17;
+			for (j = 0; j < 13; j++, pos += 3)
+				if (rtp_bit(rtp_pl, pos))
+					return 0;
+		}
+		return 1;
+	}
 
-#define GSM_FR_BYTES	33	/* TS 101318 Chapter 5.1: 260 bits + 4bit sig */
-#define GSM_HR_BYTES	14	/* TS 101318 Chapter 5.2: 112 bits, no sig */
-#define GSM_EFR_BYTES	31	/* TS 101318 Chapter 5.3: 244 bits + 4bit sig */
+	if (rtp_pl_len < GSM_HR_BYTES)
+		return 0;
+	for (i = 33; i < GSM_HR_BYTES * 8; i++)
+		if (!rtp_bit(rtp_pl, i))
+			return 0;
+	return 1;
+}
 
 static struct msgb *l1_to_rtppayload_fr(uint8_t *l1_payload, uint8_t payload_len)
 {
@@ -110,13 +124,11 @@ static struct msgb *l1_to_rtppayload_fr(uint8_t *l1_payload, uint8_t payload_len
 	cur = msgb_put(msg, GSM_FR_BYTES);
 	memcpy(cur, l1_payload, GSM_FR_BYTES);
 #else
-	/* step1: reverse the bit-order of each payload byte */
-	osmo_revbytebits_buf(l1_payload, payload_len);
-
 	cur = msgb_put(msg, GSM_FR_BYTES);
 
-	/* step2: we need to shift the entire L1 payload by 4 bits right */
-	osmo_nibble_shift_right(cur, l1_payload, GSM_FR_BITS/4);
+	/* reverse the bit-order of each payload byte and shift the
+	 * entire L1 payload by 4 bits right in a single pass */
+	tch_revbits_shift_right(cur, l1_payload, GSM_FR_BITS/4);
 
 	cur[0] |= 0xD0;
 #endif /* USE_L1_RTP_MODE */
@@ -137,11 +149,9 @@ static int rtppayload_to_l1_fr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 	/* new L1 can deliver bits like we need them */
 	memcpy(l1_payload, rtp_payload, GSM_FR_BYTES);
 #else
-	/* step2: we need to shift the RTP payload left by one nibble*/
-	osmo_nibble_shift_left_unal(l1_payload, rtp_payload, GSM_FR_BITS/4);
-
-	/* step1: reverse the bit-order of each payload byte */
-	osmo_revbytebits_buf(l1_payload, payload_len);
+	/* shift the RTP payload left by one nibble and reverse the
+	 * bit-order of each payload byte in a single pass */
+	tch_shift_left_revbits(l1_payload, rtp_payload, GSM_FR_BITS/4);
 #endif /* USE_L1_RTP_MODE */
 	return GSM_FR_BYTES;
 }
@@ -161,13 +171,11 @@ static struct msgb *l1_to_rtppayload_efr(uint8_t *l1_payload, uint8_t payload_le
 	cur = msgb_put(msg, GSM_EFR_BYTES);
 	memcpy(cur, l1_payload, GSM_EFR_BYTES);
 #else
-	/* step1: reverse the bit-order of each payload byte */
-	osmo_revbytebits_buf(l1_payload, payload_len);
-
 	cur = msgb_put(msg, GSM_EFR_BYTES);
 
-	/* step 2: we need to shift the entire L1 payload by 4 bits right */
-	osmo_nibble_shift_right(cur, l1_payload, GSM_EFR_BITS/4);
+	/* reverse the bit-order of each payload byte and shift the
+	 * entire L1 payload by 4 bits right in a single pass */
+	tch_revbits_shift_right(cur, l1_payload, GSM_EFR_BITS/4);
 
 	cur[0] |= 0xC0;
 #endif /* USE_L1_RTP_MODE */
@@ -205,11 +213,11 @@ static struct msgb *l1_to_rtppayload_hr(uint8_t *l1_payload, uint8_t payload_len
 	}
 
 	cur = msgb_put(msg, GSM_HR_BYTES);
+#ifdef USE_L1_RTP_MODE
 	memcpy(cur, l1_payload, GSM_HR_BYTES);
-
-#ifndef USE_L1_RTP_MODE
+#else
 	/* reverse the bit-order of each payload byte */
-	osmo_revbytebits_buf(cur, GSM_HR_BYTES);
+	tch_revbits_copy(cur, l1_payload, GSM_HR_BYTES);
 #endif /* USE_L1_RTP_MODE */
 
 	return msg;
@@ -231,11 +239,11 @@ static int rtppayload_to_l1_hr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 		return 0;
 	}
 
+#ifdef USE_L1_RTP_MODE
 	memcpy(l1_payload, rtp_payload, GSM_HR_BYTES);
-
-#ifndef USE_L1_RTP_MODE
+#else
 	/* reverse the bit-order of each payload byte */
-	osmo_revbytebits_buf(l1_payload, GSM_HR_BYTES);
+	tch_revbits_copy(l1_payload, rtp_payload, GSM_HR_BYTES);
 #endif /* USE_L1_RTP_MODE */
 
 	return GSM_HR_BYTES;
@@ -293,21 +301,15 @@ static struct msgb *l1_to_rtppayload_amr(uint8_t *l1_payload, uint8_t payload_le
 
 	cur = msgb_put(msg, amr_if2_len-1);
 
-	/* step1: reverse the bit-order within every byte */
-	osmo_revbytebits_buf(l1_payload+2, amr_if2_len);
-
-	/* step2: shift everything left by one nibble */
-	osmo_nibble_shift_left_unal(cur, l1_payload+2, amr_if2_len*2 -1);
+	/* reverse the bit-order within every byte and shift everything
+	 * left by one nibble */
+	tch_revbits_shift_left(cur, l1_payload+2, amr_if2_len*2 -1);
 
 #endif /* USE_L1_RTP_MODE */
 
 	return msg;
 }
 
-enum amr_frame_type {
-	AMR_FT_SID_AMR	= 8,
-};
-
 int get_amr_mode_idx(const struct amr_multirate_conf *amr_mrc, uint8_t cmi)
 {
 	unsigned int i;
@@ -329,6 +331,7 @@ static int rtppayload_to_l1_amr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 				struct gsm_lchan *lchan)
 {
 	struct amr_multirate_conf *amr_mrc = &lchan->tch.amr_mr;
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
 	uint8_t ft = (rtp_payload[1] >> 3) & 0xf;
 	uint8_t cmr = rtp_payload[0] >> 4;
 	uint8_t cmi, sti;
@@ -341,11 +344,10 @@ static int rtppayload_to_l1_amr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 #else
 	uint8_t amr_if2_core_len = payload_len - 2;
 
-	/* step1: shift everything right one nibble; make space for FT */
-	osmo_nibble_shift_right(l1_payload+2, rtp_payload+2, amr_if2_core_len*2);
-	/* step2: reverse the bit-order within every byte of the IF2
-	 * core frame contained in the RTP payload */
-	osmo_revbytebits_buf(l1_payload+2, amr_if2_core_len+1);
+	/* shift everything right one nibble to make space for FT, and
+	 * reverse the bit-order within every byte of the IF2 core frame
+	 * contained in the RTP payload */
+	tch_shift_right_revbits(l1_payload+2, rtp_payload+2, amr_if2_core_len*2);
 
 	/* lower 4 bit of first FR2 byte contains FT */
 	l1_payload[2] |= ft;
@@ -381,18 +383,17 @@ static int rtppayload_to_l1_amr(uint8_t *l1_payload, const uint8_t *rtp_payload,
 	} else
 		*l1_cmi_idx = rc;
 
-	/* Codec Mode Request is in upper 4 bits of RTP payload header,
-	 * and we simply copy the CMR into the CMC */
-	if (cmr == 0xF) {
-		/* FIXME: we need some state about the last codec mode */
-		*l1_cmr_idx = 0;
-	} else {
+	/* The Codec Mode Command for the uplink is what our link
+	 * adaptation decided, further limited by the Codec Mode
+	 * Request of the far end in the upper 4 bits of the RTP
+	 * payload header.  The downlink is sent in the mode of the RTP
+	 * frame (cmi above), there is no downlink adaptation here. */
+	*l1_cmr_idx = st->amr_la.mode_idx;
+	if (cmr != AMR_CMR_NONE) {
 		rc = get_amr_mode_idx(amr_mrc, cmr);
-		if (rc < 0) {
-			/* FIXME: we need some state about the last codec mode */
-			LOGP(DRTP, LOGL_INFO, "RTP->L1: overriding CMR %u\n", cmr);
-			*l1_cmr_idx = 0;
-		} else
+		if (rc < 0)
+			LOGP(DRTP, LOGL_INFO, "RTP->L1: ignoring CMR %u\n", cmr);
+		else if (rc < *l1_cmr_idx)
 			*l1_cmr_idx = rc;
 	}
 #if 0
@@ -445,14 +446,27 @@ void bts_model_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 	GsmL1_Prim_t *l1p;
 	GsmL1_PhDataReq_t *data_req;
 	GsmL1_MsgUnitParam_t *msu_param;
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
 	uint8_t *payload_type;
 	uint8_t *l1_payload;
+	uint8_t amr_ft = AMR_FT_NO_DATA;
 	int rc;
 
 	/* skip processing of incoming RTP frames if we are in loopback mode */
 	if (lchan->loopback)
 		return;
 
+	voice_stats_dl_rtp(lchan_voice_stats(lchan));
+
+	if (lchan->tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		if (rtp_pl_len >= 2)
+			amr_ft = (rtp_pl[1] >> 3) & 0xf;
+		/* nothing to transmit; the gap is handled as underrun
+		 * (and DTXd, if enabled) when L1 asks for the block */
+		if (amr_ft == AMR_FT_NO_DATA)
+			return;
+	}
+
 	msg = l1p_msgb_alloc();
 	if (!msg) {
 		LOGP(DRTP, LOGL_ERROR, "%s: Failed to allocate Rx payload.\n",
@@ -505,6 +519,26 @@ void bts_model_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 
 	msu_param->u8Size = rc + 1;
 
+	/* track downlink silence periods for DTXd.  For AMR the SID is
+	 * recognized by its frame type and kept in lchan->tch.last_sid,
+	 * for FR/HR by its code word.  Speech discards the SID of the
+	 * previous silence period.  The EFR code word is not checked,
+	 * no SID is repeated during EFR silence. */
+	if (lchan->tch_mode == GSM48_CMODE_SPEECH_AMR) {
+		if (amr_ft == AMR_FT_SID_AMR)
+			st->dl_sid_age = 0;
+		else
+			st->dl_dtx_active = 0;
+	} else if (lchan->tch_mode == GSM48_CMODE_SPEECH_V1 &&
+		   rtp_is_sid(lchan, rtp_pl, rtp_pl_len)) {
+		st->dl_sid_age = 0;
+		st->dl_sid_len = OSMO_MIN(msu_param->u8Size,
+					  sizeof(st->dl_sid));
+		memcpy(st->dl_sid, msu_param->u8Buffer, st->dl_sid_len);
+	} else {
+		st->dl_dtx_active = 0;
+		st->dl_sid_len = 0;
+	}
 
 	/* make sure the number of entries in the dl_tch_queue is never
 	 * more than 3 */
@@ -529,15 +563,66 @@ void bts_model_rtp_rx_cb(struct osmo_rtp_socket *rs, const uint8_t *rtp_pl,
 	msgb_enqueue(&lchan->dl_tch_queue, msg);
 }
 
-/*! \brief receive a traffic L1 primitive for a given lchan */
-int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg)
+/*! \brief reset the TCH state of a lchan on (re-)activation */
+void l1if_tch_reset(struct gsm_lchan *lchan)
+{
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
+
+	memset(st, 0, sizeof(*st));
+	/* the first frame of the stream starts a talk spurt */
+	st->ul_marker = 1;
+	amr_la_init(&st->amr_la, lchan);
+}
+
+/*! \brief channel mode and/or multirate config of a lchan changed */
+void l1if_tch_mode_modify(struct gsm_lchan *lchan)
+{
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
+
+	amr_la_init(&st->amr_la, lchan);
+}
+
+/* AMR frame type of an uplink frame as delivered by L1 */
+static uint8_t l1_amr_ft(const uint8_t *l1_payload, uint8_t payload_len)
+{
+#ifdef USE_L1_RTP_MODE
+	/* CMI, CMR, then RFC 3267 payload header and TOC */
+	if (payload_len < 4)
+		return AMR_FT_NO_DATA;
+	return (l1_payload[3] >> 3) & 0xf;
+#else
+	/* CMI, CMR, then IF2 with the FT in the lower nibble */
+	if (payload_len < 3)
+		return AMR_FT_NO_DATA;
+	return l1_payload[2] & 0xf;
+#endif
+}
+
+/*! \brief receive a traffic L1 primitive for a given lchan
+ *  \param[in] lchan logical channel the frame was received on
+ *  \param[in] l1p_msg PH-DATA.ind from L1
+ *  \param[in] bfi frame was received with insufficient quality
+ *
+ * Implements uplink DTX towards RTP: frames that carry no speech
+ * (NO_DATA, the silence between SID updates, bad FR/EFR/HR frames) are
+ * not sent, but the RTP timestamp keeps running.  The first frame after
+ * NO_DATA or a SID frame (a SID update or the start of a talk spurt) is
+ * sent with the RTP marker bit set; a bad frame within a talk spurt
+ * does not start a new one.  Bad AMR frames are passed on with the TOC
+ * Q bit cleared.
+ */
+int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg, int bfi)
 {
 	GsmL1_Prim_t *l1p = msgb_l1prim(l1p_msg);
 	GsmL1_PhDataInd_t *data_ind = &l1p->u.phDataInd;
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
+	struct voice_stats *vs = lchan_voice_stats(lchan);
 	uint8_t payload_type = data_ind->msgUnitParam.u8Buffer[0];
 	uint8_t *payload = data_ind->msgUnitParam.u8Buffer + 1;
 	uint8_t payload_len;
 	struct msgb *rmsg = NULL;
+	int sid = 0;
+	uint8_t ft;
 
 	if (data_ind->msgUnitParam.u8Size < 1) {
 		LOGP(DL1C, LOGL_ERROR, "%s Rx Payload size 0\n",
@@ -546,6 +631,12 @@ int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg)
 	}
 	payload_len = data_ind->msgUnitParam.u8Size - 1;
 
+	/* bad frames are the most relevant input for link adaptation */
+	if (lchan->tch_mode == GSM48_CMODE_SPEECH_AMR)
+		amr_la_ul_meas(&st->amr_la, &lchan->tch.amr_mr,
+			       data_ind->measParam.fLinkQuality * 10,
+			       data_ind->measParam.fBer * 100);
+
 	if (lchan->loopback) {
 		GsmL1_Prim_t *rl1p;
 		GsmL1_PhDataReq_t *data_req;
@@ -554,6 +645,10 @@ int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg)
 		struct msgb *tmp;
 		int count = 0;
 
+		/* don't loop back garbage */
+		if (bfi)
+			return 0;
+
 		/* generate a new msgb from the paylaod */
 		rmsg = l1p_msgb_alloc();
 		if (!rmsg)
@@ -595,6 +690,12 @@ int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg)
 			goto err_payload_match;
 		break;
 	case GsmL1_TchPlType_Amr:
+	case GsmL1_TchPlType_Amr_SidBad:
+	case GsmL1_TchPlType_Amr_Onset:
+	case GsmL1_TchPlType_Amr_SidFirstP1:
+	case GsmL1_TchPlType_Amr_SidFirstP2:
+	case GsmL1_TchPlType_Amr_SidFirstInH:
+	case GsmL1_TchPlType_Amr_SidUpdateInH:
 		if (lchan->type != GSM_LCHAN_TCH_H &&
 		    lchan->type != GSM_LCHAN_TCH_F)
 			goto err_payload_match;
@@ -606,34 +707,101 @@ int l1if_tch_rx(struct gsm_lchan *lchan, struct msgb *l1p_msg)
 		break;
 	}
 
+	/* no speech frame at all, e.g. the MS is in DTX */
+	if (payload_len == 0) {
+		st->ul_no_data++;
+		goto skip;
+	}
 
 	switch (payload_type) {
 	case GsmL1_TchPlType_Fr:
+		if (bfi)
+			goto bad_frame;
 		rmsg = l1_to_rtppayload_fr(payload, payload_len);
 		break;
 	case GsmL1_TchPlType_Hr:
+		if (bfi)
+			goto bad_frame;
 		rmsg = l1_to_rtppayload_hr(payload, payload_len);
 		break;
 #if defined(L1_HAS_EFR) && defined(USE_L1_RTP_MODE)
 	case GsmL1_TchPlType_Efr:
+		if (bfi)
+			goto bad_frame;
 		rmsg = l1_to_rtppayload_efr(payload, payload_len);
 		break;
 #endif
 	case GsmL1_TchPlType_Amr:
+		ft = l1_amr_ft(payload, payload_len);
+		if (ft == AMR_FT_NO_DATA) {
+			st->ul_no_data++;
+			goto skip;
+		}
 		rmsg = l1_to_rtppayload_amr(payload, payload_len, lchan);
+		if (!rmsg)
+			break;
+		sid = ft == AMR_FT_SID_AMR;
+		if (bfi) {
+			/* RFC 3267 4.3.2: Q=0 flags a damaged frame */
+			st->ul_bfi++;
+			rmsg->data[1] &= ~AMR_TOC_QBIT;
+		}
 		break;
+	case GsmL1_TchPlType_Amr_SidBad:
+		goto bad_frame;
+	case GsmL1_TchPlType_Amr_Onset:
+	case GsmL1_TchPlType_Amr_SidFirstP1:
+	case GsmL1_TchPlType_Amr_SidFirstP2:
+	case GsmL1_TchPlType_Amr_SidFirstInH:
+	case GsmL1_TchPlType_Amr_SidUpdateInH:
+		/* in-band DTX signalling, no speech to pass on */
+		st->ul_no_data++;
+		goto skip;
 	}
 
-	if (rmsg) {
-		/* hand rmsg to RTP code for transmission */
-		if (lchan->abis_ip.rtp_socket)
-			osmo_rtp_send_frame(lchan->abis_ip.rtp_socket,
-					    rmsg->data, rmsg->len, 160);
-		msgb_free(rmsg);
-	}
+	if (!rmsg)
+		goto skip;
+
+	/* FR/HR SID frames look like speech frames */
+	if (payload_type == GsmL1_TchPlType_Fr ||
+	    payload_type == GsmL1_TchPlType_Hr)
+		sid = rtp_is_sid(lchan, rmsg->data, rmsg->len);
+	if (sid)
+		st->ul_sid++;
+
+	/* hand rmsg to RTP code for transmission */
+	if (lchan->abis_ip.rtp_socket)
+		osmo_rtp_send_frame_ext(lchan->abis_ip.rtp_socket,
+					rmsg->data, rmsg->len,
+					GSM_RTP_DURATION, st->ul_marker);
+	/* after a SID frame speech starts a new talk spurt */
+	st->ul_marker = sid;
+	voice_stats_ul_frame(vs, bfi);
+	msgb_free(rmsg);
 
 	return 0;
 
+bad_frame:
+	st->ul_bfi++;
+	voice_stats_ul_frame(vs, 1);
+	DEBUGP(DL1C, "%s Rx bad %s frame, not forwarding\n",
+		gsm_lchan_name(lchan),
+		get_value_string(femtobts_tch_pl_names, payload_type));
+	/* a single lost frame does not end the talk spurt */
+	if (lchan->abis_ip.rtp_socket)
+		osmo_rtp_skipped_frame(lchan->abis_ip.rtp_socket,
+				       GSM_RTP_DURATION);
+	return 0;
+
+skip:
+	/* keep the RTP clock running across the gap; whatever comes
+	 * next starts a new talk spurt (or is a SID update) */
+	if (lchan->abis_ip.rtp_socket)
+		osmo_rtp_skipped_frame(lchan->abis_ip.rtp_socket,
+				       GSM_RTP_DURATION);
+	st->ul_marker = 1;
+	return 0;
+
 err_payload_match:
 	LOGP(DL1C, LOGL_ERROR, "%s Rx Payload Type %s incompatible with lchan\n",
 		gsm_lchan_name(lchan),
@@ -688,3 +856,79 @@ struct msgb *gen_empty_tch_msg(struct gsm_lchan *lchan)
 
 	return msg;
 }
+
+/* GSM 05.08 8.3: positions of the SID frame during DTX, in terms of
+ * the first TDMA frame (modulo 104) of the TCH block */
+static int dtx_dl_sid_position(struct gsm_lchan *lchan, uint32_t fn)
+{
+	uint32_t fn104 = fn % 104;
+
+	if (lchan->type == GSM_LCHAN_TCH_F)
+		return fn104 == 52;
+
+	/* TCH/H sub-channel 0 and 1 */
+	if (lchan->nr == 0)
+		return fn104 == 0 || fn104 == 52;
+	return fn104 == 14 || fn104 == 66;
+}
+
+/*! \brief downlink DTX: what to transmit in a TCH block without speech
+ *  \param[in] lchan logical channel
+ *  \param[in] fn frame number of the TCH block
+ *  \returns L1 primitive with a SID frame, or NULL if nothing is to
+ *  be transmitted in this block
+ *
+ * The first block of a silence period carries the SID_FIRST, after
+ * that SID_UPDATE frames are only sent in the blocks GSM 05.08 8.3
+ * mandates for FR/EFR/HR, or every 8th block for AMR (3GPP TS 26.093).
+ */
+struct msgb *gen_dtx_tch_msg(struct gsm_lchan *lchan, uint32_t fn)
+{
+	struct femtol1_tch_state *st = lchan_tch_state(lchan);
+	struct msgb *msg;
+	GsmL1_Prim_t *l1p;
+	GsmL1_MsgUnitParam_t *msu_param;
+	int is_amr = lchan->tch_mode == GSM48_CMODE_SPEECH_AMR;
+	int send_sid;
+
+	if (!st->dl_dtx_active) {
+		/* SID_FIRST */
+		st->dl_dtx_active = 1;
+		st->dl_sid_age = 0;
+		send_sid = 1;
+	} else if (is_amr) {
+		send_sid = ++st->dl_sid_age >= 8;
+	} else
+		send_sid = dtx_dl_sid_position(lchan, fn);
+
+	if (!send_sid)
+		goto no_tx;
+
+	if (is_amr ? !lchan->tch.last_sid.len : !st->dl_sid_len)
+		goto no_tx;
+
+	msg = l1p_msgb_alloc();
+	if (!msg)
+		return NULL;
+
+	l1p = msgb_l1prim(msg);
+	msu_param = &l1p->u.phDataReq.msgUnitParam;
+
+	if (is_amr) {
+		msu_param->u8Buffer[0] = GsmL1_TchPlType_Amr;
+		memcpy(msu_param->u8Buffer+1, lchan->tch.last_sid.buf,
+			lchan->tch.last_sid.len);
+		msu_param->u8Size = lchan->tch.last_sid.len+1;
+	} else {
+		memcpy(msu_param->u8Buffer, st->dl_sid, st->dl_sid_len);
+		msu_param->u8Size = st->dl_sid_len;
+	}
+
+	st->dl_sid_age = 0;
+	st->dl_sid_tx++;
+	return msg;
+
+no_tx:
+	st->dl_dtx_blocks++;
+	return NULL;
+}
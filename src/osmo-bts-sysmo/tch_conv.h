@@ -0,0 +1,23 @@
+#ifndef SYSMOBTS_TCH_CONV_H
+#define SYSMOBTS_TCH_CONV_H
+
+#include <stdint.h>
+
+/* reference (two-pass) helpers */
+void osmo_nibble_shift_right(uint8_t *out, const uint8_t *in,
+			     unsigned int num_nibbles);
+void osmo_nibble_shift_left_unal(uint8_t *out, const uint8_t *in,
+				 unsigned int num_nibbles);
+
+/* single-pass, table driven conversion kernels */
+void tch_revbits_copy(uint8_t *out, const uint8_t *in, unsigned int len);
+void tch_revbits_shift_right(uint8_t *out, const uint8_t *in,
+			     unsigned int num_nibbles);
+void tch_revbits_shift_left(uint8_t *out, const uint8_t *in,
+			    unsigned int num_nibbles);
+void tch_shift_right_revbits(uint8_t *out, const uint8_t *in,
+			     unsigned int num_nibbles);
+void tch_shift_left_revbits(uint8_t *out, const uint8_t *in,
+			    unsigned int num_nibbles);
+
+#endif
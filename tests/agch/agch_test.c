@@ -129,13 +129,13 @@ static void test_agch_queue(void)
 		for (idx = 0; idx < num_ima_per_round; idx++) {
 			msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
 			put_imm_ass(msg, ++count);
-			bts_agch_enqueue(bts, msg);
+			bts_agch_enqueue(bts, 0, msg);
 			imm_ass_count++;
 		}
 		for (idx = 0; idx < num_rej_per_round; idx++) {
 			msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
 			put_imm_ass_rej(msg, ++count, 10);
-			bts_agch_enqueue(bts, msg);
+			bts_agch_enqueue(bts, 0, msg);
 			imm_ass_rej_count++;
 			imm_ass_rej_ref_count++;
 		}
@@ -143,13 +143,13 @@ static void test_agch_queue(void)
 
 	printf("AGCH filled: count %u, imm.ass %d, imm.ass.rej %d (refs %d), "
 	       "queue limit %u, occupied %d, "
-	       "dropped %llu, merged %llu, rejected %llu, "
+	       "dropped %llu, merged %llu, packed %llu, rejected %llu, "
 	       "ag-res %llu, non-res %llu\n",
 	       count, imm_ass_count, imm_ass_rej_count, imm_ass_rej_ref_count,
 	       btsb->agch_max_queue_length, btsb->agch_queue_length,
 	       btsb->agch_queue_dropped_msgs, btsb->agch_queue_merged_msgs,
-	       btsb->agch_queue_rejected_msgs, btsb->agch_queue_agch_msgs,
-	       btsb->agch_queue_pch_msgs);
+	       btsb->agch_queue_packed_msgs, btsb->agch_queue_rejected_msgs,
+	       btsb->agch_queue_agch_msgs, btsb->agch_queue_pch_msgs);
 
 	imm_ass_count = 0;
 	imm_ass_rej_count = 0;
@@ -161,12 +161,15 @@ static void test_agch_queue(void)
 		if (is_agch)
 			multiframes++;
 
-		rc = bts_ccch_copy_msg(bts, out_buf, &g_time, is_agch);
+		rc = bts_ccch_copy_msg(bts, 0, out_buf, &g_time, is_agch);
 		ima = (struct gsm48_imm_ass *)out_buf;
 		switch (ima->msg_type) {
 		case GSM48_MT_RR_IMM_ASS:
 			imm_ass_count++;
 			break;
+		case GSM48_MT_RR_IMM_ASS_EXT:
+			imm_ass_count += 2;
+			break;
 		case GSM48_MT_RR_IMM_ASS_REJ:
 			imm_ass_rej_count++;
 			imm_ass_rej_ref_count +=
@@ -182,13 +185,13 @@ static void test_agch_queue(void)
 
 	printf("AGCH drained: multiframes %u, imm.ass %d, imm.ass.rej %d (refs %d), "
 	       "queue limit %u, occupied %d, "
-	       "dropped %llu, merged %llu, rejected %llu, "
+	       "dropped %llu, merged %llu, packed %llu, rejected %llu, "
 	       "ag-res %llu, non-res %llu\n",
 	       multiframes, imm_ass_count, imm_ass_rej_count, imm_ass_rej_ref_count,
 	       btsb->agch_max_queue_length, btsb->agch_queue_length,
 	       btsb->agch_queue_dropped_msgs, btsb->agch_queue_merged_msgs,
-	       btsb->agch_queue_rejected_msgs, btsb->agch_queue_agch_msgs,
-	       btsb->agch_queue_pch_msgs);
+	       btsb->agch_queue_packed_msgs, btsb->agch_queue_rejected_msgs,
+	       btsb->agch_queue_agch_msgs, btsb->agch_queue_pch_msgs);
 }
 
 static void test_agch_queue_length_computation(void)
@@ -221,6 +224,99 @@ static void test_agch_queue_length_computation(void)
 	}
 }
 
+static void test_agch_queue_hard_limit(void)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	struct msgb *msg;
+	uint64_t rejected = btsb->agch_queue_rejected_msgs;
+	int idx, rc, refused = 0;
+
+	memset(&g_time, 0, sizeof(g_time));
+
+	printf("Testing AGCH hard limit.\n");
+	btsb->agch_queue_hard_limit = 4;
+	btsb->agch_queue_thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DISABLE;
+
+	/* 4 references per reject, the last 16 ones do not fit */
+	for (idx = 0; idx < 32; idx++) {
+		msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+		put_imm_ass_rej(msg, idx, 10);
+		if (bts_agch_enqueue(bts, 0, msg) < 0) {
+			msgb_free(msg);
+			refused++;
+		}
+	}
+	printf("AGCH rejects: occupied %d, refused %d, rejected %llu\n",
+	       btsb->agch_queue_length, refused,
+	       btsb->agch_queue_rejected_msgs - rejected);
+
+	/* drop one reject, an assignment overtakes the others */
+	msgb_free(bts_agch_dequeue(bts, 0));
+	msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+	put_imm_ass(msg, 1);
+	rc = bts_agch_enqueue(bts, 0, msg);
+	printf("AGCH assignment: rc %d, occupied %d\n", rc,
+	       btsb->agch_queue_length);
+
+	while ((rc = bts_ccch_copy_msg(bts, 0, out_buf, &g_time, 1)) > 0)
+		printf("AGCH sent: msg type 0x%02x\n",
+		       ((struct gsm48_imm_ass *)out_buf)->msg_type);
+
+	btsb->agch_queue_hard_limit = GSM_BTS_AGCH_QUEUE_HARD_LIMIT_DEFAULT;
+	btsb->agch_queue_thresh_level = GSM_BTS_AGCH_QUEUE_THRESH_LEVEL_DEFAULT;
+}
+
+static void test_ccch_scheduler_block(struct gsm_time *g_time)
+{
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	int rc;
+
+	rc = bts_ccch_copy_msg(bts, 0, out_buf, g_time, 0);
+	printf("FN %u: rc %d, msg type 0x%02x, paging deferred %llu\n",
+	       g_time->fn, rc, out_buf[2],
+	       (unsigned long long) btsb->ccch_sched.paging_deferred);
+}
+
+static void test_ccch_scheduler(void)
+{
+	static const uint8_t tmsi1_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x04 };
+	static const uint8_t tmsi2_lv[] = { 0x05, 0xf4, 0x05, 0x06, 0x07, 0x08 };
+	unsigned int cycle = paging_get_cycle_frames(btsb->paging_state);
+	struct gsm_time g_time;
+	struct msgb *msg;
+
+	printf("Testing CCCH scheduler.\n");
+
+	/* first PCH block of paging group 0 */
+	memset(&g_time, 0, sizeof(g_time));
+	g_time.fn = 6;
+	g_time.t3 = 6;
+
+	/* new paging goes ahead of an access grant of the same age */
+	paging_add_identity(btsb->paging_state, 0, 0, tmsi1_lv, 0, 0);
+	msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+	put_imm_ass(msg, 1);
+	bts_agch_enqueue(bts, 0, msg);
+	test_ccch_scheduler_block(&g_time);
+
+	/* the repetition yields to the access grant */
+	g_time.fn += cycle;
+	test_ccch_scheduler_block(&g_time);
+
+	/* an access grant waiting for a paging cycle beats new paging */
+	paging_add_identity(btsb->paging_state, 0, 0, tmsi2_lv, 0, 0);
+	msg = msgb_alloc(GSM_MACBLOCK_LEN, __FUNCTION__);
+	put_imm_ass(msg, 2);
+	bts_agch_enqueue(bts, 0, msg);
+	g_time.fn += cycle;
+	test_ccch_scheduler_block(&g_time);
+	g_time.fn += cycle;
+	test_ccch_scheduler_block(&g_time);
+
+	paging_reset(btsb->paging_state);
+}
+
 int main(int argc, char **argv)
 {
 	void *tall_msgb_ctx;
@@ -240,6 +336,8 @@ int main(int argc, char **argv)
 	btsb = bts_role_bts(bts);
 	test_agch_queue_length_computation();
 	test_agch_queue();
+	test_agch_queue_hard_limit();
+	test_ccch_scheduler();
 	printf("Success\n");
 
 	return 0;
@@ -0,0 +1,59 @@
+#ifndef _TESTS_BTS_FIXTURE_H
+#define _TESTS_BTS_FIXTURE_H
+
+#include <string.h>
+
+#include <osmocom/core/utils.h>
+#include <osmocom/core/linuxlist.h>
+
+#include <osmo-bts/gsm_data.h>
+
+#define TEST_BTS_MAX_TRX	2
+
+/* a BTS with its TRX, timeslots and lchans linked up, and room for the
+ * BTS-local state of every lchan */
+static struct {
+	struct gsm_bts bts;
+	struct gsm_bts_role_bts btsb;
+	struct gsm_bts_trx trx[TEST_BTS_MAX_TRX];
+	struct lchan_bts_state
+		lchan_state[TEST_BTS_MAX_TRX * TRX_NR_TS * TS_MAX_LCHAN];
+} test_bts;
+
+/* start over with num_trx TRX, the first one is the BCCH carrier */
+static struct gsm_bts *test_bts_setup(unsigned int num_trx)
+{
+	struct gsm_bts *bts = &test_bts.bts;
+	struct gsm_bts_role_bts *btsb = &test_bts.btsb;
+	unsigned int i, tn, ss;
+
+	OSMO_ASSERT(num_trx >= 1 && num_trx <= TEST_BTS_MAX_TRX);
+	memset(&test_bts, 0, sizeof(test_bts));
+
+	bts->role = btsb;
+	bts->num_trx = num_trx;
+	bts->c0 = &test_bts.trx[0];
+	INIT_LLIST_HEAD(&bts->trx_list);
+	btsb->lchan_state = test_bts.lchan_state;
+	btsb->num_lchan_state = ARRAY_SIZE(test_bts.lchan_state);
+
+	for (i = 0; i < num_trx; i++) {
+		struct gsm_bts_trx *trx = &test_bts.trx[i];
+
+		trx->nr = i;
+		trx->bts = bts;
+		llist_add_tail(&trx->list, &bts->trx_list);
+		for (tn = 0; tn < TRX_NR_TS; tn++) {
+			trx->ts[tn].nr = tn;
+			trx->ts[tn].trx = trx;
+			for (ss = 0; ss < TS_MAX_LCHAN; ss++) {
+				trx->ts[tn].lchan[ss].nr = ss;
+				trx->ts[tn].lchan[ss].ts = &trx->ts[tn];
+			}
+		}
+	}
+
+	return bts;
+}
+
+#endif /* _TESTS_BTS_FIXTURE_H */
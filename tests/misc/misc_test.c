@@ -23,12 +23,19 @@
 #include <osmo-bts/bts.h>
 #include <osmo-bts/msg_utils.h>
 #include <osmo-bts/logging.h>
+#include <osmo-bts/amr.h>
+#include <osmo-bts/voice_stats.h>
+#include <osmo-bts/measurement.h>
 
+#include <osmocom/core/talloc.h>
 #include <osmocom/gsm/protocol/ipaccess.h>
+#include <osmocom/gsm/protocol/gsm_04_08.h>
 
 #include <stdlib.h>
 #include <stdio.h>
 
+#include "../bts_fixture.h"
+
 static const uint8_t ipa_rsl_connect[] = {
 	0x00, 0x1c, 0xff, 0x10, 0x80, 0x00, 0x0a, 0x0d,
 	0x63, 0x6f, 0x6d, 0x2e, 0x69, 0x70, 0x61, 0x63,
@@ -133,21 +140,28 @@ static void test_msg_utils_oml(void)
 
 static void test_sacch_get(void)
 {
-	struct gsm_lchan lchan;
+	struct gsm_bts *bts;
+	struct gsm_bts_role_bts *btsb;
+	struct gsm_lchan *lchan;
+	struct lchan_sacch *ls;
 	int i, off;
 
 	printf("Testing lchan_sacch_get\n");
-	memset(&lchan, 0, sizeof(lchan));
+	bts = test_bts_setup(1);
+	btsb = bts_role_bts(bts);
+	lchan = &bts->c0->ts[0].lchan[0];
+	ls = &lchan_bts_state(lchan)->sacch;
 
 	/* initialize the input. */
 	for (i = 1; i < _MAX_SYSINFO_TYPE; ++i) {
-		lchan.si.valid |= (1 << i);
-		memset(&lchan.si.buf[i], i, sizeof(lchan.si.buf[i]));
+		ls->own |= (1 << i);
+		memset(&lchan->si.buf[i], i, sizeof(lchan->si.buf[i]));
 	}
+	lchan_sacch_update(lchan);
 
 	/* It will start with '1' */
 	for (i = 1, off = 0; i <= 32; ++i) {
-		uint8_t *data = lchan_sacch_get(&lchan);
+		uint8_t *data = lchan_sacch_get(lchan);
 		off = (off + 1) % _MAX_SYSINFO_TYPE;
 		if (off == 0)
 			off += 1;
@@ -155,6 +169,699 @@ static void test_sacch_get(void)
 		//printf("i=%d (%%=%d) -> data[0]=%d\n", i, off, data[0]);
 		OSMO_ASSERT(data[0] == off);
 	}
+
+	/* the SACCH filling of the BTS, SI 5 and 6 */
+	for (i = 0; i < _MAX_SYSINFO_TYPE; ++i)
+		memset(bts->si_buf[i], 0x80 | i, sizeof(bts->si_buf[i]));
+	btsb->sacch_fill.valid = (1 << SYSINFO_TYPE_5) | (1 << SYSINFO_TYPE_6);
+	btsb->sacch_fill.version++;
+	ls->own = 0;
+	ls->off = 0;
+	lchan_sacch_update(lchan);
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == (0x80 | SYSINFO_TYPE_5));
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == (0x80 | SYSINFO_TYPE_6));
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == (0x80 | SYSINFO_TYPE_5));
+
+	/* SI 6 of the lchan, SI 5 switched off */
+	ls->own |= (1 << SYSINFO_TYPE_6);
+	ls->off |= (1 << SYSINFO_TYPE_5);
+	lchan_sacch_update(lchan);
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == SYSINFO_TYPE_6);
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == SYSINFO_TYPE_6);
+
+	/* a new SACCH FILLING of the BTS is picked up */
+	btsb->sacch_fill.valid |= (1 << SYSINFO_TYPE_5ter);
+	btsb->sacch_fill.version++;
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == (0x80 | SYSINFO_TYPE_5ter));
+	OSMO_ASSERT(lchan_sacch_get(lchan)[0] == SYSINFO_TYPE_6);
+
+	/* nothing to send */
+	btsb->sacch_fill.valid = 0;
+	btsb->sacch_fill.version++;
+	ls->own = 0;
+	OSMO_ASSERT(lchan_sacch_get(lchan) == NULL);
+}
+
+static const char *si_name(const uint8_t *si)
+{
+	if (!si)
+		return "-";
+
+	/* the buffers are filled with their type */
+	switch (si[0]) {
+	case SYSINFO_TYPE_1:		return "1";
+	case SYSINFO_TYPE_2:		return "2";
+	case SYSINFO_TYPE_3:		return "3";
+	case SYSINFO_TYPE_4:		return "4";
+	case SYSINFO_TYPE_9:		return "9";
+	case SYSINFO_TYPE_13:		return "13";
+	case SYSINFO_TYPE_2bis:		return "2bis";
+	case SYSINFO_TYPE_2ter:		return "2ter";
+	case SYSINFO_TYPE_2quater:	return "2quater";
+	default:			return "?";
+	}
+}
+
+static void test_bcch_sched_one(const char *name, uint32_t si_valid,
+				const uint8_t *si3_ro)
+{
+	struct gsm_bts bts;
+	struct gsm_bts_role_bts btsb;
+	struct gsm48_system_information_type_3 *si3;
+	struct gsm_time g_time;
+	int i;
+
+	memset(&bts, 0, sizeof(bts));
+	memset(&btsb, 0, sizeof(btsb));
+	bts.role = &btsb;
+
+	bts.si_valid = si_valid;
+	for (i = 0; i < _MAX_SYSINFO_TYPE; i++)
+		memset(bts.si_buf[i], i, sizeof(bts.si_buf[i]));
+	si3 = (struct gsm48_system_information_type_3 *)
+					bts.si_buf[SYSINFO_TYPE_3];
+	memcpy(si3->rest_octets, si3_ro, 4);
+
+	bts_sysinfo_sched_update(&bts);
+
+	printf(" %s\n  Norm:", name);
+	for (i = 0; i < BCCH_SCHED_LEN; i++) {
+		g_time.fn = i * 51;
+		printf(" %s", si_name(bts_sysinfo_get(&bts, &g_time)));
+	}
+	printf("\n  Ext:");
+	for (i = 0; i < BCCH_SCHED_LEN; i++) {
+		g_time.fn = i * 51;
+		printf(" %s", si_name(bts_sysinfo_get_ext(&bts, &g_time)));
+	}
+	printf("\n");
+}
+
+#define SI(x)	(1 << SYSINFO_TYPE_##x)
+
+static void test_bcch_sched(void)
+{
+	/* no options in the SI 3 rest octets */
+	static const uint8_t ro_none[] = { 0x2b, 0x2b, 0x2b, 0x2b };
+	/* SI 9 scheduled, SI 13 and SI 2quater on BCCH Ext */
+	static const uint8_t ro_ext[] = { 0x20, 0x89, 0x2b, 0x2b };
+
+	printf("Testing BCCH schedule\n");
+
+	test_bcch_sched_one("SI 1/2/3/4", SI(1) | SI(2) | SI(3) | SI(4),
+			    ro_none);
+	test_bcch_sched_one("SI 2/3/4/2quater", SI(2) | SI(3) | SI(4) |
+			    SI(2quater), ro_none);
+	test_bcch_sched_one("SI 1/2/3/4/2bis/2ter/2quater/9/13",
+			    SI(1) | SI(2) | SI(3) | SI(4) | SI(2bis) |
+			    SI(2ter) | SI(2quater) | SI(9) | SI(13), ro_none);
+	test_bcch_sched_one("SI 2/3/4/2ter/2quater/9/13, BCCH Ext",
+			    SI(2) | SI(3) | SI(4) | SI(2ter) | SI(2quater) |
+			    SI(9) | SI(13), ro_ext);
+}
+
+/* num ticks with rach RACH each, returns the CHAN RQD admitted */
+static int test_rach_overload_tick(struct gsm_bts *bts, int num, int rach)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+	int i, j, admitted = 0;
+
+	for (i = 0; i < num; i++) {
+		for (j = 0; j < rach; j++)
+			admitted += rach_overload_admit(bts, 0x00, j);
+		ro->timer.cb(ro->timer.data);
+	}
+
+	return admitted;
+}
+
+static void test_rach_overload_print(struct gsm_bts *bts)
+{
+	struct rach_overload *ro = &bts_role_bts(bts)->rach_ovld;
+	struct gsm48_system_information_type_3 *si3 =
+		(void *) bts->si_buf[SYSINFO_TYPE_3];
+
+	printf(" level %d, SI 3 access classes 0x%02x%02x\n", ro->level,
+		si3->rach_control.t2, si3->rach_control.t3);
+}
+
+static void test_rach_overload(void)
+{
+	struct gsm_bts bts;
+	struct gsm_bts_role_bts btsb;
+	struct rach_overload *ro = &btsb.rach_ovld;
+	struct gsm48_system_information_type_3 *si3;
+	int i, admitted, emergency;
+
+	printf("Testing RACH overload control\n");
+	memset(&bts, 0, sizeof(bts));
+	memset(&btsb, 0, sizeof(btsb));
+	bts.role = &btsb;
+
+	/* the BSC bars access class 10, emergency calls */
+	bts.si_valid = SI(3);
+	si3 = (void *) bts.si_buf[SYSINFO_TYPE_3];
+	si3->rach_control.t2 = 0x04;
+	si3->rach_control.t3 = 0x00;
+
+	rach_overload_init(&bts);
+	ro->acc_barring = 1;
+	test_rach_overload_print(&bts);
+
+	/* off by default, even with 300 RACH per second */
+	admitted = test_rach_overload_tick(&bts, 10, 30);
+	printf(" %d of 300 CHAN RQD admitted\n", admitted);
+	test_rach_overload_print(&bts);
+
+	/* more than 150 RACH per second for 500 ms raise the level */
+	ro->rach_thresh = 150;
+	admitted = test_rach_overload_tick(&bts, 4, 30);
+	test_rach_overload_print(&bts);
+	admitted += test_rach_overload_tick(&bts, 1, 30);
+	printf(" %d of 150 CHAN RQD admitted\n", admitted);
+	test_rach_overload_print(&bts);
+
+	/* only 90% of 150 RACH per second get through, emergency
+	 * calls always do */
+	for (i = 0, admitted = 0, emergency = 0; i < 20; i++)
+		admitted += rach_overload_admit(&bts, 0x00, i);
+	for (i = 0; i < 2; i++)
+		emergency += rach_overload_admit(&bts, 0xa0, i);
+	printf(" %d of 20 CHAN RQD admitted, %d of 2 emergency\n",
+		admitted, emergency);
+	test_rach_overload_tick(&bts, 1, 0);
+	test_rach_overload_print(&bts);
+
+	/* the retries keep the cell in overload, 10% still get through */
+	test_rach_overload_tick(&bts, 60, 30);
+	admitted = test_rach_overload_tick(&bts, 10, 30);
+	printf(" %d of 300 CHAN RQD admitted\n", admitted);
+	test_rach_overload_print(&bts);
+
+	/* the BSC changes the SI, the barring is applied again */
+	si3->rach_control.t2 = 0x00;
+	si3->rach_control.t3 = 0x80;
+	rach_overload_update_si(&bts);
+	test_rach_overload_print(&bts);
+
+	/* one level less for every 2 s without overload, the barred
+	 * access classes rotate once per second */
+	for (i = 0; i < 4; i++) {
+		test_rach_overload_tick(&bts, 10, 0);
+		test_rach_overload_print(&bts);
+	}
+	test_rach_overload_tick(&bts, 140, 0);
+	test_rach_overload_print(&bts);
+
+	printf(" admitted %llu, emergency %llu, dropped %llu, "
+		"overloads %llu\n",
+		(unsigned long long) ro->stats.admitted,
+		(unsigned long long) ro->stats.emergency,
+		(unsigned long long) ro->stats.dropped,
+		(unsigned long long) ro->stats.overloads);
+
+	osmo_timer_del(&ro->timer);
+}
+
+static void test_load_stats_print(struct gsm_bts *bts, int ticks)
+{
+	int tc;
+
+	printf(" %4d ticks:", ticks);
+	for (tc = 0; tc < _NUM_LOAD_STATS_TC; tc++)
+		printf(" %s PCH %u/%u RACH %u/%u%s",
+			get_value_string(load_stats_tc_names, tc),
+			load_stats_avg(bts, LOAD_STATS_PCH_USED, tc),
+			load_stats_avg(bts, LOAD_STATS_PCH_BLOCKS, tc),
+			load_stats_avg(bts, LOAD_STATS_RACH_BUSY, tc),
+			load_stats_avg(bts, LOAD_STATS_RACH_SLOTS, tc),
+			tc == _NUM_LOAD_STATS_TC - 1 ? "\n" : ",");
+}
+
+static void test_load_stats(void)
+{
+	/* TMSI */
+	static const uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x01, 0x02, 0x03, 0x04 };
+	static const unsigned int wait_frames[] = {
+		0, 10, 11, 216, 217, 1000, 10000 };
+	struct gsm_bts bts;
+	struct gsm_bts_role_bts *btsb;
+	struct load_stats *ls;
+	struct gsm_time g_time;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	int i, is_empty;
+
+	printf("Testing load statistics\n");
+	memset(&bts, 0, sizeof(bts));
+	btsb = talloc_zero(NULL, struct gsm_bts_role_bts);
+	btsb->paging_state = paging_init(btsb, 200, 0);
+	bts.role = btsb;
+	ls = &btsb->load_stats;
+	load_stats_init(&bts);
+
+	/* 40 PCH blocks per second of which 10 are used, 100 RACH
+	 * slots of which 20 are busy, the PCH counter wraps */
+	btsb->load.ccch.pch_total = 0xfffffff0;
+	for (i = 1; i <= 600; i++) {
+		btsb->load.ccch.pch_total += 4;
+		btsb->load.ccch.pch_used += 1;
+		btsb->load.rach.total += 10;
+		btsb->load.rach.busy += 2;
+		ls->timer.cb(ls->timer.data);
+		if (i == 10 || i == 100 || i == 600)
+			test_load_stats_print(&bts, i);
+	}
+	printf(" PCH load %u/%u/%u, RACH load %u/%u/%u\n",
+		load_stats_pch_load(&bts, LOAD_STATS_TC_1S),
+		load_stats_pch_load(&bts, LOAD_STATS_TC_10S),
+		load_stats_pch_load(&bts, LOAD_STATS_TC_60S),
+		load_stats_rach_load(&bts, LOAD_STATS_TC_1S),
+		load_stats_rach_load(&bts, LOAD_STATS_TC_10S),
+		load_stats_rach_load(&bts, LOAD_STATS_TC_60S));
+
+	/* everything stops, the short average follows first */
+	for (i = 1; i <= 10; i++)
+		ls->timer.cb(ls->timer.data);
+	test_load_stats_print(&bts, 10);
+
+	/* the waiting time of AGCH messages by bin */
+	for (i = 0; i < ARRAY_SIZE(wait_frames); i++)
+		load_stats_agch_wait(btsb, wait_frames[i]);
+	printf(" AGCH wait:");
+	for (i = 0; i < LOAD_STATS_WAIT_BINS; i++)
+		printf(" %llu", (unsigned long long) ls->agch_wait[i]);
+	printf("\n");
+
+	/* one paging group always busy, one never, taken at the end of
+	 * the window */
+	paging_add_identity(btsb->paging_state, 0, 0, tmsi_lv, 0, 0);
+	memset(&g_time, 0, sizeof(g_time));
+	g_time.fn = g_time.t3 = 6;
+	paging_gen_msg(btsb->paging_state, 0, out_buf, &g_time, &is_empty);
+	g_time.fn = g_time.t3 = 12;
+	paging_gen_msg(btsb->paging_state, 0, out_buf, &g_time, &is_empty);
+	while (ls->ticks % (LOAD_STATS_GROUP_WINDOW_MS / LOAD_STATS_TICK_MS))
+		ls->timer.cb(ls->timer.data);
+	printf(" paging groups:");
+	for (i = 0; i < LOAD_STATS_GROUP_BINS; i++)
+		printf(" %u", ls->group_occ[i]);
+	printf("\n");
+
+	osmo_timer_del(&ls->timer);
+	talloc_free(btsb);
+}
+
+/* the measurement period ends as they were worked out for every frame
+ * before the schedule, see TS 05.08, Chapter 8.4.1 */
+static const uint8_t tchf_meas_rep_fn104[] = {
+	103, 12, 25, 38, 51, 64, 77, 90 };
+static const uint8_t tchh0_meas_rep_fn104[] = {
+	103, 103, 25, 25, 51, 51, 77, 77 };
+static const uint8_t tchh1_meas_rep_fn104[] = {
+	12, 12, 38, 38, 64, 64, 90, 90 };
+
+static int is_meas_complete(enum gsm_phys_chan_config pchan, unsigned int ts,
+			    unsigned int subch, uint32_t fn)
+{
+	switch (pchan) {
+	case GSM_PCHAN_TCH_F:
+		return tchf_meas_rep_fn104[ts] == fn % 104;
+	case GSM_PCHAN_TCH_H:
+		if (subch == 0)
+			return tchh0_meas_rep_fn104[ts] == fn % 104;
+		return tchh1_meas_rep_fn104[ts] == fn % 104;
+	case GSM_PCHAN_SDCCH8_SACCH8C:
+	case GSM_PCHAN_SDCCH8_SACCH8C_CBCH:
+		return fn % 102 == 11;
+	case GSM_PCHAN_CCCH_SDCCH4:
+	case GSM_PCHAN_CCCH_SDCCH4_CBCH:
+		return fn % 102 == 36;
+	default:
+		return 0;
+	}
+}
+
+static void test_meas_sched(void)
+{
+	static const struct {
+		enum gsm_phys_chan_config pchan;
+		enum gsm_chan_t type;
+		unsigned int num_lchan;
+		const char *name;
+	} cfg[] = {
+		{ GSM_PCHAN_TCH_F, GSM_LCHAN_TCH_F, 1, "TCH/F" },
+		{ GSM_PCHAN_TCH_H, GSM_LCHAN_TCH_H, 2, "TCH/H" },
+		{ GSM_PCHAN_SDCCH8_SACCH8C, GSM_LCHAN_SDCCH, 8, "SDCCH8" },
+		{ GSM_PCHAN_SDCCH8_SACCH8C_CBCH, GSM_LCHAN_SDCCH, 8,
+		  "SDCCH8+CBCH" },
+		{ GSM_PCHAN_CCCH_SDCCH4, GSM_LCHAN_SDCCH, 4, "CCCH+SDCCH4" },
+		{ GSM_PCHAN_CCCH_SDCCH4_CBCH, GSM_LCHAN_SDCCH, 4,
+		  "CCCH+SDCCH4+CBCH" },
+		{ GSM_PCHAN_PDCH, GSM_LCHAN_PDTCH, 1, "PDCH" },
+	};
+	static struct trx_meas_sched meas_sched;
+	struct gsm_bts *bts;
+	struct gsm_bts_trx *trx;
+	unsigned int c, tn, nr, periods, wrong;
+	uint32_t fn;
+
+	printf("Testing measurement schedule\n");
+	bts = test_bts_setup(1);
+	bts_role_bts(bts)->meas_sched = &meas_sched;
+	trx = bts->c0;
+
+	for (c = 0; c < ARRAY_SIZE(cfg); c++) {
+		periods = wrong = 0;
+		for (tn = 0; tn < TRX_NR_TS; tn++) {
+			struct gsm_bts_trx_ts *ts = &trx->ts[tn];
+
+			ts->pchan = cfg[c].pchan;
+			for (nr = 0; nr < cfg[c].num_lchan; nr++) {
+				struct gsm_lchan *lchan = &ts->lchan[nr];
+				struct ul_meas_acc *acc;
+
+				lchan->type = cfg[c].type;
+				/* the CBCH has no measurements */
+				if (nr == 2 && (cfg[c].pchan ==
+						GSM_PCHAN_SDCCH8_SACCH8C_CBCH ||
+						cfg[c].pchan ==
+						GSM_PCHAN_CCCH_SDCCH4_CBCH))
+					lchan->type = GSM_LCHAN_CBCH;
+				lchan_set_state(lchan, LCHAN_S_ACTIVE);
+				acc = &lchan_bts_state(lchan)->ul_meas;
+
+				/* all combinations of FN % 104 and % 102 */
+				for (fn = 0; fn < 104 * 51; fn++) {
+					int done, exp;
+
+					acc->num = 1;
+					lchan->meas.flags = 0;
+					trx_meas_check_compute(trx, fn);
+					done = !!(lchan->meas.flags &
+						  LC_UL_M_F_RES_VALID);
+					exp = lchan->type != GSM_LCHAN_CBCH &&
+						is_meas_complete(ts->pchan,
+								 tn, nr, fn);
+					periods += done;
+					if (done != exp)
+						wrong++;
+				}
+				lchan_set_state(lchan, LCHAN_S_NONE);
+			}
+		}
+		printf(" %s: %u periods, %u differ\n", cfg[c].name, periods,
+			wrong);
+	}
+}
+
+/* run num SACCH periods with the same levels and qualities, the
+ * RXLEV/RXQUAL are those of the full set */
+static void test_meas_preproc_run(struct gsm_lchan *lchan, const char *name,
+				  int num, uint8_t ul_lev, uint8_t ul_qual,
+				  uint8_t dl_lev, uint8_t dl_qual)
+{
+	uint8_t l3[] = { 0x06, GSM48_MT_RR_MEAS_REP, 0x00, 0x00, 0x00,
+			 0x00 };
+	int i;
+
+	lchan->meas.flags |= LC_UL_M_F_RES_VALID;
+	lchan->meas.ul_res.full.rx_lev = ul_lev;
+	lchan->meas.ul_res.full.rx_qual = ul_qual;
+	l3[2] = dl_lev;
+	l3[4] = dl_qual << 4;
+
+	printf(" %-28s ", name);
+	for (i = 0; i < num; i++)
+		printf("%d", meas_preproc_check(lchan, l3, sizeof(l3)));
+	printf("\n");
+}
+
+static void test_meas_preproc(void)
+{
+	static const uint8_t preproc_on[] = { 0x01 };
+	static const uint8_t emr[] = { 0x06, 0x04, 0x00, 0x00, 0x00, 0x00 };
+	struct gsm_bts *bts;
+	struct gsm_lchan *lchan;
+	struct meas_preproc *mp;
+
+	printf("Testing measurement pre-processing\n");
+	bts = test_bts_setup(1);
+	mp = &bts_role_bts(bts)->meas_preproc;
+	lchan = &bts->c0->ts[0].lchan[0];
+	meas_preproc_init(bts);
+	meas_preproc_reset(lchan);
+
+	/* not requested by the BSC */
+	test_meas_preproc_run(lchan, "bsc, off", 12, 40, 0, 40, 0);
+
+	/* the first report is sent, then one every interval */
+	meas_preproc_config(lchan, preproc_on, sizeof(preproc_on));
+	test_meas_preproc_run(lchan, "bsc, on, steady", 12, 40, 0, 40, 0);
+
+	/* the average moves by the delta after a few periods */
+	test_meas_preproc_run(lchan, "UL RXLEV -10 dB", 5, 30, 0, 40, 0);
+	test_meas_preproc_run(lchan, "DL RXQUAL 0 -> 2", 5, 30, 0, 40, 2);
+	test_meas_preproc_run(lchan, "steady", 12, 30, 0, 40, 2);
+
+	/* below the trigger level, every report is sent */
+	test_meas_preproc_run(lchan, "DL RXLEV 5", 12, 30, 0, 5, 2);
+	test_meas_preproc_run(lchan, "DL RXLEV 40", 12, 30, 0, 40, 2);
+	test_meas_preproc_run(lchan, "UL RXQUAL 7", 12, 30, 7, 40, 2);
+	test_meas_preproc_run(lchan, "UL RXQUAL 0", 12, 30, 0, 40, 2);
+
+	/* other messages always get through */
+	printf(" %-28s %d\n", "Enhanced Measurement Report",
+		meas_preproc_check(lchan, emr, sizeof(emr)));
+
+	/* the BTS overrides the BSC */
+	mp->mode = MEAS_PREPROC_NEVER;
+	test_meas_preproc_run(lchan, "never, on", 12, 30, 0, 40, 2);
+	mp->mode = MEAS_PREPROC_ALWAYS;
+	meas_preproc_reset(lchan);
+	test_meas_preproc_run(lchan, "always, off", 12, 30, 0, 40, 2);
+
+	printf(" sent %llu, suppressed %llu, triggered %llu\n",
+		(unsigned long long) mp->stats.sent,
+		(unsigned long long) mp->stats.suppressed,
+		(unsigned long long) mp->stats.triggered);
+}
+
+static void test_bs_power_ctrl_rep(struct gsm_lchan *lchan,
+				   unsigned int rxlev, unsigned int rxqual)
+{
+	/* MEASUREMENT REPORT, FULL and SUB values alike */
+	uint8_t l3[17] = { GSM48_PDISC_RR, GSM48_MT_RR_MEAS_REP };
+
+	l3[2] = rxlev;
+	l3[3] = rxlev;
+	l3[4] = (rxqual << 4) | (rxqual << 1);
+	bs_power_ctrl_meas(lchan, l3, sizeof(l3));
+}
+
+static void test_bs_power_ctrl_print(struct gsm_lchan *a, struct gsm_lchan *b)
+{
+	printf(" BS Power %u/%u, TRX %d, measured %u/%u\n",
+		a->bs_power, b->bs_power,
+		bs_power_ctrl_trx_power(a->ts->trx),
+		a->meas.bts_tx_pwr, b->meas.bts_tx_pwr);
+}
+
+static void test_bs_power_ctrl(void)
+{
+	struct gsm_bts *bts = test_bts_setup(2);
+	struct bs_power_ctrl *bpc = &bts_role_bts(bts)->bs_power_ctrl;
+	struct gsm_lchan *a = &test_bts.trx[1].ts[1].lchan[0];
+	struct gsm_lchan *b = &test_bts.trx[1].ts[2].lchan[0];
+	struct gsm_lchan *c = &test_bts.trx[0].ts[1].lchan[0];
+	int i;
+
+	printf("Testing BS power control\n");
+	bs_power_ctrl_init(bts);
+	bpc->mode = BS_PWR_CTRL_ON;
+	a->state = b->state = c->state = LCHAN_S_ACTIVE;
+	bs_power_ctrl_reset(a, 0);
+	bs_power_ctrl_reset(b, 0);
+	bs_power_ctrl_reset(c, 0);
+
+	/* both MS close to the BTS */
+	for (i = 0; i < 3; i++) {
+		test_bs_power_ctrl_rep(a, 50, 0);
+		test_bs_power_ctrl_rep(b, 50, 0);
+		test_bs_power_ctrl_print(a, b);
+	}
+
+	/* the first one moves away and keeps the TRX up */
+	for (i = 0; i < 4; i++) {
+		test_bs_power_ctrl_rep(a, 20, 0);
+		test_bs_power_ctrl_rep(b, 50, 0);
+		test_bs_power_ctrl_print(a, b);
+	}
+	test_bs_power_ctrl_rep(a, 30, 6);
+	test_bs_power_ctrl_rep(b, 50, 0);
+	test_bs_power_ctrl_print(a, b);
+
+	/* released, the second one goes down from where the TRX is */
+	a->state = LCHAN_S_NONE;
+	for (i = 0; i < 7; i++) {
+		test_bs_power_ctrl_rep(b, 50, 0);
+		test_bs_power_ctrl_print(a, b);
+	}
+
+	/* a fixed BS Power and the BCCH carrier are left alone */
+	b->bs_power = 2;
+	bs_power_ctrl_reset(b, 1);
+	test_bs_power_ctrl_rep(b, 50, 0);
+	test_bs_power_ctrl_rep(c, 50, 0);
+	printf(" fixed %u, BCCH carrier %u\n", b->bs_power, c->bs_power);
+
+	printf(" changes %llu, reduction %u..%u avg %u dB\n",
+		(unsigned long long) bpc->changes,
+		lchan_bts_state(a)->bs_power.red_min,
+		lchan_bts_state(a)->bs_power.red_max,
+		bs_power_ctrl_avg_red(a));
+}
+
+static void test_ta_ctrl_run(struct gsm_lchan *lchan, int offs_qb,
+			     uint8_t ms_ta)
+{
+	uint8_t ta = lchan->rqd_ta;
+
+	lchan->meas.l1_info[1] = ms_ta;
+	ta_ctrl_meas(lchan, offs_qb);
+	printf(" offset %d qb, MS TA %u: TA %u -> %u, MS Timing Offset %d\n",
+		offs_qb, ms_ta, ta, lchan->rqd_ta,
+		ta_ctrl_ms_timing_offset(lchan));
+}
+
+static void test_ta_ctrl(void)
+{
+	struct gsm_bts *bts = test_bts_setup(1);
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct gsm_lchan *lchan = &bts->c0->ts[0].lchan[0];
+
+	printf("Testing TA control\n");
+	btsb->max_ta = 63;
+	ta_ctrl_init(bts);
+
+	lchan->rqd_ta = 5;
+	ta_ctrl_reset(lchan);
+	printf(" MS Timing Offset %d\n", ta_ctrl_ms_timing_offset(lchan));
+
+	/* off by default */
+	test_ta_ctrl_run(lchan, 8, 5);
+	btsb->ta_ctrl.enabled = 1;
+
+	/* moving away, the MS takes a while to use the new TA */
+	test_ta_ctrl_run(lchan, 8, 5);
+	test_ta_ctrl_run(lchan, 8, 5);
+	test_ta_ctrl_run(lchan, 8, 5);
+	test_ta_ctrl_run(lchan, 4, 6);
+	test_ta_ctrl_run(lchan, 4, 6);
+
+	/* without an interval only the MS holds the next change back */
+	btsb->ta_ctrl.interval = 1;
+	test_ta_ctrl_run(lchan, 4, 6);
+	test_ta_ctrl_run(lchan, 4, 7);
+	test_ta_ctrl_run(lchan, 1, 7);
+	test_ta_ctrl_run(lchan, -6, 7);
+	test_ta_ctrl_run(lchan, 0, 7);
+
+	/* the TA of a handover RACH starts over */
+	lchan->rqd_ta = 10;
+	ta_ctrl_reset(lchan);
+	test_ta_ctrl_run(lchan, 4, 6);
+
+	/* larger steps, limited by the maximum TA */
+	btsb->max_ta = 12;
+	btsb->ta_ctrl.max_step = 4;
+	test_ta_ctrl_run(lchan, 20, 11);
+	test_ta_ctrl_run(lchan, 200, 11);
+
+	btsb->ta_ctrl.enabled = 0;
+	test_ta_ctrl_run(lchan, 200, 12);
+	printf(" changes %llu\n", (unsigned long long) btsb->ta_ctrl.changes);
+}
+
+static void test_amr_la(void)
+{
+	/* MultiRate Config IE value: version 1, ICMI, start mode 1,
+	 * 4.75/5.90/7.40/12.2, thresholds 10/20/30, hysteresis 2/3/4 */
+	static const uint8_t mr_conf[] = {
+		0x29, 0x95, 0x0a, 0x25, 0x0d, 0xe4 };
+	struct gsm_lchan lchan;
+	struct amr_multirate_conf *amr_mrc = &lchan.tch.amr_mr;
+	struct amr_link_adapt la;
+	int i, rc;
+
+	printf("Testing AMR link adaptation\n");
+	memset(&lchan, 0, sizeof(lchan));
+
+	rc = amr_parse_mr_conf(amr_mrc, mr_conf, sizeof(mr_conf));
+	OSMO_ASSERT(rc == 4);
+	for (i = 0; i < amr_mrc->num_modes; i++)
+		printf(" mode[%d] = %u/%u/%u\n", i, amr_mrc->mode[i].mode,
+			amr_mrc->mode[i].threshold, amr_mrc->mode[i].hysteresis);
+
+	lchan.mr_conf.icmi = 1;
+	lchan.mr_conf.smod = 1;
+	amr_la_init(&la, &lchan);
+	printf(" initial mode[%u]\n", la.mode_idx);
+
+	/* good C/I: go up one step per hold-off period */
+	for (i = 0; i < 100; i++)
+		amr_la_ul_meas(&la, amr_mrc, 200, 0);
+	printf(" C/I 20 dB -> mode[%u]\n", la.mode_idx);
+
+	/* bad C/I: go down to the most robust mode */
+	for (i = 0; i < 100; i++)
+		amr_la_ul_meas(&la, amr_mrc, 30, 0);
+	printf(" C/I 3 dB -> mode[%u]\n", la.mode_idx);
+
+	for (i = 0; i < 100; i++)
+		amr_la_ul_meas(&la, amr_mrc, 200, 0);
+	printf(" C/I 20 dB -> mode[%u]\n", la.mode_idx);
+
+	/* good C/I but high BER: go down */
+	for (i = 0; i < 100; i++)
+		amr_la_ul_meas(&la, amr_mrc, 200, 800);
+	printf(" C/I 20 dB, BER 8%% -> mode[%u]\n", la.mode_idx);
+
+	printf(" residency %u/%u/%u/%u, %u changes\n", la.residency[0],
+		la.residency[1], la.residency[2], la.residency[3],
+		la.num_changes);
+}
+
+static void test_voice_mos(void)
+{
+	static const struct {
+		uint8_t tch_mode;
+		int full_rate;
+		unsigned int loss_pm;
+		unsigned int delay_ms;
+	} tests[] = {
+		{ GSM48_CMODE_SPEECH_V1, 1, 0, 60 },
+		{ GSM48_CMODE_SPEECH_V1, 0, 0, 60 },
+		{ GSM48_CMODE_SPEECH_EFR, 1, 0, 60 },
+		{ GSM48_CMODE_SPEECH_AMR, 1, 0, 60 },
+		{ GSM48_CMODE_SPEECH_AMR, 1, 10, 60 },
+		{ GSM48_CMODE_SPEECH_AMR, 1, 50, 60 },
+		{ GSM48_CMODE_SPEECH_AMR, 1, 200, 60 },
+		{ GSM48_CMODE_SPEECH_AMR, 1, 0, 300 },
+		{ GSM48_CMODE_SPEECH_V1, 1, 30, 160 },
+		{ GSM48_CMODE_SIGN, 1, 0, 60 },
+	};
+	int i;
+
+	printf("Testing voice MOS estimate\n");
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++)
+		printf(" mode=0x%02x %s loss=%u%%o delay=%ums: MOS %u\n",
+			tests[i].tch_mode, tests[i].full_rate ? "F" : "H",
+			tests[i].loss_pm, tests[i].delay_ms,
+			voice_mos_estimate(tests[i].tch_mode,
+					   tests[i].full_rate,
+					   tests[i].loss_pm,
+					   tests[i].delay_ms));
 }
 
 int main(int argc, char **argv)
@@ -162,7 +869,16 @@ int main(int argc, char **argv)
 	bts_log_init(NULL);
 
 	test_sacch_get();
+	test_bcch_sched();
+	test_rach_overload();
+	test_load_stats();
+	test_meas_sched();
+	test_meas_preproc();
+	test_bs_power_ctrl();
+	test_ta_ctrl();
 	test_msg_utils_ipa();
 	test_msg_utils_oml();
+	test_amr_la();
+	test_voice_mos();
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,388 @@
+/* throughput and latency benchmark of the paging queue */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <osmocom/core/talloc.h>
+#include <osmocom/core/logging.h>
+#include <osmocom/gsm/gsm_utils.h>
+
+#include <osmo-bts/bts.h>
+#include <osmo-bts/logging.h>
+#include <osmo-bts/paging.h>
+#include <osmo-bts/gsm_data.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/* first frame of the CCCH blocks in a 51-multiframe */
+static const uint8_t ccch_block_t3[] = { 6, 12, 16, 22, 26, 32, 36, 42, 46 };
+
+/* identities that were recently paged, candidates for duplicates */
+#define RECENT_IDS	64
+
+struct bench_id {
+	uint32_t enq_fn;	/* frame of the first PAGING CMD */
+	uint8_t group;
+	uint8_t is_tmsi;
+	uint8_t admitted;
+	uint8_t sent;
+};
+
+static struct {
+	unsigned int rate;		/* PAGING CMD per second */
+	unsigned int tmsi_pct;
+	unsigned int dup_pct;
+	unsigned int groups;		/* number of paging groups used */
+	unsigned int seconds;
+	unsigned int queue_max;
+	unsigned int lifetime;
+	unsigned int bs_pa_mfrms;
+	unsigned int bs_ag_blks_res;
+	unsigned int seed;
+} cfg = {
+	.rate = 50,
+	.tmsi_pct = 80,
+	.dup_pct = 10,
+	.groups = 0,
+	.seconds = 600,
+	.queue_max = 200,
+	.lifetime = 8,
+	.bs_pa_mfrms = 2,
+	.bs_ag_blks_res = 1,
+	.seed = 1,
+};
+
+static struct gsm_bts *bts;
+static struct bench_id *ids;
+static unsigned int num_ids, max_ids;
+static uint32_t *latency;
+static unsigned int num_latency;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the number of the identity is in the last four octets */
+static void make_identity(uint8_t *lv, uint32_t id, int is_tmsi)
+{
+	uint8_t *cur;
+
+	if (is_tmsi) {
+		lv[0] = 5;
+		lv[1] = 0xf0 | GSM_MI_TYPE_TMSI;
+	} else {
+		lv[0] = 8;
+		lv[1] = 0x08 | GSM_MI_TYPE_IMSI;
+		lv[2] = lv[3] = lv[4] = 0x21;
+	}
+	cur = lv + lv[0] - 3;
+	cur[0] = id >> 24;
+	cur[1] = id >> 16;
+	cur[2] = id >> 8;
+	cur[3] = id;
+}
+
+static uint32_t get_id(const uint8_t *buf)
+{
+	return buf[0] << 24 | buf[1] << 16 | buf[2] << 8 | buf[3];
+}
+
+static void id_sent(uint32_t id, uint32_t fn)
+{
+	struct bench_id *bid;
+
+	if (id >= num_ids)
+		return;
+	bid = &ids[id];
+	if (bid->sent)
+		return;
+	bid->sent = 1;
+	latency[num_latency++] = fn - bid->enq_fn;
+}
+
+static void lv_sent(const uint8_t *lv, uint32_t fn)
+{
+	if (lv[0] < 5)
+		return;
+	id_sent(get_id(lv + lv[0] - 3), fn);
+}
+
+/* find the identities in a PAGING REQUEST */
+static void parse_block(const uint8_t *buf, uint32_t fn)
+{
+	unsigned int len = (buf[0] >> 2) + 1;
+	unsigned int i;
+
+	switch (buf[2]) {
+	case GSM48_MT_RR_PAG_REQ_1:
+		for (i = 4; i < len; i += buf[i] + 1)
+			lv_sent(buf + i, fn);
+		break;
+	case GSM48_MT_RR_PAG_REQ_2:
+		id_sent(get_id(buf + 4), fn);
+		id_sent(get_id(buf + 8), fn);
+		if (len > 12)
+			lv_sent(buf + 12, fn);
+		break;
+	case GSM48_MT_RR_PAG_REQ_3:
+		for (i = 0; i < 4; i++)
+			id_sent(get_id(buf + 4 + 4 * i), fn);
+		break;
+	}
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double fn_to_ms(double frames)
+{
+	return frames * 120.0 / 26;
+}
+
+static void print_help(void)
+{
+	printf("usage: paging_bench [options]\n"
+		"  -r rate     PAGING CMD per second (%u)\n"
+		"  -t percent  TMSI among the identities (%u)\n"
+		"  -d percent  repeated PAGING CMD (%u)\n"
+		"  -g groups   paging groups used, 0 for all (%u)\n"
+		"  -s seconds  simulated time (%u)\n"
+		"  -q records  paging queue limit (%u)\n"
+		"  -l seconds  paging lifetime (%u)\n"
+		"  -m mfrms    BS_PA_MFRMS (%u)\n"
+		"  -a blocks   BS_AG_BLKS_RES (%u)\n"
+		"  -S seed     random seed (%u)\n",
+		cfg.rate, cfg.tmsi_pct, cfg.dup_pct, cfg.groups, cfg.seconds,
+		cfg.queue_max, cfg.lifetime, cfg.bs_pa_mfrms,
+		cfg.bs_ag_blks_res, cfg.seed);
+}
+
+static void handle_options(int argc, char **argv)
+{
+	int c;
+
+	while ((c = getopt(argc, argv, "r:t:d:g:s:q:l:m:a:S:h")) != -1) {
+		switch (c) {
+		case 'r':
+			cfg.rate = atoi(optarg);
+			break;
+		case 't':
+			cfg.tmsi_pct = atoi(optarg);
+			break;
+		case 'd':
+			cfg.dup_pct = atoi(optarg);
+			break;
+		case 'g':
+			cfg.groups = atoi(optarg);
+			break;
+		case 's':
+			cfg.seconds = atoi(optarg);
+			break;
+		case 'q':
+			cfg.queue_max = atoi(optarg);
+			break;
+		case 'l':
+			cfg.lifetime = atoi(optarg);
+			break;
+		case 'm':
+			cfg.bs_pa_mfrms = atoi(optarg);
+			break;
+		case 'a':
+			cfg.bs_ag_blks_res = atoi(optarg);
+			break;
+		case 'S':
+			cfg.seed = atoi(optarg);
+			break;
+		default:
+			print_help();
+			exit(c == 'h' ? 0 : 1);
+		}
+	}
+
+	if (cfg.bs_pa_mfrms < 2 || cfg.bs_pa_mfrms > 9 ||
+	    cfg.bs_ag_blks_res > 7) {
+		fprintf(stderr, "BS_PA_MFRMS must be 2..9, "
+			"BS_AG_BLKS_RES 0..7\n");
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	struct gsm48_control_channel_descr chan_desc;
+	const struct paging_stats *st;
+	struct paging_state *ps;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	uint8_t lv[9];
+	struct gsm_time g_time;
+	double t_add = 0, t_gen = 0, start, arrivals = 0;
+	unsigned int num_groups, n_add = 0, n_gen = 0, n_dup_offered = 0;
+	unsigned int n_dropped = 0, n_unsent = 0;
+	uint64_t ids_sent = 0, blocks_used = 0, blocks = 0;
+	uint32_t fn, num_fn;
+	int i, rc, is_empty;
+
+	handle_options(argc, argv);
+	srand(cfg.seed);
+
+	tall_bts_ctx = talloc_named_const(NULL, 1, "OsmoBTS context");
+	msgb_set_talloc_ctx(talloc_named_const(tall_bts_ctx, 1, "msgb"));
+	bts_log_init(NULL);
+	log_set_category_filter(osmo_stderr_target, DPAG, 1, LOGL_ERROR);
+
+	bts = gsm_bts_alloc(tall_bts_ctx);
+	if (bts_init(bts) < 0) {
+		fprintf(stderr, "unable to open bts\n");
+		exit(1);
+	}
+	ps = bts_role_bts(bts)->paging_state;
+	paging_config(ps, cfg.queue_max, cfg.lifetime);
+
+	memset(&chan_desc, 0, sizeof(chan_desc));
+	chan_desc.ccch_conf = RSL_BCCH_CCCH_CONF_1_NC;
+	chan_desc.bs_pa_mfrms = cfg.bs_pa_mfrms - 2;
+	chan_desc.bs_ag_blks_res = cfg.bs_ag_blks_res;
+	paging_si_update(ps, &chan_desc);
+
+	num_groups = (ARRAY_SIZE(ccch_block_t3) - cfg.bs_ag_blks_res) *
+			cfg.bs_pa_mfrms;
+	if (cfg.groups == 0 || cfg.groups > num_groups)
+		cfg.groups = num_groups;
+
+	num_fn = cfg.seconds * 26000 / 120;
+	max_ids = (uint64_t) cfg.rate * cfg.seconds + 1;
+	ids = calloc(max_ids, sizeof(*ids));
+	latency = calloc(max_ids, sizeof(*latency));
+	if (!ids || !latency) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	for (fn = 0; fn < num_fn; fn++) {
+		gsm_fn2gsmtime(&g_time, fn);
+
+		/* PAGING CMDs arriving in this frame */
+		arrivals += cfg.rate * 120.0 / 26 / 1000;
+		while (arrivals >= 1 && num_ids < max_ids) {
+			struct bench_id *bid;
+			uint32_t id;
+
+			arrivals -= 1;
+			if (num_ids > 0 && rand() % 100 < cfg.dup_pct) {
+				unsigned int recent = num_ids < RECENT_IDS ?
+						num_ids : RECENT_IDS;
+				id = num_ids - 1 - rand() % recent;
+				n_dup_offered++;
+			} else {
+				id = num_ids++;
+				ids[id].enq_fn = fn;
+				ids[id].group = rand() % cfg.groups;
+				ids[id].is_tmsi = rand() % 100 < cfg.tmsi_pct;
+			}
+			bid = &ids[id];
+			make_identity(lv, id, bid->is_tmsi);
+
+			start = now();
+			rc = paging_add_identity(ps, 0, bid->group, lv, 0, 0);
+			t_add += now() - start;
+			n_add++;
+
+			if (rc == 0)
+				bid->admitted = 1;
+			else if (rc == -ENOSPC)
+				n_dropped++;
+		}
+
+		/* paging blocks of this frame */
+		for (i = cfg.bs_ag_blks_res; i < ARRAY_SIZE(ccch_block_t3); i++) {
+			if (g_time.t3 != ccch_block_t3[i])
+				continue;
+
+			start = now();
+			paging_gen_msg(ps, 0, out_buf, &g_time, &is_empty);
+			t_gen += now() - start;
+			n_gen++;
+
+			if (!is_empty)
+				parse_block(out_buf, fn);
+		}
+	}
+
+	st = paging_get_stats(ps);
+	for (i = 1; i < ARRAY_SIZE(st->pch_blocks); i++) {
+		ids_sent += i * st->pch_blocks[i];
+		blocks_used += st->pch_blocks[i];
+	}
+	blocks = blocks_used + st->pch_blocks[0] + st->pch_imm_ass;
+	for (i = 0; i < num_ids; i++) {
+		if (ids[i].admitted && !ids[i].sent)
+			n_unsent++;
+	}
+
+	printf("offered: %u PAGING CMD in %u s (%u/s, %u%% TMSI, "
+		"%u%% repeated, %u groups)\n", n_add, cfg.seconds, cfg.rate,
+		cfg.tmsi_pct, cfg.dup_pct, cfg.groups);
+	printf("enqueue: %.1f ns/PAGING CMD, generate: %.1f ns/block\n",
+		n_add ? t_add * 1e9 / n_add : 0, n_gen ? t_gen * 1e9 / n_gen : 0);
+	printf("queue: added %llu, duplicates %llu (%u repeated), "
+		"dropped %u, expired %llu, peak %u\n",
+		(unsigned long long) st->added,
+		(unsigned long long) st->duplicates, n_dup_offered, n_dropped,
+		(unsigned long long) st->expired, st->max_queue_len);
+	printf("PCH: %llu blocks, %.1f%% used, %.2f identities/used block "
+		"(1/2/3/4: %llu/%llu/%llu/%llu)\n",
+		(unsigned long long) blocks,
+		blocks ? 100.0 * blocks_used / blocks : 0,
+		blocks_used ? (double) ids_sent / blocks_used : 0,
+		(unsigned long long) st->pch_blocks[1],
+		(unsigned long long) st->pch_blocks[2],
+		(unsigned long long) st->pch_blocks[3],
+		(unsigned long long) st->pch_blocks[4]);
+
+	if (num_latency) {
+		uint64_t sum = 0;
+
+		qsort(latency, num_latency, sizeof(*latency), cmp_u32);
+		for (i = 0; i < num_latency; i++)
+			sum += latency[i];
+		printf("first paging after: avg %.0f ms, median %.0f ms, "
+			"95%% %.0f ms, max %.0f ms\n",
+			fn_to_ms(sum) / num_latency,
+			fn_to_ms(latency[num_latency / 2]),
+			fn_to_ms(latency[num_latency * 95 / 100]),
+			fn_to_ms(latency[num_latency - 1]));
+	}
+	printf("identities never paged: %u (%u still queued)\n",
+		num_ids - num_latency, n_unsent);
+
+	return 0;
+}
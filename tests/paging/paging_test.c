@@ -25,7 +25,8 @@
 #include <osmo-bts/paging.h>
 #include <osmo-bts/gsm_data.h>
 
-#include <unistd.h>
+#include <errno.h>
+#include <string.h>
 
 static struct gsm_bts *bts;
 static struct gsm_bts_role_bts *btsb;
@@ -50,7 +51,7 @@ static void test_paging_smoke(void)
 	printf("Testing that paging messages expire.\n");
 
 	/* add paging entry */
-	rc = paging_add_identity(btsb->paging_state, 0, static_ilv, 0);
+	rc = paging_add_identity(btsb->paging_state, 0, 0, static_ilv, 0, 0);
 	ASSERT_TRUE(rc == 0);
 	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 1);
 
@@ -59,11 +60,11 @@ static void test_paging_smoke(void)
 	g_time.t1 = 0;
 	g_time.t2 = 0;
 	g_time.t3 = 6;
-	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
+	rc = paging_gen_msg(btsb->paging_state, 0, out_buf, &g_time, &is_empty);
 	ASSERT_TRUE(rc == 13);
 	ASSERT_TRUE(is_empty == 0);
 
-	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 0));
+	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 0, 0));
 	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
 
 	/* now test the empty queue */
@@ -71,7 +72,7 @@ static void test_paging_smoke(void)
 	g_time.t1 = 0;
 	g_time.t2 = 0;
 	g_time.t3 = 6;
-	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
+	rc = paging_gen_msg(btsb->paging_state, 0, out_buf, &g_time, &is_empty);
 	ASSERT_TRUE(rc == 6);
 	ASSERT_TRUE(is_empty == 1);
 
@@ -81,33 +82,273 @@ static void test_paging_smoke(void)
 	 */
 }
 
-static void test_paging_sleep(void)
+static void test_paging_lifetime(void)
 {
-	int rc;
+	int rc, mfrm, num_tx = 0;
 	uint8_t out_buf[GSM_MACBLOCK_LEN];
 	struct gsm_time g_time;
 	int is_empty = -1;
-	printf("Testing that paging messages expire with sleep.\n");
+	printf("Testing that paging messages expire after their lifetime.\n");
+
+	/* 2s are 9 51-multiframes, group 0 is served every second one */
+	paging_set_lifetime(btsb->paging_state, 2);
 
 	/* add paging entry */
-	rc = paging_add_identity(btsb->paging_state, 0, static_ilv, 0);
+	rc = paging_add_identity(btsb->paging_state, 0, 0, static_ilv, 0, 0);
 	ASSERT_TRUE(rc == 0);
 	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 1);
 
-	/* sleep */
-	sleep(1);
+	for (mfrm = 0; mfrm < 20; mfrm += 2) {
+		gsm_fn2gsmtime(&g_time, mfrm * 51 + 6);
+		rc = paging_gen_msg(btsb->paging_state, 0, out_buf, &g_time,
+				    &is_empty);
+		if (!is_empty)
+			num_tx++;
+		if (paging_queue_length(btsb->paging_state) == 0)
+			break;
+	}
+	printf(" paged %d times, removed in multiframe %d\n", num_tx, mfrm);
+
+	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 0, 0));
+	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
+
+	paging_set_lifetime(btsb->paging_state, 0);
+}
+
+static void test_paging_duplicates(void)
+{
+	struct paging_state *ps = btsb->paging_state;
+	const struct paging_stats *st = paging_get_stats(ps);
+	uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x00, 0x00, 0x00, 0x00 };
+	uint64_t added, dups, lookups, cmps;
+	unsigned int pool;
+	int i, rc;
+
+	printf("Testing paging duplicate detection.\n");
+
+	added = st->added;
+	dups = st->duplicates;
+	lookups = st->lookups;
+	cmps = st->lookup_cmps;
+
+	/* all in one group, the worst case for a linear search */
+	for (i = 0; i < 150; i++) {
+		tmsi_lv[4] = i * 7;
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+	ASSERT_TRUE(paging_queue_length(ps) == 150);
+
+	for (i = 0; i < 150; i++) {
+		tmsi_lv[4] = i * 7;
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+		ASSERT_TRUE(rc == -EEXIST);
+	}
+	ASSERT_TRUE(paging_queue_length(ps) == 150);
+
+	/* the same identity in another group is not a duplicate */
+	rc = paging_add_identity(ps, 0, 1, tmsi_lv, 0, 0);
+	ASSERT_TRUE(rc == 0);
+
+	printf(" added %llu, duplicates %llu, %llu lookups, %llu compares\n",
+		(unsigned long long) (st->added - added),
+		(unsigned long long) (st->duplicates - dups),
+		(unsigned long long) (st->lookups - lookups),
+		(unsigned long long) (st->lookup_cmps - cmps));
+
+	/* records go back to the pool */
+	pool = st->pool_size;
+	paging_reset(ps);
+	ASSERT_TRUE(paging_queue_length(ps) == 0);
+	for (i = 0; i < 150; i++) {
+		tmsi_lv[4] = i * 7;
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+	ASSERT_TRUE(st->pool_size == pool);
+	paging_reset(ps);
+}
+
+static void test_paging_head_insert(void)
+{
+	static const uint8_t tmsi1_lv[] = { 0x05, 0xf4, 0x11, 0x11, 0x11, 0x11 };
+	static const uint8_t tmsi2_lv[] = { 0x05, 0xf4, 0x22, 0x22, 0x22, 0x22 };
+	struct paging_state *ps = btsb->paging_state;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	int is_empty = -1;
+	int rc;
+
+	printf("Testing that new paging records are sent first.\n");
+
+	rc = paging_add_identity(ps, 0, 0, tmsi1_lv, 0, 0);
+	ASSERT_TRUE(rc == 0);
+	rc = paging_add_identity(ps, 0, 0, tmsi2_lv, 0, 0);
+	ASSERT_TRUE(rc == 0);
 
-	/* generate messages */
 	g_time.fn = 0;
 	g_time.t1 = 0;
 	g_time.t2 = 0;
 	g_time.t3 = 6;
-	rc = paging_gen_msg(btsb->paging_state, out_buf, &g_time, &is_empty);
-	ASSERT_TRUE(rc == 13);
+	rc = paging_gen_msg(ps, 0, out_buf, &g_time, &is_empty);
 	ASSERT_TRUE(is_empty == 0);
 
-	ASSERT_TRUE(paging_group_queue_empty(btsb->paging_state, 0));
-	ASSERT_TRUE(paging_queue_length(btsb->paging_state) == 0);
+	/* PAGING REQUEST TYPE 1, the identity added last comes first */
+	ASSERT_TRUE(out_buf[2] == GSM48_MT_RR_PAG_REQ_1);
+	ASSERT_TRUE(!memcmp(out_buf + 4, tmsi2_lv, sizeof(tmsi2_lv)));
+	ASSERT_TRUE(!memcmp(out_buf + 4 + sizeof(tmsi2_lv), tmsi1_lv,
+			    sizeof(tmsi1_lv)));
+	ASSERT_TRUE(paging_queue_length(ps) == 0);
+}
+
+static void test_paging_packing(void)
+{
+	static const uint8_t imsi_lv[] = {
+		0x08, 0x29, 0x26, 0x24, 0x10, 0x32, 0x54, 0x76, 0x98 };
+	struct paging_state *ps = btsb->paging_state;
+	const struct paging_stats *st = paging_get_stats(ps);
+	uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x00, 0x00, 0x00, 0x00 };
+	uint8_t ilv[sizeof(imsi_lv)];
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	uint64_t blocks_3, blocks_4;
+	struct gsm_time g_time;
+	int is_empty = -1;
+	int i, rc;
+
+	printf("Testing that PCH blocks are filled from the whole queue.\n");
+
+	paging_set_lifetime(ps, 60);
+	blocks_3 = st->pch_blocks[3];
+	blocks_4 = st->pch_blocks[4];
+
+	/* queue: IMSI1, IMSI2, TMSI1, TMSI2, TMSI3, TMSI4 */
+	for (i = 4; i > 0; i--) {
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+	for (i = 2; i > 0; i--) {
+		memcpy(ilv, imsi_lv, sizeof(ilv));
+		ilv[8] = 0x90 | i;
+		rc = paging_add_identity(ps, 0, 0, ilv, 0, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+
+	for (i = 0; i < 3; i++) {
+		gsm_fn2gsmtime(&g_time, 2 * i * 51 + 6);
+		rc = paging_gen_msg(ps, 0, out_buf, &g_time, &is_empty);
+		ASSERT_TRUE(is_empty == 0);
+		switch (out_buf[2]) {
+		case GSM48_MT_RR_PAG_REQ_1:
+			printf(" block %d: PAGING REQUEST TYPE 1\n", i);
+			break;
+		case GSM48_MT_RR_PAG_REQ_2:
+			printf(" block %d: PAGING REQUEST TYPE 2\n", i);
+			break;
+		case GSM48_MT_RR_PAG_REQ_3:
+			printf(" block %d: PAGING REQUEST TYPE 3\n", i);
+			break;
+		}
+	}
+	ASSERT_TRUE(st->pch_blocks[3] - blocks_3 == 2);
+	ASSERT_TRUE(st->pch_blocks[4] - blocks_4 == 1);
+	ASSERT_TRUE(paging_queue_length(ps) == 6);
+
+	paging_reset(ps);
+	paging_set_lifetime(ps, 0);
+}
+
+static void test_paging_priority(void)
+{
+	static const uint8_t prio_lv[] = { 0x05, 0xf4, 0xaa, 0xaa, 0xaa, 0xaa };
+	struct paging_state *ps = btsb->paging_state;
+	const struct paging_stats *st = paging_get_stats(ps);
+	uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x00, 0x00, 0x00, 0x00 };
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct paging_stats before = *st;
+	struct gsm_time g_time;
+	int is_empty = -1;
+	int i, rc;
+
+	printf("Testing that priority paging preempts normal paging.\n");
+
+	paging_set_queue_max(ps, 4);
+	for (i = 1; i <= 4; i++) {
+		tmsi_lv[5] = i;
+		rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+		ASSERT_TRUE(rc == 0);
+	}
+
+	/* priority A pushes out the oldest normal record ... */
+	rc = paging_add_identity(ps, 0, 0, prio_lv, 0, 7);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_queue_length(ps) == 4);
+
+	/* ... but a normal one finds the queue full */
+	tmsi_lv[5] = 5;
+	rc = paging_add_identity(ps, 0, 0, tmsi_lv, 0, 0);
+	ASSERT_TRUE(rc == -ENOSPC);
+
+	/* the priority record leads the next block */
+	gsm_fn2gsmtime(&g_time, 6);
+	rc = paging_gen_msg(ps, 0, out_buf, &g_time, &is_empty);
+	ASSERT_TRUE(is_empty == 0);
+	ASSERT_TRUE(out_buf[2] == GSM48_MT_RR_PAG_REQ_3);
+	ASSERT_TRUE(!memcmp(out_buf + 4, prio_lv + 2, 4));
+
+	for (i = 0; i < _NUM_PAGING_PRIO; i++)
+		printf(" %s: added %llu, dropped %llu, preempted %llu, "
+			"sent %llu\n", get_value_string(paging_prio_names, i),
+			(unsigned long long) (st->prio[i].added -
+					      before.prio[i].added),
+			(unsigned long long) (st->prio[i].dropped -
+					      before.prio[i].dropped),
+			(unsigned long long) (st->prio[i].preempted -
+					      before.prio[i].preempted),
+			(unsigned long long) (st->prio[i].sent -
+					      before.prio[i].sent));
+
+	paging_reset(ps);
+	paging_set_queue_max(ps, 200);
+}
+
+static void test_paging_ccch(void)
+{
+	static const uint8_t tmsi_lv[] = { 0x05, 0xf4, 0x12, 0x34, 0x56, 0x78 };
+	struct paging_state *ps = btsb->paging_state;
+	struct gsm48_control_channel_descr chan_desc;
+	uint8_t out_buf[GSM_MACBLOCK_LEN];
+	struct gsm_time g_time;
+	int is_empty = -1;
+	int rc;
+
+	printf("Testing paging on the second CCCH.\n");
+
+	memset(&chan_desc, 0, sizeof(chan_desc));
+	chan_desc.ccch_conf = RSL_BCCH_CCCH_CONF_2_NC;
+	paging_si_update(ps, &chan_desc);
+
+	rc = paging_add_identity(ps, 1, 0, tmsi_lv, 0, 0);
+	ASSERT_TRUE(rc == 0);
+	ASSERT_TRUE(paging_group_queue_empty(ps, 0, 0));
+	ASSERT_TRUE(!paging_group_queue_empty(ps, 1, 0));
+	rc = paging_add_identity(ps, BTS_MAX_CCCH, 0, tmsi_lv, 0, 0);
+	ASSERT_TRUE(rc == -EINVAL);
+
+	/* the same paging block on both CCCH timeslots */
+	gsm_fn2gsmtime(&g_time, 6);
+	rc = paging_gen_msg(ps, 0, out_buf, &g_time, &is_empty);
+	printf(" CCCH 0: empty %d\n", is_empty);
+	rc = paging_gen_msg(ps, 1, out_buf, &g_time, &is_empty);
+	printf(" CCCH 1: empty %d\n", is_empty);
+	ASSERT_TRUE(!memcmp(out_buf + 4, tmsi_lv, sizeof(tmsi_lv)));
+
+	paging_reset(ps);
+	chan_desc.ccch_conf = RSL_BCCH_CCCH_CONF_1_NC;
+	paging_si_update(ps, &chan_desc);
 }
 
 int main(int argc, char **argv)
@@ -128,7 +369,12 @@ int main(int argc, char **argv)
 
 	btsb = bts_role_bts(bts);
 	test_paging_smoke();
-	test_paging_sleep();
+	test_paging_lifetime();
+	test_paging_duplicates();
+	test_paging_head_insert();
+	test_paging_packing();
+	test_paging_priority();
+	test_paging_ccch();
 	printf("Success\n");
 
 	return 0;
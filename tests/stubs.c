@@ -57,3 +57,5 @@ int l1if_set_txpower(struct femtol1_hdl *fl1h, float tx_power)
 
 int bts_model_adjst_ms_pwr(struct gsm_lchan *lchan)
 { return 0; }
+int bts_model_adjst_bs_pwr(struct gsm_lchan *lchan)
+{ return 0; }
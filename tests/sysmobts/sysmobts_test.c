@@ -22,11 +22,16 @@
 #include "femtobts.h"
 #include "l1_if.h"
 #include "utils.h"
+#include "tch_conv.h"
 
 #include <sysmocom/femtobts/gsml1prim.h>
 
+#include <osmocom/core/bits.h>
+
 #include <stdio.h>
 
+#include "../bts_fixture.h"
+
 int pcu_direct = 0;
 
 static int direct_map[][3] = {
@@ -181,30 +186,30 @@ static void test_sysmobts_cipher(void)
 
 static void test_sysmobts_loop(void)
 {
-	struct gsm_bts bts;
-	struct gsm_bts_trx trx;
-	struct gsm_bts_trx_ts ts;
-	struct gsm_lchan *lchan;
-	int ret;
+	struct gsm_bts *bts = test_bts_setup(1);
+	struct gsm_bts_role_bts *btsb = bts_role_bts(bts);
+	struct gsm_lchan *lchan = &bts->c0->ts[0].lchan[0];
+	struct ms_power_lchan *mp;
+	int ret, i;
 
-	memset(&bts, 0, sizeof(bts));
-	memset(&trx, 0, sizeof(trx));
-	memset(&ts, 0, sizeof(ts));
-
-	lchan = &ts.lchan[0];
-	lchan->ts = &ts;
-	ts.trx = &trx;
-	trx.bts = &bts;
-	bts.band = GSM_BAND_1800;
-	trx.ms_power_control = 1;
+	bts->band = GSM_BAND_1800;
+	bts->c0->ms_power_control = 1;
 
 	printf("Testing sysmobts power control\n");
 
+	/* no averaging, react to everything but 1 dB at once */
+	ms_power_ctrl_init(bts);
+	btsb->ms_power_ctrl.avg_blocks = 1;
+	btsb->ms_power_ctrl.raise_thresh = 1;
+	btsb->ms_power_ctrl.lower_thresh = 1;
+	btsb->ms_power_ctrl.raise_max_db = 63;
+	btsb->ms_power_ctrl.lower_max_db = 63;
+
 	/* Simply clamping */
 	lchan->state = LCHAN_S_NONE;
 	lchan->ms_power_ctrl.current = ms_pwr_ctl_lvl(GSM_BAND_1800, 0);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 15);
-	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -60);
+	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -60, 0);
 	OSMO_ASSERT(ret == 0);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 15);
 
@@ -213,26 +218,154 @@ static void test_sysmobts_loop(void)
 	 * Now 15 dB too little and we should power it up. Could be a
 	 * power level of 7 or 8 for 15 dBm
 	 */
-	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -90);
+	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -90, 0);
 	OSMO_ASSERT(ret == 1);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 7);
 
 	/* It should be clamped to level 0 and 30 dBm */
-	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -100);
+	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -100, 0);
 	OSMO_ASSERT(ret == 1);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 0);
 
 	/* Fix it and jump down */
 	lchan->ms_power_ctrl.fixed = 1;
-	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -60);
+	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -60, 0);
 	OSMO_ASSERT(ret == 0);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 0);
 
 	/* And leave it again */
 	lchan->ms_power_ctrl.fixed = 0;
-	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -40);
+	ret = l1if_ms_pwr_ctrl(lchan, -75, lchan->ms_power_ctrl.current, -40, 0);
 	OSMO_ASSERT(ret == 1);
 	OSMO_ASSERT(lchan->ms_power_ctrl.current == 15);
+
+	printf("Testing filtered power control\n");
+	ms_power_ctrl_init(bts);
+	mp = &lchan_bts_state(lchan)->ms_power;
+
+	/* 8 dB up after 4 blocks */
+	for (i = 0; i < 3; i++) {
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 15, -90, 0);
+		OSMO_ASSERT(ret == 0);
+	}
+	ret = l1if_ms_pwr_ctrl(lchan, -75, 15, -90, 0);
+	OSMO_ASSERT(ret == 1);
+	OSMO_ASSERT(lchan->ms_power_ctrl.current == 11);
+
+	/* the MS is still at the old power, nothing is averaged */
+	for (i = 0; i < 8; i++) {
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 15, -100, 0);
+		OSMO_ASSERT(ret == 0);
+	}
+
+	/* within the hysteresis */
+	for (i = 0; i < 8; i++) {
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 11, i & 1 ? -72 : -78, 0);
+		OSMO_ASSERT(ret == 0);
+	}
+	OSMO_ASSERT(lchan->ms_power_ctrl.current == 11);
+
+	/* bad quality at the target level */
+	for (i = 0; i < 4; i++)
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 11, -75, 7.0);
+	OSMO_ASSERT(ret == 1);
+	OSMO_ASSERT(lchan->ms_power_ctrl.current == 7);
+
+	/* 4 dB down at most */
+	for (i = 0; i < 4; i++)
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 7, -50, 0);
+	OSMO_ASSERT(ret == 1);
+	OSMO_ASSERT(lchan->ms_power_ctrl.current == 9);
+
+	/* not above the power set by the BSC */
+	lchan->ms_power = ms_pwr_ctl_lvl(GSM_BAND_1800, 14);
+	ms_power_ctrl_reset(lchan, 1);
+	for (i = 0; i < 4; i++)
+		ret = l1if_ms_pwr_ctrl(lchan, -75, 9, -100, 0);
+	OSMO_ASSERT(ret == 1);
+	OSMO_ASSERT(lchan->ms_power_ctrl.current == 8);
+
+	OSMO_ASSERT(mp->blocks == 4 && mp->raised == 1 && mp->lowered == 0);
+	OSMO_ASSERT(btsb->ms_power_ctrl.raised == 5);
+	OSMO_ASSERT(btsb->ms_power_ctrl.lowered == 2);
+}
+
+/* payload sizes in octets as carried in RTP (without CMR/TOC for AMR) */
+static const struct {
+	const char *name;
+	unsigned int len;
+	unsigned int nibbles;
+} tch_conv_modes[] = {
+	{ "FR",		33,	260/4 },
+	{ "EFR",	31,	244/4 },
+	{ "AMR 4.75",	12,	12*2 },
+	{ "AMR 5.15",	13,	13*2 },
+	{ "AMR 5.90",	15,	15*2 },
+	{ "AMR 6.70",	17,	17*2 },
+	{ "AMR 7.40",	19,	19*2 },
+	{ "AMR 7.95",	20,	20*2 },
+	{ "AMR 10.2",	26,	26*2 },
+	{ "AMR 12.2",	31,	31*2 },
+	{ "AMR SID",	5,	5*2 },
+};
+
+static void test_sysmobts_tch_conv(void)
+{
+	uint8_t in[64], ref[64], tmp[64], out[64], back[64];
+	unsigned int i, j, len, nibbles;
+
+	printf("Testing TCH payload conversion\n");
+
+	/* HR is a plain per-octet bit reversal */
+	for (i = 0; i < 14; i++)
+		in[i] = i * 37 + 11;
+	memcpy(ref, in, 14);
+	osmo_revbytebits_buf(ref, 14);
+	tch_revbits_copy(out, in, 14);
+	OSMO_ASSERT(!memcmp(out, ref, 14));
+	tch_revbits_copy(back, out, 14);
+	OSMO_ASSERT(!memcmp(back, in, 14));
+	printf("HR round-trip ok\n");
+
+	for (i = 0; i < ARRAY_SIZE(tch_conv_modes); i++) {
+		len = tch_conv_modes[i].len;
+		nibbles = tch_conv_modes[i].nibbles;
+
+		for (j = 0; j < sizeof(in); j++)
+			in[j] = (j + i) * 73 + 5;
+
+		/* L1 -> RTP, FR/EFR style: revbits, then shift right */
+		memcpy(tmp, in, sizeof(in));
+		osmo_revbytebits_buf(tmp, len);
+		osmo_nibble_shift_right(ref, tmp, nibbles);
+		tch_revbits_shift_right(out, in, nibbles);
+		OSMO_ASSERT(!memcmp(out, ref, len));
+
+		/* RTP -> L1, FR/EFR style: shift left, then revbits */
+		memset(ref, 0, sizeof(ref));
+		memset(back, 0, sizeof(back));
+		osmo_nibble_shift_left_unal(ref, out, nibbles);
+		osmo_revbytebits_buf(ref, (nibbles + 1) / 2);
+		tch_shift_left_revbits(back, out, nibbles);
+		OSMO_ASSERT(!memcmp(back, ref, (nibbles + 1) / 2));
+		OSMO_ASSERT(!memcmp(back, in, nibbles / 2));
+
+		/* RTP -> L1, AMR style: shift right, then revbits */
+		osmo_nibble_shift_right(ref, in, len * 2);
+		osmo_revbytebits_buf(ref, len + 1);
+		tch_shift_right_revbits(out, in, len * 2);
+		OSMO_ASSERT(!memcmp(out, ref, len + 1));
+
+		/* L1 -> RTP, AMR style: revbits, then shift left */
+		memcpy(tmp, out, sizeof(out));
+		osmo_revbytebits_buf(tmp, len + 1);
+		osmo_nibble_shift_left_unal(ref, tmp, len * 2 + 1);
+		tch_revbits_shift_left(back, out, len * 2 + 1);
+		OSMO_ASSERT(!memcmp(back, ref, len + 1));
+		OSMO_ASSERT(!memcmp(back, in, len));
+
+		printf("%s round-trip ok\n", tch_conv_modes[i].name);
+	}
 }
 
 int main(int argc, char **argv)
@@ -241,6 +374,7 @@ int main(int argc, char **argv)
 	test_sysmobts_auto_band();
 	test_sysmobts_cipher();
 	test_sysmobts_loop();
+	test_sysmobts_tch_conv();
 	return 0;
 }
 
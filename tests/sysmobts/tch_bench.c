@@ -0,0 +1,118 @@
+/* micro benchmark for the sysmoBTS TCH payload conversion */
+
+/* (C) 2015 by sysmocom s.f.m.c. GmbH
+ *
+ * All Rights Reserved
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <osmocom/core/bits.h>
+
+#include "tch_conv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define GSM_FR_BYTES	33
+#define GSM_FR_NIBBLES	(260/4)
+
+static volatile uint8_t sink;
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(const char *name, double start, unsigned int iter)
+{
+	printf("%-32s %8.1f ns/frame\n", name, (now() - start) * 1e9 / iter);
+}
+
+/* usage: tch_bench [iterations] */
+int main(int argc, char **argv)
+{
+	uint8_t l1[64], rtp[64], tmp[64];
+	unsigned int iter = 1000000;
+	unsigned int i;
+	double start;
+
+	if (argc > 1)
+		iter = atoi(argv[1]);
+	if (iter == 0)
+		iter = 1;
+
+	for (i = 0; i < sizeof(l1); i++)
+		l1[i] = i * 73 + 5;
+
+	/* L1 -> RTP, the two-pass code that used to be in tch.c */
+	start = now();
+	for (i = 0; i < iter; i++) {
+		memcpy(tmp, l1, GSM_FR_BYTES);
+		osmo_revbytebits_buf(tmp, GSM_FR_BYTES);
+		osmo_nibble_shift_right(rtp, tmp, GSM_FR_NIBBLES);
+		sink = rtp[i % GSM_FR_BYTES];
+	}
+	report("FR L1->RTP two-pass", start, iter);
+
+	start = now();
+	for (i = 0; i < iter; i++) {
+		tch_revbits_shift_right(rtp, l1, GSM_FR_NIBBLES);
+		sink = rtp[i % GSM_FR_BYTES];
+	}
+	report("FR L1->RTP single-pass", start, iter);
+
+	/* RTP -> L1 */
+	start = now();
+	for (i = 0; i < iter; i++) {
+		osmo_nibble_shift_left_unal(l1, rtp, GSM_FR_NIBBLES);
+		osmo_revbytebits_buf(l1, GSM_FR_BYTES);
+		sink = l1[i % GSM_FR_BYTES];
+	}
+	report("FR RTP->L1 two-pass", start, iter);
+
+	start = now();
+	for (i = 0; i < iter; i++) {
+		tch_shift_left_revbits(l1, rtp, GSM_FR_NIBBLES);
+		sink = l1[i % GSM_FR_BYTES];
+	}
+	report("FR RTP->L1 single-pass", start, iter);
+
+	/* AMR 12.2, RTP -> L1 and back */
+	start = now();
+	for (i = 0; i < iter; i++) {
+		osmo_nibble_shift_right(tmp, rtp, 31*2);
+		osmo_revbytebits_buf(tmp, 32);
+		osmo_revbytebits_buf(tmp, 32);
+		osmo_nibble_shift_left_unal(l1, tmp, 32*2 - 1);
+		sink = l1[i % 31];
+	}
+	report("AMR 12.2 round-trip two-pass", start, iter);
+
+	start = now();
+	for (i = 0; i < iter; i++) {
+		tch_shift_right_revbits(tmp, rtp, 31*2);
+		tch_revbits_shift_left(l1, tmp, 32*2 - 1);
+		sink = l1[i % 31];
+	}
+	report("AMR 12.2 round-trip single-pass", start, iter);
+
+	return 0;
+}